@@ -17,3 +17,5 @@ bool interlace_setting_dirty = false;
 
 int aspect_ratio_setting = 0;
 bool aspect_ratio_dirty = false;
+
+unsigned audio_output_rate = 44100;
@@ -37,6 +37,8 @@ extern bool interlace_setting_dirty;
 extern int aspect_ratio_setting;
 extern bool aspect_ratio_dirty;
 
+extern unsigned audio_output_rate;
+
 #ifdef __cplusplus
 }
 #endif
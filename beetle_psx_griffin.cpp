@@ -2,6 +2,7 @@
 #include "mednafen/psx/irq.cpp"
 #include "mednafen/psx/timer.cpp"
 #include "mednafen/psx/frontio.cpp"
+#include "mednafen/psx/memcard_writer.cpp"
 #include "mednafen/psx/cpu.cpp"
 #include "mednafen/psx/gte.cpp"
 #include "mednafen/psx/dis.cpp"
@@ -9,6 +10,7 @@
 #include "mednafen/psx/spu.cpp"
 #include "mednafen/psx/gpu.cpp"
 #include "mednafen/psx/mdec.cpp"
+#include "mednafen/psx/profile.cpp"
 #include "mednafen/psx/input/gamepad.cpp"
 #include "mednafen/psx/input/dualanalog.cpp"
 #include "mednafen/psx/input/dualshock.cpp"
@@ -32,6 +34,7 @@
 #include "mednafen/cdrom/CDAccess_Image.cpp"
 #include "mednafen/cdrom/CDAccess_CCD.cpp"
 #include "mednafen/cdrom/CDAccess_PBP.cpp"
+#include "mednafen/cdrom/CDAccess_Decoded.cpp"
 #include "mednafen/cdrom/SimpleFIFO.cpp"
 #include "mednafen/cdrom/audioreader.cpp"
 #include "mednafen/cdrom/cdromif.cpp"
@@ -41,6 +44,7 @@
 #include "mednafen/mempatcher.cpp"
 #include "mednafen/video/Deinterlacer.cpp"
 #include "mednafen/video/surface.cpp"
+#include "mednafen/sound/Resampler.cpp"
 
 #include "libretro.cpp"
 #include "rsx/rsx_intf.cpp"
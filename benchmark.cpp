@@ -0,0 +1,356 @@
+/* Headless benchmark runner, built with "make benchmark".
+ *
+ * Acts as a minimal libretro frontend linked directly against the core:
+ * loads a disc image or PS-EXE, runs a number of frames with video, audio
+ * and input stubbed out and reports how fast the emulation ran, and how
+ * often each event source fired. Built with PROFILE=1 the host time spent
+ * in each subsystem is reported as well.
+ *
+ * Usage: mednafen_psx_benchmark [options] <content>
+ *   -n <frames>     frames to time (default 1800)
+ *   -w <frames>     frames to run before timing starts (default 60)
+ *   -s <dir>        system (BIOS) and save directory (default ".")
+ *   -o <key=value>  set a core option, may be repeated
+ *   -v              show core log messages below warning level
+ *
+ * Built with GPU_REPLAY=1, a GPU command stream can be replayed instead
+ * (see mednafen/psx/gpu_replay.h). Content is optional then, and no BIOS
+ * is needed:
+ *   -r <stream>     replay the stream at each upscale shift and exit,
+ *                   with status 1 if a frame didn't match the golden file
+ *   -g <golden>     golden frame hashes, written if the file doesn't exist
+ *   -x <shift>      highest upscale shift to replay at (default 2)
+ *   -l              play the stream one frame per retro_run() instead, with
+ *                   whichever renderer the options select, and time it
+ *                   like content; it stops early when the stream ends and
+ *                   only warms up if -w is given
+ * The per-command timings are logged at info level, see -v.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <string>
+#include <vector>
+
+#include <libretro.h>
+
+#include "mednafen/mednafen.h"
+#include "mednafen/psx/psx.h"
+#include "mednafen/psx/profile.h"
+#include "mednafen/psx/gpu_replay.h"
+
+struct bench_option
+{
+   std::string key;
+   std::string value;
+};
+
+static std::vector<bench_option> options;
+static const char *system_dir = ".";
+static bool verbose           = false;
+static bool replay_live       = false;
+
+static void set_option(const char *key, const char *value)
+{
+   size_t i;
+   bench_option option;
+
+   for (i = 0; i < options.size(); i++)
+   {
+      if (options[i].key == key)
+      {
+         options[i].value = value;
+         return;
+      }
+   }
+
+   option.key   = key;
+   option.value = value;
+   options.push_back(option);
+}
+
+static const char *get_option(const char *key)
+{
+   size_t i;
+
+   for (i = 0; i < options.size(); i++)
+      if (options[i].key == key)
+         return options[i].value.c_str();
+
+   return NULL;
+}
+
+/* Values look like "Description; default|other|...". Options given on
+ * the command line take precedence over the defaults. */
+static void set_defaults(const struct retro_variable *vars)
+{
+   for (; vars->key; vars++)
+   {
+      const char *value = vars->value ? strstr(vars->value, "; ") : NULL;
+      const char *end;
+
+      if (!value || get_option(vars->key))
+         continue;
+
+      value += 2;
+      end    = strchr(value, '|');
+
+      set_option(vars->key, std::string(value, end ? end - value : strlen(value)).c_str());
+   }
+}
+
+static void bench_log(enum retro_log_level level, const char *fmt, ...)
+{
+   va_list ap;
+
+   if (level < RETRO_LOG_WARN && !verbose)
+      return;
+
+   va_start(ap, fmt);
+   vfprintf(stderr, fmt, ap);
+   va_end(ap);
+}
+
+static bool bench_environment(unsigned cmd, void *data)
+{
+   switch (cmd)
+   {
+      case RETRO_ENVIRONMENT_GET_LOG_INTERFACE:
+         ((struct retro_log_callback*)data)->log = bench_log;
+         return true;
+      case RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY:
+      case RETRO_ENVIRONMENT_GET_SAVE_DIRECTORY:
+         *(const char**)data = system_dir;
+         return true;
+      case RETRO_ENVIRONMENT_SET_VARIABLES:
+         set_defaults((const struct retro_variable*)data);
+         return true;
+      case RETRO_ENVIRONMENT_GET_VARIABLE:
+         {
+            struct retro_variable *var = (struct retro_variable*)data;
+
+            var->value = get_option(var->key);
+            return var->value != NULL;
+         }
+      case RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE:
+         *(bool*)data = false;
+         return true;
+      case RETRO_ENVIRONMENT_SET_PIXEL_FORMAT:
+         return *(const enum retro_pixel_format*)data == RETRO_PIXEL_FORMAT_XRGB8888;
+      case RETRO_ENVIRONMENT_GET_CAN_DUPE:
+         *(bool*)data = true;
+         return true;
+      case RETRO_ENVIRONMENT_SET_GEOMETRY:
+      case RETRO_ENVIRONMENT_SET_SYSTEM_AV_INFO:
+      case RETRO_ENVIRONMENT_SET_PERFORMANCE_LEVEL:
+         return true;
+      default:
+         break;
+   }
+
+   return false;
+}
+
+static void bench_video(const void *data, unsigned width, unsigned height, size_t pitch)
+{
+}
+
+static void bench_audio(int16_t left, int16_t right)
+{
+}
+
+static size_t bench_audio_batch(const int16_t *data, size_t frames)
+{
+   return frames;
+}
+
+static void bench_input_poll(void)
+{
+}
+
+static int16_t bench_input_state(unsigned port, unsigned device, unsigned index, unsigned id)
+{
+   return 0;
+}
+
+/* A live replay ends with its stream. */
+static bool more_frames(void)
+{
+#ifdef GPU_REPLAY
+   if (replay_live)
+      return GPU_Replay_Live();
+#endif
+   return true;
+}
+
+static void usage(const char *name)
+{
+   fprintf(stderr, "Usage: %s [-n frames] [-w frames] [-s dir] [-o key=value]... [-v] <content>\n", name);
+#ifdef GPU_REPLAY
+   fprintf(stderr, "       %s [-s dir] [-o key=value]... [-v] -r stream [-g golden] [-x shift] [content]\n", name);
+   fprintf(stderr, "       %s [-n frames] [-w frames] [-s dir] [-o key=value]... [-v] -l -r stream [content]\n", name);
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+   struct retro_game_info game = {0};
+   struct retro_system_av_info av_info;
+   unsigned frames = 1800;
+   unsigned warmup = ~0u;
+   uint64 fired[PSX_EVENT__MAX];
+   unsigned i;
+   uint64 start, elapsed;
+   double seconds;
+   int arg;
+   bool need_content = true;
+   const char *name;
+#ifdef GPU_REPLAY
+   const char *replay_stream = NULL;
+   const char *replay_golden = NULL;
+   unsigned replay_max_shift = 2;
+#endif
+
+   for (arg = 1; arg < argc; arg++)
+   {
+      const bool has_value = arg + 1 < argc;
+
+      if (!strcmp(argv[arg], "-n") && has_value)
+         frames = strtoul(argv[++arg], NULL, 0);
+      else if (!strcmp(argv[arg], "-w") && has_value)
+         warmup = strtoul(argv[++arg], NULL, 0);
+      else if (!strcmp(argv[arg], "-s") && has_value)
+         system_dir = argv[++arg];
+#ifdef GPU_REPLAY
+      else if (!strcmp(argv[arg], "-r") && has_value)
+         replay_stream = argv[++arg];
+      else if (!strcmp(argv[arg], "-g") && has_value)
+         replay_golden = argv[++arg];
+      else if (!strcmp(argv[arg], "-x") && has_value)
+         replay_max_shift = strtoul(argv[++arg], NULL, 0);
+      else if (!strcmp(argv[arg], "-l"))
+         replay_live = true;
+#endif
+      else if (!strcmp(argv[arg], "-o") && has_value)
+      {
+         std::string option = argv[++arg];
+         size_t eq          = option.find('=');
+
+         if (eq == std::string::npos)
+         {
+            usage(argv[0]);
+            return 1;
+         }
+
+         set_option(option.substr(0, eq).c_str(), option.substr(eq + 1).c_str());
+      }
+      else if (!strcmp(argv[arg], "-v"))
+         verbose = true;
+      else
+         break;
+   }
+
+#ifdef GPU_REPLAY
+   need_content = !replay_stream;
+#endif
+
+   /* Warming up would eat into a live replay's stream. */
+   if (warmup == ~0u)
+      warmup = replay_live ? 0 : 60;
+
+   if (arg < argc - 1 || (arg == argc && need_content) || !frames)
+   {
+      usage(argv[0]);
+      return 1;
+   }
+
+   if (arg < argc)
+      game.path = argv[arg];
+   name = game.path;
+
+   retro_set_environment(bench_environment);
+   retro_set_video_refresh(bench_video);
+   retro_set_audio_sample(bench_audio);
+   retro_set_audio_sample_batch(bench_audio_batch);
+   retro_set_input_poll(bench_input_poll);
+   retro_set_input_state(bench_input_state);
+
+   retro_init();
+
+   if (!retro_load_game(game.path ? &game : NULL))
+   {
+      fprintf(stderr, "Couldn't load %s\n", game.path ? game.path : "the core without content");
+      retro_deinit();
+      return 1;
+   }
+
+#ifdef GPU_REPLAY
+   if (replay_stream && !replay_live)
+   {
+      bool ok = GPU_Replay_Run(replay_stream, replay_golden, replay_max_shift);
+
+      printf("%s: %s\n", replay_stream, ok ? "passed" : "failed");
+
+      retro_unload_game();
+      retro_deinit();
+
+      return ok ? 0 : 1;
+   }
+
+   if (replay_stream)
+   {
+      if (!GPU_Replay_Open(replay_stream))
+      {
+         fprintf(stderr, "Couldn't open %s\n", replay_stream);
+         retro_unload_game();
+         retro_deinit();
+         return 1;
+      }
+
+      name = replay_stream;
+   }
+#endif
+
+   retro_get_system_av_info(&av_info);
+
+   for (i = 0; i < warmup && more_frames(); i++)
+      retro_run();
+
+#ifdef PSX_PROFILE
+   PSX_Profile_Reset();
+#endif
+   for (i = 0; i < PSX_EventSources(); i++)
+      fired[i] = PSX_EventFired(i);
+   start = PSX_Profile_Clock();
+
+   for (i = 0; i < frames && more_frames(); i++)
+      retro_run();
+
+   elapsed = PSX_Profile_Clock() - start;
+   seconds = elapsed / 1000000000.0;
+
+   if (!(frames = i))
+   {
+      fprintf(stderr, "%s ended before timing started\n", name);
+      retro_unload_game();
+      retro_deinit();
+      return 1;
+   }
+
+   printf("%s: %u frames in %.3f s, %.2f fps (%.1f%% of %.2f Hz)\n",
+         name, frames, seconds, frames / seconds,
+         frames / seconds * 100.0 / av_info.timing.fps, av_info.timing.fps);
+   for (i = 0; i < PSX_EventSources(); i++)
+      printf("%-12s %10.1f events/frame\n", PSX_EventName(i),
+            (double)(PSX_EventFired(i) - fired[i]) / frames);
+#ifdef PSX_PROFILE
+   PSX_Profile_Print(stdout, elapsed);
+#endif
+
+   retro_unload_game();
+   retro_deinit();
+
+   return 0;
+}
@@ -529,6 +529,19 @@ unsigned input_get_player_count()
    return players;
 }
 
+bool input_has_lightgun()
+{
+   unsigned i;
+
+   for ( i = 0; i < MAX_CONTROLLERS; i++ )
+   {
+      if ( input_type[ i ] == RETRO_DEVICE_PS_GUNCON || input_type[ i ] == RETRO_DEVICE_PS_JUSTIFIER )
+         return true;
+   }
+
+   return false;
+}
+
 void input_handle_lightgun_touchscreen( INPUT_DATA *p_input, int iplayer, retro_input_state_t input_state_cb )
 {
    int gun_x_raw = input_state_cb( iplayer, RETRO_DEVICE_POINTER, 0, RETRO_DEVICE_ID_POINTER_X);
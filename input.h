@@ -29,6 +29,8 @@ extern void input_set_player_count( unsigned players );
 
 extern unsigned input_get_player_count();
 
+extern bool input_has_lightgun();
+
 void input_update(bool supports_bitmasks, retro_input_state_t input_state_cb );
 
 enum
@@ -8,6 +8,7 @@
 #ifdef NEED_DEINTERLACER
 #include "mednafen/video/Deinterlacer.h"
 #endif
+#include "mednafen/sound/Resampler.h"
 #include <libretro.h>
 #include <rthreads/rthreads.h>
 #include <streams/file_stream.h>
@@ -68,6 +69,10 @@ static retro_input_state_t input_state_cb;
 static unsigned frame_count = 0;
 static unsigned internal_frame_count = 0;
 static bool display_internal_framerate = false;
+#ifdef PSX_PROFILE
+static bool display_profile = false;
+static unsigned profile_frame_count = 0;
+#endif
 static bool allow_frame_duping = false;
 static bool failed_init = false;
 static unsigned image_offset = 0;
@@ -89,6 +94,9 @@ static int memcard_right_index_old;
 
 unsigned cd_2x_speedup = 1;
 bool cd_async = false;
+unsigned cd_chd_cache_size = 4; // MiB
+unsigned cd_pbp_cache_size = 4; // MiB
+char cd_decoded_cache_dir[4096];
 bool cd_warned_slow = false;
 int64 cd_slow_timeout = 8000; // microseconds
 
@@ -311,10 +319,13 @@ static void extract_directory(char *buf, const char *path, size_t size)
 #include "mednafen/psx/psx.h"
 #include "mednafen/psx/mdec.h"
 #include "mednafen/psx/frontio.h"
+#include "mednafen/psx/memcard_writer.h"
 #include "mednafen/psx/timer.h"
 #include "mednafen/psx/sio.h"
 #include "mednafen/psx/cdc.h"
 #include "mednafen/psx/spu.h"
+#include "mednafen/psx/gpu_replay.h"
+#include "mednafen/psx/profile.h"
 #include "mednafen/mempatcher.h"
 
 #include <stdarg.h>
@@ -497,155 +508,172 @@ void PSX_SetDMACycleSteal(unsigned stealage)
 
 static int32_t Running; // Set to -1 when not desiring exit, and 0 when we are.
 
-struct event_list_entry
+struct event_source
 {
-   uint32_t which;
+   const char *name;
+   psx_event_handler_t handler;
    int32_t event_time;
-   event_list_entry *prev;
-   event_list_entry *next;
+   uint64_t fired;
+};
+
+static int32_t GPU_EventUpdate(const int32_t timestamp)
+{
+   return GPU_Update(timestamp);
+}
+
+static int32_t CDC_EventUpdate(const int32_t timestamp)
+{
+   return PSX_CDC->Update(timestamp);
+}
+
+static int32_t TIMER_EventUpdate(const int32_t timestamp)
+{
+   return TIMER_Update(timestamp);
+}
+
+static int32_t DMA_EventUpdate(const int32_t timestamp)
+{
+   return DMA_Update(timestamp);
+}
+
+static int32_t FIO_EventUpdate(const int32_t timestamp)
+{
+   return PSX_FIO->Update(timestamp);
+}
+
+static event_source events[PSX_EVENT__MAX] =
+{
+   { "gpu",   GPU_EventUpdate },
+   { "cdc",   CDC_EventUpdate },
+   { "timer", TIMER_EventUpdate },
+   { "dma",   DMA_EventUpdate },
+   { "fio",   FIO_EventUpdate },
 };
+static unsigned event_count = PSX_EVENT__BUILTIN;
 
-static event_list_entry events[PSX_EVENT__COUNT];
+// Sources sorted by event time. Sources with the same time keep the order
+// the old linked list gave them, so events still run in the same order:
+// a source moved earlier goes after the ones it ties with, a source moved
+// later goes before them.
+static uint8_t event_order[PSX_EVENT__MAX];
+static uint8_t event_pos[PSX_EVENT__MAX];
+
+// Time of the earliest event, i.e. events[event_order[0]].event_time.
+static int32_t event_next_ts;
 
 static void EventReset(void)
 {
    unsigned i;
-   for(i = 0; i < PSX_EVENT__COUNT; i++)
+   for(i = 0; i < event_count; i++)
    {
-      events[i].which = i;
+      events[i].event_time = PSX_EVENT_MAXTS;
+      event_order[i]       = i;
+      event_pos[i]         = i;
+   }
 
-      if(i == PSX_EVENT__SYNFIRST)
-        events[i].event_time = (int32_t)0x80000000;
-      else if(i == PSX_EVENT__SYNLAST)
-         events[i].event_time = 0x7FFFFFFF;
-      else
-         events[i].event_time = PSX_EVENT_MAXTS;
+   event_next_ts = PSX_EVENT_MAXTS;
+}
 
-      events[i].prev = (i > 0) ? &events[i - 1] : NULL;
-      events[i].next = (i < (PSX_EVENT__COUNT - 1)) ? &events[i + 1] : NULL;
-   }
+int PSX_RegisterEvent(const char *name, psx_event_handler_t handler)
+{
+   unsigned type = event_count;
+
+   if(type >= PSX_EVENT__MAX)
+      return -1;
+
+   // Idle until the source schedules itself, after every other idle source.
+   events[type].name       = name;
+   events[type].handler    = handler;
+   events[type].event_time = PSX_EVENT_MAXTS;
+   events[type].fired      = 0;
+   event_order[type]       = type;
+   event_pos[type]         = type;
+   event_count++;
+
+   return type;
 }
 
-//static void RemoveEvent(event_list_entry *e)
-//{
-// e->prev->next = e->next;
-// e->next->prev = e->prev;
-//}
+unsigned PSX_EventSources(void)
+{
+   return event_count;
+}
+
+const char *PSX_EventName(const int type)
+{
+   return events[type].name;
+}
+
+uint64_t PSX_EventFired(const int type)
+{
+   return events[type].fired;
+}
 
 static void RebaseTS(const int32_t timestamp)
 {
    unsigned i;
-   for(i = 0; i < PSX_EVENT__COUNT; i++)
+   for(i = 0; i < event_count; i++)
    {
-      if(i == PSX_EVENT__SYNFIRST || i == PSX_EVENT__SYNLAST)
-         continue;
-
       assert(events[i].event_time > timestamp);
       events[i].event_time -= timestamp;
    }
 
-   PSX_CPU->SetEventNT(events[PSX_EVENT__SYNFIRST].next->event_time);
+   event_next_ts = events[event_order[0]].event_time;
+   PSX_CPU->SetEventNT(event_next_ts);
 }
 
 void PSX_SetEventNT(const int type, const int32_t next_timestamp)
 {
-   event_list_entry *e = &events[type];
+   event_source *e = &events[type];
+   unsigned pos    = event_pos[type];
 
    if(next_timestamp < e->event_time)
    {
-      event_list_entry *fe = e;
-
-      do
+      while(pos > 0 && next_timestamp < events[event_order[pos - 1]].event_time)
       {
-         fe = fe->prev;
-      }while(next_timestamp < fe->event_time);
-
-      // Remove this event from the list, temporarily of course.
-      e->prev->next = e->next;
-      e->next->prev = e->prev;
-
-      // Insert into the list, just after "fe".
-      e->prev = fe;
-      e->next = fe->next;
-      fe->next->prev = e;
-      fe->next = e;
-
-      e->event_time = next_timestamp;
+         event_order[pos] = event_order[pos - 1];
+         event_pos[event_order[pos]] = pos;
+         pos--;
+      }
    }
    else if(next_timestamp > e->event_time)
    {
-      event_list_entry *fe = e;
-
-      do
+      while(pos + 1 < event_count && next_timestamp > events[event_order[pos + 1]].event_time)
       {
-         fe = fe->next;
-      } while(next_timestamp > fe->event_time);
-
-      // Remove this event from the list, temporarily of course
-      e->prev->next = e->next;
-      e->next->prev = e->prev;
-
-      // Insert into the list, just BEFORE "fe".
-      e->prev = fe->prev;
-      e->next = fe;
-      fe->prev->next = e;
-      fe->prev = e;
-
-      e->event_time = next_timestamp;
+         event_order[pos] = event_order[pos + 1];
+         event_pos[event_order[pos]] = pos;
+         pos++;
+      }
    }
 
-   PSX_CPU->SetEventNT(events[PSX_EVENT__SYNFIRST].next->event_time & Running);
+   event_order[pos] = type;
+   event_pos[type]  = pos;
+   e->event_time    = next_timestamp;
+   event_next_ts    = events[event_order[0]].event_time;
+
+   PSX_CPU->SetEventNT(event_next_ts & Running);
 }
 
 // Called from debug.cpp too.
 void ForceEventUpdates(const int32_t timestamp)
 {
-   PSX_SetEventNT(PSX_EVENT_GPU, GPU_Update(timestamp));
-   PSX_SetEventNT(PSX_EVENT_CDC, PSX_CDC->Update(timestamp));
-
-   PSX_SetEventNT(PSX_EVENT_TIMER, TIMER_Update(timestamp));
-
-   PSX_SetEventNT(PSX_EVENT_DMA, DMA_Update(timestamp));
+   unsigned i;
 
-   PSX_SetEventNT(PSX_EVENT_FIO, PSX_FIO->Update(timestamp));
+   for(i = 0; i < event_count; i++)
+      PSX_SetEventNT(i, events[i].handler(timestamp));
 
-   PSX_CPU->SetEventNT(events[PSX_EVENT__SYNFIRST].next->event_time);
+   PSX_CPU->SetEventNT(event_next_ts);
 }
 
 bool MDFN_FASTCALL PSX_EventHandler(const int32_t timestamp)
 {
-   event_list_entry *e = events[PSX_EVENT__SYNFIRST].next;
-
-   while(timestamp >= e->event_time)   // If Running = 0, PSX_EventHandler() may be called even if there isn't an event per-se, so while() instead of do { ... } while
+   // If Running = 0, PSX_EventHandler() may be called even if there isn't an event per-se, so while() instead of do { ... } while
+   while(timestamp >= event_next_ts)
    {
-      int32_t nt;
-      event_list_entry *prev = e->prev;
-
-      switch(e->which)
-      {
-         default:
-            abort();
-         case PSX_EVENT_GPU:
-            nt = GPU_Update(e->event_time);
-            break;
-         case PSX_EVENT_CDC:
-            nt = PSX_CDC->Update(e->event_time);
-            break;
-         case PSX_EVENT_TIMER:
-            nt = TIMER_Update(e->event_time);
-            break;
-         case PSX_EVENT_DMA:
-            nt = DMA_Update(e->event_time);
-            break;
-         case PSX_EVENT_FIO:
-            nt = PSX_FIO->Update(e->event_time);
-            break;
-      }
+      const unsigned type = event_order[0];
+      event_source *e     = &events[type];
 
-      PSX_SetEventNT(e->which, nt);
-
-      // Order of events can change due to calling PSX_SetEventNT(), this prev business ensures we don't miss an event due to reordering.
-      e = prev->next;
+      e->fired++;
+      PSX_SetEventNT(type, e->handler(e->event_time));
    }
 
    return(Running);
@@ -724,7 +752,7 @@ template<typename T, bool IsWrite, bool Access24> static INLINE void MemRW(int32
       return;
    }
 
-   if(timestamp >= events[PSX_EVENT__SYNFIRST].next->event_time)
+   if(timestamp >= event_next_ts)
       PSX_EventHandler(timestamp);
 
    if(A >= 0x1F801000 && A <= 0x1F802FFF)
@@ -743,7 +771,7 @@ template<typename T, bool IsWrite, bool Access24> static INLINE void MemRW(int32
             {
                //timestamp += 15;
 
-               //if(timestamp >= events[PSX_EVENT__SYNFIRST].next->event_time)
+               //if(timestamp >= event_next_ts)
                // PSX_EventHandler(timestamp);
 
                PSX_SPU->Write(timestamp, A | 0, V);
@@ -753,7 +781,7 @@ template<typename T, bool IsWrite, bool Access24> static INLINE void MemRW(int32
             {
                timestamp += 36;
 
-               if(timestamp >= events[PSX_EVENT__SYNFIRST].next->event_time)
+               if(timestamp >= event_next_ts)
                   PSX_EventHandler(timestamp);
 
                V = PSX_SPU->Read(timestamp, A) | (PSX_SPU->Read(timestamp, A | 2) << 16);
@@ -765,7 +793,7 @@ template<typename T, bool IsWrite, bool Access24> static INLINE void MemRW(int32
             {
                //timestamp += 8;
 
-               //if(timestamp >= events[PSX_EVENT__SYNFIRST].next->event_time)
+               //if(timestamp >= event_next_ts)
                // PSX_EventHandler(timestamp);
 
                PSX_SPU->Write(timestamp, A & ~1, V);
@@ -774,7 +802,7 @@ template<typename T, bool IsWrite, bool Access24> static INLINE void MemRW(int32
             {
                timestamp += 16; // Just a guess, need to test.
 
-               if(timestamp >= events[PSX_EVENT__SYNFIRST].next->event_time)
+               if(timestamp >= event_next_ts)
                   PSX_EventHandler(timestamp);
 
                V = PSX_SPU->Read(timestamp, A & ~1);
@@ -2322,6 +2350,10 @@ static void Cleanup(void)
    PIOMem = NULL;
 
    cdifs = NULL;
+
+   // Sources registered for this content go with it, so that reloading
+   // doesn't register them a second time.
+   event_count = PSX_EVENT__BUILTIN;
 }
 
 static void CloseGame(void)
@@ -2358,6 +2390,9 @@ static void CloseGame(void)
             log_cb(RETRO_LOG_ERROR, "%s\n", e.what());
          }
       }
+
+      // Don't return before the cards are on disk.
+      MemcardWriter_Kill();
    }
 
    Cleanup();
@@ -2421,6 +2456,10 @@ static void CDSelect(void)
    }
 }
 
+/* Converts the SPU's native rate to audio_output_rate when they differ. */
+static Resampler resampler;
+static int16_t resample_buf[(4096 * 96000 + SOUND_FREQUENCY - 1) / SOUND_FREQUENCY + 1][2];
+
 extern "C" int StateAction(StateMem *sm, int load, int data_only)
 {
    SFORMAT StateRegs[] =
@@ -2470,6 +2509,10 @@ extern "C" int StateAction(StateMem *sm, int load, int data_only)
    ret &= GPU_StateAction(sm, load, data_only);
    ret &= PSX_SPU->StateAction(sm, load, data_only);
 
+   // States without the resampler's section load with its history cleared.
+   if(!resampler.StateAction(sm, load, data_only, "RESAMPLER") && !load)
+      ret = 0;
+
    ret &= PSX_FIO->StateAction(sm, load, data_only);
 
    ret &= IRQ_StateAction(sm, load, data_only); // Do it last.
@@ -2820,9 +2863,42 @@ static Deinterlacer deint;
 
 static MDFN_Surface *surf = NULL;
 
-static void alloc_surface(void)
+/* Software renderer output options, and whether surf is RGB565 rather
+ * than XRGB8888. */
+static bool software_rgb565 = false;
+static bool software_direct = false;
+static bool surface_rgb565 = false;
+static bool frontend_can_dupe = false;
+
+/* Frames can be rendered straight into a framebuffer the frontend hands
+ * out, which has to be asked for before the frame is emulated. Its size is
+ * predicted from the previous frame (upscaled, after overscan cropping);
+ * direct_surf wraps it for the GPU. */
+static struct
+{
+   unsigned x, width, height;
+   bool valid;
+} direct_geometry;
+static MDFN_Surface *direct_surf = NULL;
+
+static MDFN_PixelFormat surface_format(bool rgb565)
 {
    MDFN_PixelFormat pix_fmt(MDFN_COLORSPACE_RGB, 16, 8, 0, 24);
+
+   if (rgb565)
+   {
+      pix_fmt.bpp    = 16;
+      pix_fmt.Rshift = 11;
+      pix_fmt.Gshift = 5;
+      pix_fmt.Bshift = 0;
+   }
+
+   return pix_fmt;
+}
+
+static void alloc_surface(void)
+{
+   MDFN_PixelFormat pix_fmt = surface_format(surface_rgb565);
    uint32_t width  = MEDNAFEN_CORE_GEOMETRY_MAX_W;
    uint32_t height = content_is_pal ? MEDNAFEN_CORE_GEOMETRY_MAX_H  : 480;
 
@@ -2833,6 +2909,64 @@ static void alloc_surface(void)
       delete surf;
 
    surf = new MDFN_Surface(NULL, width, height, width, pix_fmt);
+
+   direct_geometry.valid = false;
+   GPU_invalidate_scanout();
+}
+
+/* Asks the frontend for a framebuffer to render the coming frame into,
+ * sized like the last frame, and points direct_surf at it. The frontend
+ * picks the pixel format, either one the GPU can output is fine. */
+static bool direct_framebuffer_get(struct retro_framebuffer *fb)
+{
+   MDFN_PixelFormat pix_fmt;
+   unsigned bytes_per_pixel;
+
+   if (!software_direct || !direct_geometry.valid || gui_show
+         || rsx_intf_is_type() != RSX_SOFTWARE
+         || input_has_lightgun())
+      return false;
+
+   fb->width        = direct_geometry.width;
+   fb->height       = direct_geometry.height;
+   fb->access_flags = RETRO_MEMORY_ACCESS_WRITE;
+
+   if (!environ_cb(RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER, fb) || !fb->data)
+      return false;
+
+   switch (fb->format)
+   {
+      case RETRO_PIXEL_FORMAT_XRGB8888:
+         pix_fmt = surface_format(false);
+         break;
+      case RETRO_PIXEL_FORMAT_RGB565:
+         pix_fmt = surface_format(true);
+         break;
+      default:
+         return false;
+   }
+
+   bytes_per_pixel = pix_fmt.bpp / 8;
+
+   if (fb->pitch % bytes_per_pixel || fb->pitch < fb->width * bytes_per_pixel)
+      return false;
+
+   /* The frontend's buffer can move every frame, but a new surface is only
+    * needed when the pixel format changes. */
+   if (!direct_surf || direct_surf->format.bpp != pix_fmt.bpp)
+   {
+      delete direct_surf;
+      direct_surf = new MDFN_Surface(fb->data, fb->width, fb->height,
+            fb->pitch / bytes_per_pixel, pix_fmt);
+      return true;
+   }
+
+   direct_surf->pixels     = (uint32 *)fb->data;
+   direct_surf->w          = fb->width;
+   direct_surf->h          = fb->height;
+   direct_surf->pitchinpix = fb->pitch / bytes_per_pixel;
+
+   return true;
 }
 
 static void check_system_specs(void)
@@ -3134,6 +3268,7 @@ void retro_init(void)
 void retro_reset(void)
 {
    DoSimpleCommand(MDFN_MSC_RESET);
+   resampler.Clear();
 }
 
 bool retro_load_game_special(unsigned, const struct retro_game_info *, size_t)
@@ -3165,6 +3300,8 @@ static void check_variables(bool startup)
    var.key = BEETLE_OPT(cd_access_method);
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
    {
+      cd_decoded_cache_dir[0] = '\0';
+
       if (strcmp(var.value, "sync") == 0)
       {
          old_cdimagecache = false;
@@ -3180,7 +3317,46 @@ static void check_variables(bool startup)
          old_cdimagecache = true;
          cd_async = false;
       }
+      else if (strcmp(var.value, "precache_decoded") == 0)
+      {
+         old_cdimagecache = true;
+         cd_async = false;
+         int r = snprintf(cd_decoded_cache_dir, sizeof(cd_decoded_cache_dir), "%s%cbeetle_psx_cache",
+               retro_base_directory, retro_slash);
+         if (r < 0 || r >= (int)sizeof(cd_decoded_cache_dir))
+         {
+            log_cb(RETRO_LOG_WARN, "Decoded disc cache path longer than %u, not caching.\n",
+                  (unsigned)sizeof(cd_decoded_cache_dir) - 1);
+            cd_decoded_cache_dir[0] = '\0';
+         }
+      }
+   }
+#endif
+
+#ifdef HAVE_CHD
+   var.key = BEETLE_OPT(cd_chd_cache);
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      if (strcmp(var.value, "disabled") == 0)
+         cd_chd_cache_size = 0;
+      else
+         cd_chd_cache_size = atoi(var.value);
    }
+   else
+      cd_chd_cache_size = 4;
+#endif
+
+#ifdef HAVE_PBP
+   var.key = BEETLE_OPT(cd_pbp_cache);
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      if (strcmp(var.value, "disabled") == 0)
+         cd_pbp_cache_size = 0;
+      else
+         cd_pbp_cache_size = atoi(var.value);
+   }
+   else
+      cd_pbp_cache_size = 4;
 #endif
 
 #ifdef HAVE_LIGHTREC
@@ -3349,6 +3525,24 @@ static void check_variables(bool startup)
       }
    }
 
+   var.key = BEETLE_OPT(audio_sample_rate);
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      unsigned rate = strtoul(var.value, NULL, 10);
+
+      if (rate < 32000 || rate > 96000)
+         rate = SOUND_FREQUENCY;
+
+      if (rate != audio_output_rate)
+      {
+         if (!startup)
+            has_new_timing = true;
+
+         audio_output_rate = rate;
+         resampler.SetRates(SOUND_FREQUENCY, audio_output_rate);
+      }
+   }
+
    var.key = BEETLE_OPT(aspect_ratio);
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
    {
@@ -3462,6 +3656,34 @@ static void check_variables(bool startup)
    else
       psx_gpu_dither_mode = DITHER_NATIVE;
 
+#ifdef HAVE_THREADS
+   var.key = BEETLE_OPT(renderer_software_threads);
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      if (strcmp(var.value, "disabled") == 0)
+         GPU_set_render_threads(0);
+      else
+         GPU_set_render_threads(atoi(var.value));
+   }
+   else
+      GPU_set_render_threads(0);
+#endif
+
+   var.key = BEETLE_OPT(renderer_software_format);
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      software_rgb565 = (strcmp(var.value, "rgb565") == 0);
+   else
+      software_rgb565 = false;
+
+   var.key = BEETLE_OPT(renderer_software_direct);
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      software_direct = (strcmp(var.value, "enabled") == 0);
+   else
+      software_direct = false;
+
+   frontend_can_dupe = false;
+   environ_cb(RETRO_ENVIRONMENT_GET_CAN_DUPE, &frontend_can_dupe);
+
    // iCB: PGXP settings
    var.key = BEETLE_OPT(pgxp_mode);
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
@@ -3735,6 +3957,14 @@ static void check_variables(bool startup)
    else
       display_internal_framerate = false;
 
+#ifdef PSX_PROFILE
+   var.key = BEETLE_OPT(display_profile);
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      display_profile = (strcmp(var.value, "enabled") == 0);
+   else
+      display_profile = false;
+#endif
+
    var.key = BEETLE_OPT(crop_overscan);
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
    {
@@ -4028,10 +4258,32 @@ static MDFNGI *MDFNI_LoadCD(const char *devicename)
 }
 #endif
 
+#ifdef GPU_REPLAY
+/* Brings the system up with no disc and no firmware, for GPU command
+ * streams to be replayed into. */
+static MDFNGI *MDFNI_LoadNoContent(void)
+{
+   InitCommon(NULL, false);
+
+   /* Nothing runs from the firmware, so don't put up the missing firmware
+    * message. */
+   gui_show = false;
+
+   MDFNGameInfo = &EmulatedPSX;
+
+   return(MDFNGameInfo);
+}
+#endif
+
 static MDFNGI *MDFNI_LoadGame(const char *name)
 {
    RFILE *GameFile = NULL;
 
+#ifdef GPU_REPLAY
+   if(!*name)
+      return MDFNI_LoadNoContent();
+#endif
+
    if(strlen(name) > 4 && (
       !strcasecmp(name + strlen(name) - 4, ".cue") ||
       !strcasecmp(name + strlen(name) - 4, ".ccd") ||
@@ -4065,6 +4317,50 @@ error:
    return NULL;
 }
 
+#ifdef GPU_REPLAY
+static bool gpu_replay_playing;
+
+/* Sets up the GPU command stream replay or capture requested through the
+ * environment, if any. See mednafen/psx/gpu_replay.h.
+ *
+ * BEETLE_GPU_REPLAY names a stream to replay. It is checked against
+ * BEETLE_GPU_REPLAY_GOLDEN before the content starts, or with
+ * BEETLE_GPU_REPLAY_LIVE set it is played in place of the content, one
+ * frame per retro_run(). BEETLE_GPU_CAPTURE names a stream to record,
+ * optionally stopping after BEETLE_GPU_CAPTURE_FRAMES frames.
+ *
+ * A replay doesn't need content or firmware, the core can be started
+ * without either. The benchmark runner drives replays directly. */
+static void gpu_replay_from_env(void)
+{
+   const char *stream    = getenv("BEETLE_GPU_REPLAY");
+   const char *golden    = getenv("BEETLE_GPU_REPLAY_GOLDEN");
+   const char *max_shift = getenv("BEETLE_GPU_REPLAY_MAX_SHIFT");
+   const char *capture   = getenv("BEETLE_GPU_CAPTURE");
+   const char *frames    = getenv("BEETLE_GPU_CAPTURE_FRAMES");
+
+   if (!stream)
+   {
+      if (capture)
+         GPU_Capture_Start(capture, frames ? atoi(frames) : 0);
+      return;
+   }
+
+   if (getenv("BEETLE_GPU_REPLAY_LIVE"))
+   {
+      GPU_Replay_Open(stream);
+      return;
+   }
+
+   if (GPU_Replay_Run(stream, golden, max_shift ? atoi(max_shift) : 2))
+      log_cb(RETRO_LOG_INFO, "[GPU replay] Done\n");
+   else
+      log_cb(RETRO_LOG_ERROR, "[GPU replay] Failed\n");
+
+   PSX_Power();
+}
+#endif
+
 bool retro_load_game(const struct retro_game_info *info)
 {
    char tocbasepath[4096];
@@ -4077,16 +4373,25 @@ bool retro_load_game(const struct retro_game_info *info)
    enum retro_pixel_format fmt = RETRO_PIXEL_FORMAT_XRGB8888;
    if (!environ_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &fmt))
       return false;
+   surface_rgb565 = false;
 
-   extract_basename(retro_cd_base_name,       info->path, sizeof(retro_cd_base_name));
-   extract_directory(retro_cd_base_directory, info->path, sizeof(retro_cd_base_directory));
+#ifdef GPU_REPLAY
+   /* Without content there is only the GPU to replay streams into. */
+   if (!info || !info->path)
+      retro_cd_path[0] = '\0';
+   else
+#endif
+   {
+      extract_basename(retro_cd_base_name,       info->path, sizeof(retro_cd_base_name));
+      extract_directory(retro_cd_base_directory, info->path, sizeof(retro_cd_base_directory));
 
-   int r = snprintf(tocbasepath, sizeof(tocbasepath), "%s%c%s.toc", retro_cd_base_directory, retro_slash, retro_cd_base_name);
+      int r = snprintf(tocbasepath, sizeof(tocbasepath), "%s%c%s.toc", retro_cd_base_directory, retro_slash, retro_cd_base_name);
 
-   if (r >= 0 && r < 4096 && filestream_exists(tocbasepath))
-      snprintf(retro_cd_path, sizeof(retro_cd_path), "%s", tocbasepath);
-   else
-      snprintf(retro_cd_path, sizeof(retro_cd_path), "%s", info->path);
+      if (r >= 0 && r < 4096 && filestream_exists(tocbasepath))
+         snprintf(retro_cd_path, sizeof(retro_cd_path), "%s", tocbasepath);
+      else
+         snprintf(retro_cd_path, sizeof(retro_cd_path), "%s", info->path);
+   }
 
    check_variables(true);
 
@@ -4109,6 +4414,7 @@ bool retro_load_game(const struct retro_game_info *info)
    PrevInterlaced = false;
    deint.ClearState();
 #endif
+   resampler.Clear();
 
    input_init();
 
@@ -4116,11 +4422,15 @@ bool retro_load_game(const struct retro_game_info *info)
 
    frame_count = 0;
    internal_frame_count = 0;
+#ifdef PSX_PROFILE
+   profile_frame_count = 0;
+   PSX_Profile_Reset();
+#endif
 
    // MDFNI_LoadGame() has been called and surface has been allocated,
    // we can now perform firmware check
    bool force_software_renderer = false;
-   if (!firmware_found)
+   if (!firmware_found && retro_cd_path[0])
    {
       log_cb(RETRO_LOG_ERROR, "Content cannot be loaded\n");
 
@@ -4137,6 +4447,26 @@ bool retro_load_game(const struct retro_game_info *info)
 
    bool ret = rsx_intf_open(content_is_pal, force_software_renderer);
 
+   /* Only the software renderer can output RGB565, and the firmware error
+    * screen is drawn in XRGB8888. */
+   if (ret && software_rgb565 && firmware_found && rsx_intf_is_type() == RSX_SOFTWARE)
+   {
+      fmt = RETRO_PIXEL_FORMAT_RGB565;
+
+      if (environ_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &fmt))
+      {
+         surface_rgb565 = true;
+         alloc_surface();
+      }
+      else
+         log_cb(RETRO_LOG_WARN, "Frontend doesn't support RGB565, using XRGB8888.\n");
+   }
+
+#ifdef GPU_REPLAY
+   if (ret)
+      gpu_replay_from_env();
+#endif
+
    /* Hide irrelevant core options */
    switch (rsx_intf_is_type())
    {
@@ -4242,6 +4572,21 @@ void retro_unload_game(void)
    if(!MDFNGameInfo)
       return;
 
+#ifdef GPU_REPLAY
+   GPU_Capture_Stop();
+#endif
+
+#ifdef PSX_PROFILE
+   {
+      const char *path = MDFN_MakeFName(MDFNMKF_SAV, 0, "profile.json");
+
+      if (PSX_Profile_Dump(path))
+         log_cb(RETRO_LOG_INFO, "Wrote subsystem profile to %s\n", path);
+      else
+         log_cb(RETRO_LOG_ERROR, "Could not write subsystem profile to %s\n", path);
+   }
+#endif
+
    rsx_intf_close();
 
    MDFN_FlushGameCheats(0);
@@ -4455,6 +4800,21 @@ void retro_run(void)
       internal_frame_count = 0;
    }
 
+#ifdef PSX_PROFILE
+   if (display_profile && ++profile_frame_count >= INTERNAL_FPS_SAMPLE_PERIOD)
+   {
+      char msg_buffer[256];
+
+      PSX_Profile_Summary(msg_buffer, sizeof(msg_buffer));
+
+      MDFND_DispMessage(1, RETRO_LOG_INFO,
+            RETRO_MESSAGE_TARGET_OSD, RETRO_MESSAGE_TYPE_STATUS,
+            msg_buffer);
+
+      profile_frame_count = 0;
+   }
+#endif
+
    if (setting_apply_analog_toggle)
    {
       PSX_FIO->SetAMCT(setting_psx_analog_toggle);
@@ -4470,7 +4830,7 @@ void retro_run(void)
 
    EmulateSpecStruct spec = {0};
    spec.surface = surf;
-   spec.SoundRate = 44100;
+   spec.SoundRate = SOUND_FREQUENCY;
    spec.SoundBuf = NULL;
    spec.LineWidths = rects;
    spec.SoundBufMaxSize = 0;
@@ -4485,6 +4845,15 @@ void retro_run(void)
    //   spec.skip = true;
    //}
 
+   struct retro_framebuffer direct_fb = {0};
+   bool direct = direct_framebuffer_get(&direct_fb);
+
+   if (direct)
+   {
+      spec.surface = direct_surf;
+      GPU_set_scanout_window(direct_geometry.x, direct_geometry.width);
+   }
+
    EmulateSpecStruct *espec = (EmulateSpecStruct*)&spec;
    /* start of Emulate */
    int32_t timestamp = 0;
@@ -4500,12 +4869,42 @@ void retro_run(void)
    PSX_FIO->UpdateInput();
    GPU_StartFrame(espec);
 
-   Running = -1;
-   timestamp = PSX_CPU->Run(timestamp, false, false);
+#ifdef GPU_REPLAY
+   /* A live replay stands in for the whole system until the stream ends,
+    * then the system starts over. */
+   if (GPU_Replay_Live())
+   {
+      gpu_replay_playing = true;
+      timestamp          = GPU_Replay_Frame();
+   }
+
+   if (gpu_replay_playing && !timestamp)
+   {
+      gpu_replay_playing = false;
+      PSX_Power();
+   }
+
+   if (!timestamp)
+#endif
+   {
+      Running = -1;
+      timestamp = PSX_CPU->Run(timestamp, false, false);
+   }
 
    assert(timestamp);
 
    ForceEventUpdates(timestamp);
+
+   /* Let the threaded rasterizer (if any) drain before settings
+    * or save states can touch the GPU between frames. */
+   GPU_Sync();
+
+#ifdef GPU_REPLAY
+   GPU_Capture_Frame(timestamp);
+#endif
+#ifdef PSX_PROFILE
+   PSX_Profile_FrameDone();
+#endif
 #if 0
    if(GPU_GetScanlineNum() < 100)
       PSX_DBG(PSX_DBG_ERROR, "[BUUUUUUUG] Frame timing end glitch; scanline=%u, st=%u\n", GPU_GetScanlineNum(), timestamp);
@@ -4573,6 +4972,14 @@ void retro_run(void)
 
    /* end of Emulate */
 
+   if (direct)
+      GPU_reset_scanout_window();
+
+   /* Scanout skips lines the surface still holds from the previous frame,
+    * which isn't the case in the frontend's buffer or under crosshairs. */
+   if (direct || input_has_lightgun())
+      GPU_invalidate_scanout();
+
    // Check if aspect ratio needs to be changed due to display mode change on this frame
    if (MDFN_UNLIKELY((aspect_ratio_setting == 1) && aspect_ratio_dirty))
    {
@@ -4604,11 +5011,14 @@ void retro_run(void)
    unsigned width        = rects[0];
    unsigned height       = spec.DisplayRect.h;
    uint8_t upscale_shift = GPU_get_upscale_shift();
+   size_t pitch          = MEDNAFEN_CORE_GEOMETRY_MAX_W << (2 + upscale_shift);
+   bool interlaced       = spec.InterlaceOn;
+   bool display_dirty    = GPU_get_display_possibly_dirty() || (GPU_get_display_change_count() != 0);
 
    if (rsx_intf_is_type() == RSX_SOFTWARE)
    {
 #ifdef NEED_DEINTERLACER
-      if (spec.InterlaceOn)
+      if (spec.InterlaceOn && !direct)
       {
          if (!PrevInterlaced)
             deint.ClearState();
@@ -4630,7 +5040,7 @@ void retro_run(void)
       //fprintf(stderr, "(%u x %u)\n", width, height);
 
       // PSX core inserts padding on left and right (overscan). Optionally crop this.
-      const uint32_t *pix = surf->pixels;
+      const uint8_t *pix  = (const uint8_t*)surf->pixels;
       unsigned pix_offset = 0;
 
       if (crop_overscan)
@@ -4679,14 +5089,62 @@ void retro_run(void)
 
       width  <<= upscale_shift;
       height <<= upscale_shift;
-      pix     += pix_offset << upscale_shift;
+      pix     += (pix_offset << upscale_shift) * (surf->format.bpp / 8);
+      pitch    = surf->pitchinpix * (surf->format.bpp / 8);
+
+      /* Scanout tracks whether any line came out differently, which
+       * VRAM writes outside the displayed area don't cause. Crosshairs
+       * are drawn over the picture every frame. */
+      bool same_geometry = direct_geometry.valid
+         && width == direct_geometry.width
+         && height == direct_geometry.height
+         && (pix_offset << upscale_shift) == direct_geometry.x;
+
+      display_dirty = GPU_get_display_dirty() || !same_geometry;
+
+      bool present = display_dirty || !allow_frame_duping || input_has_lightgun();
+
+      GPU_set_display_dirty(false);
+
+      if (direct)
+      {
+         /* The frame went into the frontend's buffer laid out like the
+          * previous one. If it came out differently (resolution change,
+          * interlacing), dupe the previous frame rather than show it, or
+          * show it anyway for a frame if the frontend can't dupe. */
+         bool predicted = !interlaced && same_geometry;
+
+         if (present && (predicted || !frontend_can_dupe))
+            fb = direct_fb.data;
+
+         direct_geometry.width  = width;
+         direct_geometry.height = height;
+
+         width  = direct_fb.width;
+         height = direct_fb.height;
+         pitch  = direct_fb.pitch;
+      }
+      else
+      {
+         if (present)
+            fb = pix;
+
+         direct_geometry.width  = width;
+         direct_geometry.height = height;
+      }
 
-      if (GPU_get_display_possibly_dirty() || (GPU_get_display_change_count() != 0) || !allow_frame_duping)
-         fb = pix;
+      direct_geometry.x     = pix_offset << upscale_shift;
+      direct_geometry.valid = !interlaced;
    }
 
    int16_t *interbuf = (int16_t*)&IntermediateBuffer;
 
+   if (audio_output_rate != SOUND_FREQUENCY)
+   {
+      spec.SoundBufSize = resampler.Process(IntermediateBuffer, spec.SoundBufSize, resample_buf);
+      interbuf = (int16_t*)&resample_buf;
+   }
+
    if (gui_show)
    {
       if (!gui_inited)
@@ -4708,8 +5166,7 @@ void retro_run(void)
    }
    else
    {
-      rsx_intf_finalize_frame(fb, width, height,
-            MEDNAFEN_CORE_GEOMETRY_MAX_W << (2 + upscale_shift));
+      rsx_intf_finalize_frame(fb, width, height, pitch);
    }
 
    video_frames++;
@@ -4717,12 +5174,11 @@ void retro_run(void)
 
    audio_batch_cb(interbuf, spec.SoundBufSize);
 
-   if (GPU_get_display_possibly_dirty() || (GPU_get_display_change_count() != 0))
-   {
+   if (display_dirty)
       internal_frame_count++;
-      GPU_set_display_change_count(0);
-      GPU_set_display_possibly_dirty(false);
-   }
+
+   GPU_set_display_change_count(0);
+   GPU_set_display_possibly_dirty(false);
 }
 
 void retro_get_system_info(struct retro_system_info *info)
@@ -4748,11 +5204,13 @@ void retro_deinit(void)
 {
    delete surf;
    surf = NULL;
+   delete direct_surf;
+   direct_surf = NULL;
 
    log_cb(RETRO_LOG_DEBUG, "[%s]: Samples / Frame: %.5f\n",
          MEDNAFEN_CORE_NAME, (double)audio_frames / video_frames);
    log_cb(RETRO_LOG_DEBUG, "[%s]: Estimated FPS: %.5f\n",
-         MEDNAFEN_CORE_NAME, (double)video_frames * 44100 / audio_frames);
+         MEDNAFEN_CORE_NAME, (double)video_frames * audio_output_rate / audio_frames);
 
    libretro_supports_bitmasks = false;
 }
@@ -4787,6 +5245,14 @@ void retro_set_environment(retro_environment_t cb)
 	input_set_env( cb );
 
    rsx_intf_set_environment(cb);
+
+#ifdef GPU_REPLAY
+   {
+      /* GPU command streams can be replayed without content. */
+      bool no_content = true;
+      environ_cb(RETRO_ENVIRONMENT_SET_SUPPORT_NO_GAME, &no_content);
+   }
+#endif
 }
 
 void retro_set_audio_sample(retro_audio_sample_t cb)
@@ -4817,90 +5283,96 @@ void retro_set_video_refresh(retro_video_refresh_t cb)
    rsx_intf_set_video_refresh(cb);
 }
 
-static size_t serialize_size;
+/* Size of the last state saved or measured, for regular and fast states.
+ * Only valid while StateLayoutSerial stays the same. */
+static size_t serialize_size[2];
+static uint32_t serialize_serial[2];
 
-size_t retro_serialize_size(void)
+bool UsingFastSavestates(void)
 {
-   if (enable_variable_serialization_size)
+   int flags;
+   if (environ_cb(RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE, &flags))
+      return flags & 4;
+   return false;
+}
+
+static size_t state_size(bool fast)
+{
+   if (!serialize_size[fast] || serialize_serial[fast] != StateLayoutSerial)
    {
       StateMem st;
+      int ret;
 
+      /* Measure only, nothing is copied with no buffer to write to. */
       st.data           = NULL;
       st.loc            = 0;
       st.len            = 0;
       st.malloced       = 0;
       st.initial_malloc = 0;
+      st.fixed          = 1;
+
+      FastSaveStates = fast;
+      ret = MDFNSS_SaveSM(&st, 0, 0, NULL, NULL, NULL);
+      FastSaveStates = false;
 
-      if (!MDFNSS_SaveSM(&st, 0, 0, NULL, NULL, NULL))
+      if (!ret)
          return 0;
 
-      free(st.data);
-      return serialize_size = st.len;
+      serialize_size[fast]   = st.len;
+      serialize_serial[fast] = StateLayoutSerial;
    }
 
-   return serialize_size = DEFAULT_STATE_SIZE; // 16MB
+   return serialize_size[fast];
 }
 
-bool UsingFastSavestates(void)
+size_t retro_serialize_size(void)
 {
-   int flags;
-   if (environ_cb(RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE, &flags))
-      return flags & 4;
-   return false;
+   if (enable_variable_serialization_size)
+      return state_size(UsingFastSavestates());
+
+   return DEFAULT_STATE_SIZE; // 16MB
 }
 
 bool retro_serialize(void *data, size_t size)
 {
    StateMem st;
-   bool ret          = false;
+   bool fast = UsingFastSavestates();
+   int ret;
 
-   st.len            = 0;
+   /* Sections are written in place into the frontend's buffer, whatever
+    * doesn't fit is only counted so the state size is known either way. */
+   st.data           = (uint8_t*)data;
    st.loc            = 0;
+   st.len            = 0;
    st.malloced       = size;
    st.initial_malloc = 0;
+   st.fixed          = 1;
 
-   if (size == DEFAULT_STATE_SIZE)  //16MB buffer reserved
-   {
-      //actual size is around 3.75MB (3.67MB for fast savestates) rather than 16MB, so 16MB will hold a savestate without worrying about realloc
+   //fast save states are at least 20% faster
+   FastSaveStates = fast;
+   ret = MDFNSS_SaveSM(&st, 0, 0, NULL, NULL, NULL);
+   FastSaveStates = false;
 
-      //save state in place
-      st.data     = (uint8_t*)data;
+   if (!ret)
+      return false;
 
-      //fast save states are at least 20% faster
-      FastSaveStates = UsingFastSavestates();
-      ret = MDFNSS_SaveSM(&st, 0, 0, NULL, NULL, NULL);
-   }
-   else
+   serialize_size[fast]   = st.len;
+   serialize_serial[fast] = StateLayoutSerial;
+
+   if (st.len > size)
    {
-      /* it seems that mednafen can realloc pointers sent to it?
-         since we don't know the disposition of void* data (is it safe to realloc?) we have to manage a new buffer here */
       static bool logged;
-      uint8_t *_dat = (uint8_t*)malloc(size);
-
-      if (!_dat)
-         return false;
-
-      st.data = _dat;
 
-      /* there are still some errors with the save states,
-       * the size seems to change on some games for now
-       * just log when this happens */
-      if (!logged && st.len != size)
+      if (!logged)
       {
          log_cb(RETRO_LOG_WARN, "warning, save state size has changed\n");
          logged = true;
       }
 
-      FastSaveStates = UsingFastSavestates();
-      ret = MDFNSS_SaveSM(&st, 0, 0, NULL, NULL, NULL);
-
-      memcpy(data, st.data, size);
-      free(st.data);
+      return false;
    }
 
-   FastSaveStates = false;
-
-   return ret;
+   return true;
 }
 
 bool retro_unserialize(const void *data, size_t size)
@@ -4912,6 +5384,7 @@ bool retro_unserialize(const void *data, size_t size)
    st.len            = size;
    st.malloced       = 0;
    st.initial_malloc = 0;
+   st.fixed          = 0;
 
    //fast save states are at least 20% faster
    FastSaveStates = UsingFastSavestates();
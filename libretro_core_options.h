@@ -81,6 +81,48 @@ struct retro_core_option_definition option_defs_us[] = {
       "enabled"
    },
 #endif
+#ifdef HAVE_THREADS
+   {
+      BEETLE_OPT(renderer_software_threads),
+      "Software Renderer Threads",
+      "Rasterize on separate threads when using the software renderer, while emulation continues on the main thread. With more than one thread, each one draws its own share of the screen's lines. Output and timing are identical to drawing on the main thread. Improves performance on multi-core CPUs, especially at increased internal GPU resolutions. Has no effect with the hardware renderers or when PGXP is enabled.",
+      {
+         { "disabled", NULL },
+         { "1",  "1 Thread" },
+         { "2",  "2 Threads" },
+         { "3",  "3 Threads" },
+         { "4",  "4 Threads" },
+         { "6",  "6 Threads" },
+         { "8",  "8 Threads" },
+         { "12", "12 Threads" },
+         { "16", "16 Threads" },
+         { NULL, NULL },
+      },
+      "disabled"
+   },
+#endif
+   {
+      BEETLE_OPT(renderer_software_format),
+      "Software Renderer Pixel Format (Restart)",
+      "Pixel format of the frames output by the software renderer. RGB565 halves the memory written for each frame and read back by the frontend, which helps on systems limited by memory bandwidth, especially at increased internal GPU resolutions. 24-bit display modes, used by some FMVs and still images, lose some color precision. Has no effect with the hardware renderers.",
+      {
+         { "xrgb8888", "XRGB8888" },
+         { "rgb565",   "RGB565" },
+         { NULL, NULL },
+      },
+      "xrgb8888"
+   },
+   {
+      BEETLE_OPT(renderer_software_direct),
+      "Software Renderer Direct Output",
+      "Write frames output by the software renderer straight into video memory provided by the libretro frontend, in the pixel format it prefers, instead of a buffer the frontend then has to copy. Only used if supported by the frontend. Frames that change resolution or are interlaced fall back to the regular path. Not used while a light gun is connected.",
+      {
+         { "disabled", NULL },
+         { "enabled",  NULL },
+         { NULL, NULL },
+      },
+      "disabled"
+   },
    {
       BEETLE_OPT(internal_resolution),
       "Internal GPU Resolution",
@@ -295,6 +337,19 @@ struct retro_core_option_definition option_defs_us[] = {
       },
       "disabled"
    },
+#ifdef PSX_PROFILE
+   {
+      BEETLE_OPT(display_profile),
+      "Display Subsystem Profile",
+      "Periodically display the share of host time spent in each emulated subsystem and GP0 command class. Note: Requires onscreen notifications to be enabled in the libretro frontend.",
+      {
+         { "disabled", NULL },
+         { "enabled",  NULL },
+         { NULL, NULL },
+      },
+      "disabled"
+   },
+#endif
    {
       BEETLE_OPT(line_render),
       "Line-to-Quad Hack",
@@ -307,6 +362,19 @@ struct retro_core_option_definition option_defs_us[] = {
       },
       "default"
    },
+   {
+      BEETLE_OPT(audio_sample_rate),
+      "Audio Output Rate",
+      "Sample rate of the audio passed to the frontend. The console's sound chip runs at 44100 Hz; other rates are converted inside the core with a high quality resampler, which avoids a second resampling pass when the audio device runs at that rate. Changing this may cause a frontend audio driver reinit.",
+      {
+         { "32000", "32000 Hz" },
+         { "44100", "44100 Hz (Native)" },
+         { "48000", "48000 Hz" },
+         { "96000", "96000 Hz" },
+         { NULL, NULL },
+      },
+      "44100"
+   },
    {
       BEETLE_OPT(frame_duping),
       "Frame Duping (Speedup)",
@@ -899,15 +967,52 @@ struct retro_core_option_definition option_defs_us[] = {
    {
       BEETLE_OPT(cd_access_method),
       "CD Access Method (Restart)",
-      "Select method used to read data from content disk images. 'Synchronous' mimics original hardware. 'Asynchronous' can reduce stuttering on devices with slow storage. 'Pre-Cache' loads the entire disk image into memory when launching content which may improve in-game loading times at the cost of an initial delay at startup. 'Pre-Cache' may cause issues on systems with low RAM.",
+      "Select method used to read data from content disk images. 'Synchronous' mimics original hardware. 'Asynchronous' can reduce stuttering on devices with slow storage. 'Pre-Cache' loads the entire disk image into memory when launching content which may improve in-game loading times at the cost of an initial delay at startup. 'Pre-Cache' may cause issues on systems with low RAM. 'Pre-Cache (Decoded)' decompresses CHD and PBP images once into files in the 'beetle_psx_cache' folder of the system directory and maps them into memory, so later launches start quickly and several instances share the memory. These files are as large as the uncompressed disc and can be deleted at any time; other images are loaded like 'Pre-Cache'.",
       {
          { "sync",     "Synchronous" },
          { "async",    "Asynchronous" },
          { "precache", "Pre-Cache" },
+         { "precache_decoded", "Pre-Cache (Decoded)" },
          { NULL, NULL },
       },
       "sync"
    },
+#endif
+#ifdef HAVE_CHD
+   {
+      BEETLE_OPT(cd_chd_cache),
+      "CHD Hunk Cache (Restart)",
+      "Size of the cache holding decompressed CHD hunks. Upcoming hunks are decompressed ahead of time on worker threads, and games seeking between interleaved streams don't have to decompress the same hunks repeatedly. Larger caches can reduce stuttering during FMVs and loading on slow devices at the cost of memory.",
+      {
+         { "disabled", NULL },
+         { "1",        "1 MB" },
+         { "4",        "4 MB" },
+         { "8",        "8 MB" },
+         { "16",       "16 MB" },
+         { "32",       "32 MB" },
+         { "64",       "64 MB" },
+         { NULL, NULL },
+      },
+      "4"
+   },
+#endif
+#ifdef HAVE_PBP
+   {
+      BEETLE_OPT(cd_pbp_cache),
+      "PBP Block Cache (Restart)",
+      "Size of the cache holding decompressed PBP blocks of 16 sectors. While a disc is read sequentially, the next blocks are decompressed ahead of time on worker threads, and seeking back to recently read blocks doesn't decompress them again. Larger caches can reduce stuttering during FMVs and loading on slow devices at the cost of memory.",
+      {
+         { "disabled", NULL },
+         { "1",        "1 MB" },
+         { "4",        "4 MB" },
+         { "8",        "8 MB" },
+         { "16",       "16 MB" },
+         { "32",       "32 MB" },
+         { "64",       "64 MB" },
+         { NULL, NULL },
+      },
+      "4"
+   },
 #endif
    {
       BEETLE_OPT(cd_fastload),
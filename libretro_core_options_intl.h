@@ -455,6 +455,7 @@ struct retro_core_option_definition option_defs_it[] = {
          { "sync",     "Sincrono" },
          { "async",    "Asincrono" },
          { "precache", "Pre-Cache" },
+         { "precache_decoded", "Pre-Cache (Decoded)" },
          { NULL, NULL },
       },
       "sync"
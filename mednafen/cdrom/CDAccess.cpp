@@ -34,6 +34,10 @@
 #ifdef HAVE_CHD
 #include "CDAccess_CHD.h"
 #endif
+#include "CDAccess_Decoded.h"
+
+// Where compressed images are decoded to when pre-caching, empty to load them as they are.
+extern char cd_decoded_cache_dir[];
 
 CDAccess::CDAccess()
 {
@@ -47,6 +51,26 @@ CDAccess::~CDAccess()
 
 CDAccess *cdaccess_open_image(bool *success, const char *path, bool image_memcache)
 {
+#ifdef HAVE_CD_DECODED_CACHE
+   if(image_memcache && cd_decoded_cache_dir[0] && strlen(path) >= 4)
+   {
+      const char *ext = path + strlen(path) - 4;
+      CDAccess *cda = NULL;
+
+#ifdef HAVE_PBP
+      if(!strcasecmp(ext, ".pbp"))
+         cda = new CDAccess_PBP(path, false);
+#endif
+#ifdef HAVE_CHD
+      if(!strcasecmp(ext, ".chd"))
+         cda = new CDAccess_CHD(path, false);
+#endif
+
+      if(cda)
+         return new CDAccess_Decoded(cda, path, cd_decoded_cache_dir);
+   }
+#endif
+
    if(strlen(path) >= 4 && !strcasecmp(path + strlen(path) - 4, ".ccd"))
       return new CDAccess_CCD(success, path, image_memcache);
 #ifdef HAVE_PBP
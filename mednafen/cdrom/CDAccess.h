@@ -24,6 +24,13 @@ class CDAccess
 
  virtual void Eject(bool eject_status) = 0;		// Eject a disc if it's physical, otherwise NOP.  Returns true on success(or NOP), false on error
 
+ // True if sectors are decompressed in blocks, making reads bursty.
+ virtual bool Is_Compressed(void) { return false; }
+
+ // Digest of the image's block index, for images that have one, so a
+ // decoded copy of the disc can tell a rebuilt image from the old one.
+ virtual bool Get_Index_Hash(uint8_t digest[16]) { return false; }
+
  private:
  CDAccess(const CDAccess&);	// No copy constructor.
  CDAccess& operator=(const CDAccess&); // No assignment operator.
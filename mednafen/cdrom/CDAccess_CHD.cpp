@@ -22,8 +22,18 @@
 
 #include "CDAccess_CHD.h"
 
+#include <algorithm>
+
 extern retro_log_printf_t log_cb;
 
+/* Size of the decompressed hunk cache in MiB, 0 keeps a single hunk. */
+extern unsigned cd_chd_cache_size;
+
+/* Worker threads decompressing upcoming hunks, and how far ahead of the
+ * hunk being read they go. */
+#define CHD_WORKERS        2
+#define CHD_PREFETCH_HUNKS 4
+
 
 // Disk-image(rip) track/sector formats
 enum
@@ -65,10 +75,17 @@ bool CDAccess_CHD::ImageOpen(const char *path, bool image_memcache)
 
    /* allocate storage for sector reads */
    const chd_header *head = chd_get_header(chd);
-   hunkmem = (uint8_t*)malloc(head->hunkbytes);
-   oldhunk = -1;
-   
-   log_cb(RETRO_LOG_INFO, "chd_load '%s' hunkbytes=%d\n", path, head->hunkbytes);
+   hunkbytes  = head->hunkbytes;
+   totalhunks = head->totalhunks;
+   InitHunkCache();
+
+   log_cb(RETRO_LOG_INFO, "chd_load '%s' hunkbytes=%d cached hunks=%u\n",
+         path, head->hunkbytes, (unsigned)hunks.size());
+
+#if HAVE_THREADS
+   if (prefetch_depth)
+      StartWorkers(path);
+#endif
 
    int plba = -150;
    uint32_t fileOffset = 0;
@@ -202,6 +219,10 @@ bool CDAccess_CHD::ImageOpen(const char *path, bool image_memcache)
 
 void CDAccess_CHD::Cleanup(void)
 {
+#if HAVE_THREADS
+   StopWorkers();
+#endif
+
    if(chd != NULL)
       chd_close(chd);
 
@@ -209,9 +230,329 @@ void CDAccess_CHD::Cleanup(void)
       free(hunkmem);
 }
 
+void CDAccess_CHD::InitHunkCache(void)
+{
+   unsigned count = ((uint64)cd_chd_cache_size << 20) / hunkbytes;
+   unsigned i;
+
+   if (count < 1)
+      count = 1;
+   if (count > totalhunks)
+      count = totalhunks;
+
+   hunkmem = (uint8_t*)malloc((size_t)count * hunkbytes);
+   hunks.resize(count);
+
+   for (i = 0; i < count; i++)
+   {
+      hunks[i].hunknum  = -1;
+      hunks[i].last_use = 0;
+      hunks[i].state    = HUNK_EMPTY;
+      hunks[i].data     = hunkmem + (size_t)i * hunkbytes;
+   }
+
+   /* Leave enough hunks that aren't pending for the one being read and
+    * for the most recently read ones. */
+   prefetch_depth = std::min<unsigned>(CHD_PREFETCH_HUNKS, (count - 1) / 2);
+#if !HAVE_THREADS
+   prefetch_depth = 0;
+#endif
+}
+
+#if HAVE_THREADS
+void CDAccess_CHD::WorkerMain(void *arg)
+{
+   CHD_Worker *w        = (CHD_Worker*)arg;
+   CDAccess_CHD *owner = w->owner;
+
+   slock_lock(owner->hunk_lock);
+
+   while (!owner->workers_quit)
+   {
+      unsigned slot;
+      CHD_Hunk *hunk;
+      chd_error err;
+
+      if (owner->prefetch_queue.empty())
+      {
+         scond_wait(owner->work_cond, owner->hunk_lock);
+         continue;
+      }
+
+      slot = owner->prefetch_queue.front();
+      hunk = &owner->hunks[slot];
+      owner->prefetch_queue.pop_front();
+
+      /* Only the reading thread evicts hunks, and never pending ones. */
+      slock_unlock(owner->hunk_lock);
+      err = chd_read(w->chd, hunk->hunknum, hunk->data);
+      slock_lock(owner->hunk_lock);
+
+      if (err == CHDERR_NONE)
+         hunk->state = HUNK_READY;
+      else
+      {
+         owner->hunk_map.erase(hunk->hunknum);
+         hunk->hunknum = -1;
+         hunk->state   = HUNK_EMPTY;
+      }
+
+      owner->pending--;
+      scond_broadcast(owner->done_cond);
+   }
+
+   slock_unlock(owner->hunk_lock);
+}
+
+void CDAccess_CHD::StartWorkers(const char *path)
+{
+   unsigned i;
+
+   hunk_lock = slock_new();
+   work_cond = scond_new();
+   done_cond = scond_new();
+
+   /* Without them, hunks are decoded on the reading thread. */
+   if (!hunk_lock || !work_cond || !done_cond)
+   {
+      if (done_cond)
+         scond_free(done_cond);
+      if (work_cond)
+         scond_free(work_cond);
+      if (hunk_lock)
+         slock_free(hunk_lock);
+
+      hunk_lock      = NULL;
+      work_cond      = NULL;
+      done_cond      = NULL;
+      prefetch_depth = 0;
+      return;
+   }
+
+   /* Workers hold pointers into the vector, so it must not reallocate. */
+   workers.reserve(CHD_WORKERS);
+
+   for (i = 0; i < CHD_WORKERS; i++)
+   {
+      CHD_Worker w;
+
+      w.owner  = this;
+      w.thread = NULL;
+
+      if (chd_open(path, CHD_OPEN_READ, NULL, &w.chd) != CHDERR_NONE)
+         break;
+
+      workers.push_back(w);
+      workers.back().thread = sthread_create(WorkerMain, &workers.back());
+
+      /* Hunks queued for a worker that never started would never complete. */
+      if (!workers.back().thread)
+      {
+         chd_close(workers.back().chd);
+         workers.pop_back();
+         break;
+      }
+   }
+
+   if (workers.empty())
+      prefetch_depth = 0;
+}
+
+void CDAccess_CHD::StopWorkers(void)
+{
+   unsigned i;
+
+   if (!hunk_lock)
+      return;
+
+   slock_lock(hunk_lock);
+   workers_quit = true;
+   scond_broadcast(work_cond);
+   slock_unlock(hunk_lock);
+
+   for (i = 0; i < workers.size(); i++)
+   {
+      if (workers[i].thread)
+         sthread_join(workers[i].thread);
+      chd_close(workers[i].chd);
+   }
+   workers.clear();
+
+   slock_free(hunk_lock);
+   scond_free(work_cond);
+   scond_free(done_cond);
+   hunk_lock = NULL;
+}
+#endif
+
+/* Returns the least recently used hunk that isn't pending, unmapped. */
+unsigned CDAccess_CHD::EvictHunk(void)
+{
+   unsigned best      = 0;
+   uint32_t best_age  = 0;
+   bool found         = false;
+   unsigned i;
+
+   for (i = 0; i < hunks.size(); i++)
+   {
+      uint32_t age;
+
+      if (hunks[i].state == HUNK_PENDING)
+         continue;
+
+      if (hunks[i].state == HUNK_EMPTY)
+         return i;
+
+      age = hunk_clock - hunks[i].last_use;
+
+      if (!found || age > best_age)
+      {
+         best     = i;
+         best_age = age;
+         found    = true;
+      }
+   }
+
+   hunk_map.erase(hunks[best].hunknum);
+   hunks[best].hunknum = -1;
+   hunks[best].state   = HUNK_EMPTY;
+
+   return best;
+}
+
+void CDAccess_CHD::Prefetch(int32_t hunknum)
+{
+#if HAVE_THREADS
+   int32_t next;
+   bool queued = false;
+
+   for (next = hunknum + 1; next <= hunknum + (int32_t)prefetch_depth; next++)
+   {
+      unsigned slot;
+
+      if (next >= (int32_t)totalhunks || pending >= prefetch_depth)
+         break;
+
+      if (hunk_map.count(next))
+         continue;
+
+      slot = EvictHunk();
+
+      hunks[slot].hunknum  = next;
+      hunks[slot].last_use = hunk_clock;
+      hunks[slot].state    = HUNK_PENDING;
+      hunk_map[next]       = slot;
+
+      prefetch_queue.push_back(slot);
+      pending++;
+      queued = true;
+   }
+
+   if (queued)
+      scond_broadcast(work_cond);
+#endif
+}
+
+const uint8_t *CDAccess_CHD::ReadHunk(int32_t hunknum)
+{
+   std::map<int32_t, unsigned>::iterator it;
+   unsigned slot;
+   chd_error err;
+   /* Only read ahead while streaming, prefetches after every seek would
+    * mostly decompress hunks that are never read. */
+   bool sequential = (hunknum == last_hunknum + 1);
+
+   last_hunknum = hunknum;
+
+#if HAVE_THREADS
+   if (prefetch_depth)
+      slock_lock(hunk_lock);
+#endif
+
+   hunk_clock++;
+
+   it = hunk_map.find(hunknum);
+
+#if HAVE_THREADS
+   /* A worker is already on it. */
+   while (it != hunk_map.end() && hunks[it->second].state == HUNK_PENDING)
+   {
+      scond_wait(done_cond, hunk_lock);
+      it = hunk_map.find(hunknum);
+   }
+#endif
+
+   if (it != hunk_map.end())
+   {
+      slot                 = it->second;
+      hunks[slot].last_use = hunk_clock;
+      if (sequential)
+         Prefetch(hunknum);
+
+#if HAVE_THREADS
+      if (prefetch_depth)
+         slock_unlock(hunk_lock);
+#endif
+      return hunks[slot].data;
+   }
+
+   slot                 = EvictHunk();
+   hunks[slot].hunknum  = hunknum;
+   hunks[slot].last_use = hunk_clock;
+   hunks[slot].state    = HUNK_PENDING;
+   hunk_map[hunknum]    = slot;
+   if (sequential)
+      Prefetch(hunknum);
+
+#if HAVE_THREADS
+   if (prefetch_depth)
+      slock_unlock(hunk_lock);
+#endif
+
+   err = chd_read(chd, hunknum, hunks[slot].data);
+
+#if HAVE_THREADS
+   if (prefetch_depth)
+      slock_lock(hunk_lock);
+#endif
+
+   if (err == CHDERR_NONE)
+      hunks[slot].state = HUNK_READY;
+   else
+   {
+      hunk_map.erase(hunknum);
+      hunks[slot].hunknum = -1;
+      hunks[slot].state   = HUNK_EMPTY;
+   }
+
+#if HAVE_THREADS
+   if (prefetch_depth)
+      slock_unlock(hunk_lock);
+#endif
+
+   if (err != CHDERR_NONE)
+   {
+      log_cb(RETRO_LOG_ERROR, "chd_read failed hunk=%d error=%d\n", hunknum, err);
+      return NULL;
+   }
+
+   return hunks[slot].data;
+}
+
 CDAccess_CHD::CDAccess_CHD(const char *path, bool image_memcache)
 {
-   chd = NULL;
+   chd            = NULL;
+   hunkmem        = NULL;
+   hunk_clock     = 0;
+   last_hunknum   = -1;
+   prefetch_depth = 0;
+#if HAVE_THREADS
+   pending        = 0;
+   workers_quit   = false;
+   hunk_lock      = NULL;
+   work_cond      = NULL;
+   done_cond      = NULL;
+#endif
 
    NumTracks = 0;
    total_sectors = 0;
@@ -423,20 +764,17 @@ bool CDAccess_CHD::Read_Raw_Sector(uint8 *buf, int32 lba)
       int sph = head->hunkbytes / (2352 + 96);
       int hunknum = cad / sph; //(cad * head->unitbytes) / head->hunkbytes;
       int hunkofs = cad % sph; //(cad * head->unitbytes) % head->hunkbytes;
-      int err = CHDERR_NONE;
+      /* each hunk holds ~8 sectors, decompressed hunks are cached */
+      const uint8_t *hunk = ReadHunk(hunknum);
 
-      /* each hunk holds ~8 sectors, optimize when reading contiguous sectors */
-      if (hunknum != oldhunk)
+      if (hunk)
+         memcpy(buf, hunk + hunkofs * (2352 + 96), 2352);
+      else
       {
-         err = chd_read(chd, hunknum, hunkmem);
-         if (err != CHDERR_NONE)
-            log_cb(RETRO_LOG_ERROR, "chd_read_sector failed lba=%d error=%d\n", lba, err);
-         else
-            oldhunk = hunknum;
+         log_cb(RETRO_LOG_ERROR, "chd_read_sector failed lba=%d\n", lba);
+         memset(buf, 0, 2352);
       }
 
-      memcpy(buf, hunkmem + hunkofs * (2352 + 96), 2352);
-
       if (ct->DIFormat == DI_FORMAT_AUDIO && ct->RawAudioMSBFirst)
          Endian_A16_Swap(buf, 588 * 2);
    }
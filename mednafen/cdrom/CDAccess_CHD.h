@@ -6,6 +6,14 @@
 
 #include "chd.h"
 
+#include <vector>
+#include <deque>
+#include <map>
+
+#if HAVE_THREADS
+#include <rthreads/rthreads.h>
+#endif
+
 class CDAccess_CHD : public CDAccess
 {
    public:
@@ -21,12 +29,63 @@ class CDAccess_CHD : public CDAccess
 
       virtual void Eject(bool eject_status);
 
+      virtual bool Is_Compressed(void) { return true; }
+
    private:
+      enum
+      {
+         HUNK_EMPTY = 0,
+         HUNK_PENDING,
+         HUNK_READY
+      };
+
+      struct CHD_Hunk
+      {
+         int32_t hunknum;
+         uint32_t last_use;
+         uint8_t state;
+         uint8_t *data;
+      };
+
       chd_file *chd;
-      /* hunk data cache */
+      uint32_t hunkbytes;
+      uint32_t totalhunks;
+
+      /* LRU cache of decompressed hunks, all stored in hunkmem */
       uint8_t *hunkmem;
-      /* last hunknum read */
-      int oldhunk;
+      std::vector<CHD_Hunk> hunks;
+      std::map<int32_t, unsigned> hunk_map;
+      uint32_t hunk_clock;
+      int32_t last_hunknum;
+      /* hunks decompressed ahead of the one being read */
+      unsigned prefetch_depth;
+
+#if HAVE_THREADS
+      struct CHD_Worker
+      {
+         CDAccess_CHD *owner;
+         /* chd_read() isn't reentrant, every worker has its own handle */
+         chd_file *chd;
+         sthread_t *thread;
+      };
+
+      std::vector<CHD_Worker> workers;
+      std::deque<unsigned> prefetch_queue;
+      unsigned pending;
+      bool workers_quit;
+      slock_t *hunk_lock;
+      scond_t *work_cond;
+      scond_t *done_cond;
+
+      static void WorkerMain(void *arg);
+      void StartWorkers(const char *path);
+      void StopWorkers(void);
+#endif
+
+      void InitHunkCache(void);
+      unsigned EvictHunk(void);
+      const uint8_t *ReadHunk(int32_t hunknum);
+      void Prefetch(int32_t hunknum);
 
       int32_t NumTracks;
       int32_t FirstTrack;
@@ -0,0 +1,455 @@
+/* Mednafen - Multi-system Emulator
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include <libretro.h>
+#include <streams/file_stream.h>
+#include <file/file_path.h>
+
+#include <mednafen/mednafen.h>
+#include <mednafen/general.h>
+#include <mednafen/mednafen-endian.h>
+#include <mednafen/md5.h>
+
+#include "CDAccess_Decoded.h"
+
+#ifdef HAVE_CD_DECODED_CACHE
+#ifdef _WIN32
+#include <windows.h>
+#include <encodings/utf.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#endif
+
+extern retro_log_printf_t log_cb;
+
+/* File layout: a 32 byte header, then every sector from LBA 0 on. */
+#define DECODED_MAGIC       "PSXDECD1"
+#define DECODED_HEADER_SIZE 32
+#define DECODED_SECTOR_SIZE 2352
+/* Bytes of the image file at each end that go into the key. */
+#define DECODED_KEY_SPAN    65536
+
+CDAccess_Decoded::CDAccess_Decoded(CDAccess *cda, const char *path, const char *dir) :
+   inner(cda), image_path(path), cache_dir(dir),
+   map_data(NULL), map_base(NULL), map_size(0), map_sectors(0)
+{
+}
+
+CDAccess_Decoded::~CDAccess_Decoded()
+{
+   Unmap();
+   delete inner;
+}
+
+bool CDAccess_Decoded::Read_Raw_Sector(uint8_t *buf, int32_t lba)
+{
+   if (lba < 0 || lba >= map_sectors)
+      return inner->Read_Raw_Sector(buf, lba);
+
+   memcpy(buf, map_data + (size_t)lba * DECODED_SECTOR_SIZE, DECODED_SECTOR_SIZE);
+   return inner->Read_Raw_PW(buf + 2352, lba);
+}
+
+bool CDAccess_Decoded::Read_Raw_PW(uint8_t *buf, int32_t lba)
+{
+   return inner->Read_Raw_PW(buf, lba);
+}
+
+void CDAccess_Decoded::Eject(bool eject_status)
+{
+   inner->Eject(eject_status);
+}
+
+/* Last write time of the image, in whatever units the platform keeps it.
+ * Returns 0 where it can't be read. */
+static uint64_t GetImageMTime(const char *path)
+{
+#ifdef HAVE_CD_DECODED_CACHE
+#ifdef _WIN32
+   WIN32_FILE_ATTRIBUTE_DATA attr;
+   wchar_t *wpath = utf8_to_utf16_string_alloc(path);
+   BOOL ok;
+
+   if (!wpath)
+      return 0;
+
+   ok = GetFileAttributesExW(wpath, GetFileExInfoStandard, &attr);
+   free(wpath);
+
+   if (!ok)
+      return 0;
+
+   return ((uint64_t)attr.ftLastWriteTime.dwHighDateTime << 32)
+      | attr.ftLastWriteTime.dwLowDateTime;
+#else
+   struct stat st;
+
+   if (stat(path, &st) != 0)
+      return 0;
+
+#if defined(__APPLE__)
+   return (uint64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#elif defined(st_mtime)
+   return (uint64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#else
+   return (uint64_t)st.st_mtime * 1000000000;
+#endif
+#endif
+#else
+   return 0;
+#endif
+}
+
+/* Identifies the disc without reading all of it: the image size, its last
+ * write time and both ends of the file, the block index of images that
+ * have one, the TOC, and the primary volume descriptor sector, which tells
+ * apart the discs of a multi-disc PBP. The write time catches an image
+ * patched in place, where the hashed parts may not change. */
+bool CDAccess_Decoded::MakeKey(const TOC *toc, int32_t sectors, uint8_t key[16])
+{
+   md5_context md5;
+   uint8_t *span = (uint8_t*)malloc(DECODED_KEY_SPAN);
+   uint8_t sector[2352 + 96];
+   uint8_t index_hash[16];
+   RFILE *fp;
+   uint64_t mtime;
+   int64_t size;
+   int64_t len;
+   unsigned track;
+
+   if (!span)
+      return false;
+
+   fp = filestream_open(image_path.c_str(),
+         RETRO_VFS_FILE_ACCESS_READ,
+         RETRO_VFS_FILE_ACCESS_HINT_NONE);
+   if (!fp)
+   {
+      free(span);
+      return false;
+   }
+
+   mednafen_md5_starts(&md5);
+
+   size = filestream_get_size(fp);
+   mednafen_md5_update_u32_as_lsb(&md5, (uint32_t)size);
+   mednafen_md5_update_u32_as_lsb(&md5, (uint32_t)(size >> 32));
+
+   mtime = GetImageMTime(image_path.c_str());
+   mednafen_md5_update_u32_as_lsb(&md5, (uint32_t)mtime);
+   mednafen_md5_update_u32_as_lsb(&md5, (uint32_t)(mtime >> 32));
+
+   len = filestream_read(fp, span, DECODED_KEY_SPAN);
+   if (len > 0)
+      mednafen_md5_update(&md5, span, (uint32_t)len);
+
+   if (size > DECODED_KEY_SPAN)
+   {
+      filestream_seek(fp, size - DECODED_KEY_SPAN, RETRO_VFS_SEEK_POSITION_START);
+      len = filestream_read(fp, span, DECODED_KEY_SPAN);
+      if (len > 0)
+         mednafen_md5_update(&md5, span, (uint32_t)len);
+   }
+
+   filestream_close(fp);
+   free(span);
+
+   if (inner->Get_Index_Hash(index_hash))
+      mednafen_md5_update(&md5, index_hash, 16);
+
+   mednafen_md5_update_u32_as_lsb(&md5, toc->first_track);
+   mednafen_md5_update_u32_as_lsb(&md5, toc->last_track);
+   mednafen_md5_update_u32_as_lsb(&md5, toc->tracks[100].lba);
+
+   for (track = toc->first_track; track <= toc->last_track; track++)
+   {
+      mednafen_md5_update_u32_as_lsb(&md5, toc->tracks[track].lba);
+      mednafen_md5_update_u32_as_lsb(&md5, toc->tracks[track].control & 0x4);
+   }
+
+   if (sectors > 16)
+   {
+      if (!inner->Read_Raw_Sector(sector, 16))
+         return false;
+      mednafen_md5_update(&md5, sector, 2352);
+   }
+
+   mednafen_md5_finish(&md5, key);
+   return true;
+}
+
+void CDAccess_Decoded::Unmap(void)
+{
+#ifdef HAVE_CD_DECODED_CACHE
+   if (map_base)
+   {
+#ifdef _WIN32
+      UnmapViewOfFile(map_base);
+#else
+      munmap(map_base, map_size);
+#endif
+   }
+#endif
+
+   map_data    = NULL;
+   map_base    = NULL;
+   map_size    = 0;
+   map_sectors = 0;
+}
+
+/* Maps a finished cache file, checking that it's the one for this disc
+ * and holds at most max_sectors. */
+bool CDAccess_Decoded::MapFile(const char *path, int32_t max_sectors, const uint8_t key[16])
+{
+#ifdef HAVE_CD_DECODED_CACHE
+   uint64_t max_size = DECODED_HEADER_SIZE + (uint64_t)max_sectors * DECODED_SECTOR_SIZE;
+   uint64_t size;
+   uint32_t sectors;
+   uint8_t *base;
+
+#ifdef _WIN32
+   {
+      wchar_t *wpath = utf8_to_utf16_string_alloc(path);
+      HANDLE file, mapping;
+      LARGE_INTEGER file_size;
+
+      if (!wpath)
+         return false;
+
+      file = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+      free(wpath);
+
+      if (file == INVALID_HANDLE_VALUE)
+         return false;
+
+      if (!GetFileSizeEx(file, &file_size)
+            || (uint64_t)file_size.QuadPart <= DECODED_HEADER_SIZE
+            || (uint64_t)file_size.QuadPart > max_size
+            || (size_t)file_size.QuadPart != (uint64_t)file_size.QuadPart)
+      {
+         CloseHandle(file);
+         return false;
+      }
+
+      size = file_size.QuadPart;
+
+      mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+      CloseHandle(file);
+
+      if (!mapping)
+         return false;
+
+      /* The view keeps the mapping alive. */
+      base = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);
+
+      if (!base)
+         return false;
+   }
+#else
+   {
+      struct stat st;
+      void *p;
+      int fd = open(path, O_RDONLY);
+
+      if (fd < 0)
+         return false;
+
+      if (fstat(fd, &st) != 0
+            || (uint64_t)st.st_size <= DECODED_HEADER_SIZE
+            || (uint64_t)st.st_size > max_size
+            || (size_t)st.st_size != (uint64_t)st.st_size)
+      {
+         close(fd);
+         return false;
+      }
+
+      size = st.st_size;
+
+      p = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+      close(fd);
+
+      if (p == MAP_FAILED)
+         return false;
+
+      base = (uint8_t*)p;
+   }
+#endif
+
+   map_base = base;
+   map_size = size;
+   sectors  = MDFN_de32lsb<false>(base + 8);
+
+   if (memcmp(base, DECODED_MAGIC, 8) != 0
+         || size != DECODED_HEADER_SIZE + (uint64_t)sectors * DECODED_SECTOR_SIZE
+         || memcmp(base + 16, key, 16) != 0)
+   {
+      Unmap();
+      return false;
+   }
+
+   map_data    = base + DECODED_HEADER_SIZE;
+   map_sectors = sectors;
+
+   return true;
+#else
+   return false;
+#endif
+}
+
+/* Decodes the disc into a temporary file, then renames it into place so
+ * other instances never see a partial one. Decoding stops at the first
+ * sector the image can't provide, those after it are read directly. */
+bool CDAccess_Decoded::DecodeToFile(const char *path, int32_t sectors, const uint8_t key[16])
+{
+   enum { CHUNK_SECTORS = 64 };
+   char tmp_path[4096];
+   uint8_t header[DECODED_HEADER_SIZE];
+   uint8_t sector[2352 + 96];
+   uint8_t *chunk;
+   RFILE *fp;
+   int32_t lba;
+   unsigned n   = 0;
+   bool ok      = true;
+
+   /* Instances decoding the same disc at once each write their own file. */
+   snprintf(tmp_path, sizeof(tmp_path), "%s.%lx%lx.tmp", path,
+         (unsigned long)time(NULL), (unsigned long)(uintptr_t)this);
+
+   chunk = (uint8_t*)malloc(CHUNK_SECTORS * DECODED_SECTOR_SIZE);
+   if (!chunk)
+      return false;
+
+   fp = filestream_open(tmp_path,
+         RETRO_VFS_FILE_ACCESS_WRITE,
+         RETRO_VFS_FILE_ACCESS_HINT_NONE);
+   if (!fp)
+   {
+      log_cb(RETRO_LOG_ERROR, "Couldn't open %s for writing.\n", tmp_path);
+      free(chunk);
+      return false;
+   }
+
+   /* The header is written last, once the number of sectors is known. */
+   memset(header, 0, sizeof(header));
+   ok = filestream_write(fp, header, sizeof(header)) == sizeof(header);
+
+   for (lba = 0; ok && lba < sectors; lba++)
+   {
+      if (!inner->Read_Raw_Sector(sector, lba))
+         break;
+
+      memcpy(chunk + n * DECODED_SECTOR_SIZE, sector, DECODED_SECTOR_SIZE);
+
+      if (++n == CHUNK_SECTORS)
+      {
+         int64_t len = (int64_t)n * DECODED_SECTOR_SIZE;
+         ok = filestream_write(fp, chunk, len) == len;
+         n  = 0;
+      }
+   }
+
+   if (ok && n)
+   {
+      int64_t len = (int64_t)n * DECODED_SECTOR_SIZE;
+      ok = filestream_write(fp, chunk, len) == len;
+   }
+
+   free(chunk);
+
+   if (ok && lba == 0)
+   {
+      log_cb(RETRO_LOG_ERROR, "Couldn't decode %s.\n", image_path.c_str());
+      ok = false;
+   }
+
+   if (ok)
+   {
+      memcpy(header, DECODED_MAGIC, 8);
+      MDFN_en32lsb<false>(header + 8, lba);
+      memcpy(header + 16, key, 16);
+      ok = filestream_seek(fp, 0, RETRO_VFS_SEEK_POSITION_START) == 0
+         && filestream_write(fp, header, sizeof(header)) == sizeof(header);
+   }
+
+   ok = (filestream_close(fp) == 0) && ok;
+
+   if (ok)
+   {
+      /* Renaming over an existing file fails on some platforms. */
+      if (filestream_rename(tmp_path, path) != 0)
+      {
+         filestream_delete(path);
+         ok = filestream_rename(tmp_path, path) == 0;
+      }
+   }
+
+   if (!ok)
+   {
+      log_cb(RETRO_LOG_ERROR, "Couldn't write %s.\n", tmp_path);
+      filestream_delete(tmp_path);
+      return false;
+   }
+
+   log_cb(RETRO_LOG_INFO, "Decoded %d of %d sectors to %s.\n", lba, sectors, path);
+   return true;
+}
+
+bool CDAccess_Decoded::Read_TOC(TOC *toc)
+{
+   std::string file_base;
+   char path[4096];
+   uint8_t key[16];
+   int32_t sectors;
+
+   /* A multi-disc PBP comes back here after switching discs. */
+   Unmap();
+
+   if (!inner->Read_TOC(toc))
+      return false;
+
+   sectors = toc->tracks[100].lba;
+
+   if (sectors <= 0 || !MakeKey(toc, sectors, key))
+      return true;
+
+   MDFN_GetFilePathComponents(image_path, NULL, &file_base);
+   fill_pathname_join(path, cache_dir.c_str(),
+         (file_base + "." + mednafen_md5_asciistr(key) + ".decoded").c_str(), sizeof(path));
+
+   if (MapFile(path, sectors, key))
+   {
+      log_cb(RETRO_LOG_INFO, "Using decoded disc cache %s.\n", path);
+      return true;
+   }
+
+   /* Creates missing parents too; an existing directory is fine. */
+   path_mkdir(cache_dir.c_str());
+
+   if (!DecodeToFile(path, sectors, key) || !MapFile(path, sectors, key))
+      log_cb(RETRO_LOG_WARN, "Couldn't map a decoded copy of %s, reading it directly.\n", image_path.c_str());
+
+   return true;
+}
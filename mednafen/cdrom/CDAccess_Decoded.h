@@ -0,0 +1,53 @@
+#ifndef __MDFN_CDACCESS_DECODED_H
+#define __MDFN_CDACCESS_DECODED_H
+
+#include <string>
+
+#include "CDAccess.h"
+
+#if defined(_WIN32) && !defined(_XBOX)
+#define HAVE_CD_DECODED_CACHE 1
+#elif !defined(__CELLOS_LV2__) && !defined(PSP) && !defined(PS2) && !defined(GEKKO) && !defined(VITA) && !defined(_XBOX) && !defined(_3DS) && !defined(WIIU) && !defined(SWITCH) && !defined(HAVE_LIBNX) && !defined(EMSCRIPTEN)
+#define HAVE_CD_DECODED_CACHE 1
+#endif
+
+/* Wraps a compressed image and serves its sectors from a memory-mapped
+ * file holding the whole disc decoded. The file is kept in cache_dir and
+ * keyed by a hash of the image, so later runs and other instances on the
+ * same host map it directly and share its pages. Sectors the file doesn't
+ * cover and the subchannel data still come from the wrapped image. */
+class CDAccess_Decoded : public CDAccess
+{
+   public:
+
+      CDAccess_Decoded(CDAccess *cda, const char *path, const char *cache_dir);
+      virtual ~CDAccess_Decoded();
+
+      virtual bool Read_Raw_Sector(uint8_t *buf, int32_t lba);
+
+      virtual bool Read_Raw_PW(uint8_t *buf, int32_t lba);
+
+      virtual bool Read_TOC(TOC *toc);
+
+      virtual void Eject(bool eject_status);
+
+      virtual bool Is_Compressed(void) { return map_data ? false : inner->Is_Compressed(); }
+
+   private:
+      CDAccess *inner;
+      std::string image_path;
+      std::string cache_dir;
+
+      /* Sectors 0 .. map_sectors - 1, 2352 bytes each. */
+      const uint8_t *map_data;
+      uint8_t *map_base;
+      uint64_t map_size;
+      int32_t map_sectors;
+
+      bool MakeKey(const TOC *toc, int32_t sectors, uint8_t key[16]);
+      bool MapFile(const char *path, int32_t max_sectors, const uint8_t key[16]);
+      bool DecodeToFile(const char *path, int32_t sectors, const uint8_t key[16]);
+      void Unmap(void);
+};
+
+#endif
@@ -29,6 +29,7 @@
 #include "../general.h"
 #include "../FileStream.h"
 #include "../MemoryStream.h"
+#include "../md5.h"
 
 #include "CDAccess.h"
 #include "CDAccess_PBP.h"
@@ -40,6 +41,8 @@
 
 #include "zlib.h"
 
+#include <algorithm>
+
 extern "C" {
    #include "deps/libkirk/kirk_engine.h"
    #include "deps/libkirk/amctrl.h"
@@ -48,6 +51,15 @@ extern "C" {
 
 extern retro_log_printf_t log_cb;
 
+/* Size of the decompressed block cache in MiB, 0 keeps a single block. */
+extern unsigned cd_pbp_cache_size;
+
+/* Every block holds 16 raw sectors. Worker threads decompress the blocks
+ * following the one being read while a disc is streamed. */
+#define PBP_BLOCK_SIZE      (2352 * 16)
+#define PBP_WORKERS         2
+#define PBP_PREFETCH_BLOCKS 4
+
 // very hacky but currently the only way to update the disc start offset class variable from libretro.cpp
 extern int CD_SelectedDisc;
 int PBP_DiscCount;
@@ -101,6 +113,24 @@ typedef struct {
    unsigned char *buf;
 } PGD_HEADER;
 
+static void InitDecoderStream(struct z_stream_s **z)
+{
+   /* zalloc == NULL tells decompress2() the stream isn't initialized yet */
+   *z = (struct z_stream_s*)calloc(1, sizeof(z_stream));
+}
+
+static void FreeDecoderStream(struct z_stream_s **z)
+{
+   if (*z == NULL)
+      return;
+
+   if ((*z)->zalloc != NULL)
+      inflateEnd(*z);
+
+   free(*z);
+   *z = NULL;
+}
+
 bool CDAccess_PBP::ImageOpen(const char *path, bool image_memcache)
 {
    uint8 magic[4];
@@ -210,6 +240,10 @@ bool CDAccess_PBP::ImageOpen(const char *path, bool image_memcache)
 
 void CDAccess_PBP::Cleanup(void)
 {
+#if HAVE_THREADS
+   StopWorkers();
+#endif
+
    if(fp != NULL)
    {
       fp->close();   // need to manually close for FileStreams?
@@ -217,17 +251,41 @@ void CDAccess_PBP::Cleanup(void)
    }
    if(index_table != NULL)
       free(index_table);
+   if(blockmem != NULL)
+      free(blockmem);
+   FreeDecoderStream(&decoder.z);
 }
 
 CDAccess_PBP::CDAccess_PBP(const char *path, bool image_memcache) : NumTracks(0), FirstTrack(0), LastTrack(0), total_sectors(0)
 {
    is_official = false;
    index_table = NULL;
+   index_len = 0;
+   memset(index_hash, 0, sizeof(index_hash));
    fp = NULL;
+   blockmem = NULL;
+   block_clock = 0;
+   last_blocknum = -1;
+   prefetch_depth = 0;
+#if HAVE_THREADS
+   pending = 0;
+   workers_quit = false;
+   block_lock = NULL;
+   work_cond = NULL;
+   done_cond = NULL;
+#endif
    kirk_init();
+   InitDecoderStream(&decoder.z);
+   InitBlockCache();
    if (!ImageOpen(path, image_memcache))
    {
+      return;
    }
+
+#if HAVE_THREADS
+   if (prefetch_depth)
+      StartWorkers();
+#endif
 }
 
 CDAccess_PBP::~CDAccess_PBP()
@@ -348,116 +406,474 @@ bool CDAccess_PBP::Read_Raw_PW(uint8_t *buf, int32_t lba)
 }
 
 
-int CDAccess_PBP::decompress2(void *out, uint32_t *out_size, void *in, uint32_t in_size)
+int CDAccess_PBP::decompress2(struct z_stream_s *z, void *out, uint32_t *out_size, void *in, uint32_t in_size)
 {
-   static z_stream z;
    int ret = 0;
 
-   if (z.zalloc == NULL) {
-      z.next_in = Z_NULL;
-      z.avail_in = 0;
-      z.zalloc = Z_NULL;
-      z.zfree = Z_NULL;
-      z.opaque = Z_NULL;
-      ret = inflateInit2(&z, -15);
+   if (z->zalloc == NULL) {
+      z->next_in = Z_NULL;
+      z->avail_in = 0;
+      z->zalloc = Z_NULL;
+      z->zfree = Z_NULL;
+      z->opaque = Z_NULL;
+      ret = inflateInit2(z, -15);
    }
    else
-      ret = inflateReset(&z);
+      ret = inflateReset(z);
 
    if (ret != Z_OK)
       return ret;
 
-   z.next_in = (Bytef*)in;
-   z.avail_in = in_size;
-   z.next_out = (Bytef*)out;
-   z.avail_out = *out_size;
+   z->next_in = (Bytef*)in;
+   z->avail_in = in_size;
+   z->next_out = (Bytef*)out;
+   z->avail_out = *out_size;
 
-   ret = inflate(&z, Z_FINISH);
+   ret = inflate(z, Z_FINISH);
 
-   *out_size -= z.avail_out;
+   *out_size -= z->avail_out;
    return ret == 1 ? 0 : ret;
 }
 
-bool CDAccess_PBP::Read_Raw_Sector(uint8 *buf, int32 lba)
+void CDAccess_PBP::InitBlockCache(void)
 {
-   uint8_t SimuQ[0xC];
+   unsigned count = ((uint64)cd_pbp_cache_size << 20) / PBP_BLOCK_SIZE;
+   unsigned i;
 
-   int32_t block = lba >> 4;
-   sector_in_blk = lba & 0xf;
+   if (count < 1)
+      count = 1;
 
-   memset(buf + 2352, 0, 96);
-   MakeSubPQ(lba, buf + 2352);
-   subq_deinterleave(buf + 2352, SimuQ);
+   blockmem = (uint8_t*)malloc((size_t)count * PBP_BLOCK_SIZE);
+   blocks.resize(count);
 
-   if (block != current_block)
+   for (i = 0; i < count; i++)
    {
-      uint32_t start_byte = index_table[block];
-      uint32_t size = index_table[block+1] - start_byte;
-      bool is_compressed = true;
+      blocks[i].blocknum   = -1;
+      blocks[i].last_use   = 0;
+      blocks[i].state      = BLOCK_EMPTY;
+      blocks[i].fix_failed = 0;
+      blocks[i].data       = blockmem + (size_t)i * PBP_BLOCK_SIZE;
+   }
 
-      if (lba >= index_len * 16)
+   /* Leave enough blocks that aren't pending for the one being read and
+    * for the most recently read ones. */
+   prefetch_depth = std::min<unsigned>(PBP_PREFETCH_BLOCKS, (count - 1) / 2);
+#if !HAVE_THREADS
+   prefetch_depth = 0;
+#endif
+}
+
+/* Drops every cached block. Read_TOC() calls this before switching discs,
+ * so it also waits for the workers to stop touching fp. */
+void CDAccess_PBP::ResetBlockCache(void)
+{
+   unsigned i;
+
+#if HAVE_THREADS
+   if (block_lock)
+   {
+      slock_lock(block_lock);
+
+      /* Blocks nobody has started on yet can just be forgotten. */
+      while (!prefetch_queue.empty())
       {
-         log_cb(RETRO_LOG_ERROR, "[PBP] sector %d is past img end\n", lba);
-         return false;
+         blocks[prefetch_queue.front()].state = BLOCK_EMPTY;
+         prefetch_queue.pop_front();
+         pending--;
+      }
+
+      while (pending)
+         scond_wait(done_cond, block_lock);
+   }
+#endif
+
+   for (i = 0; i < blocks.size(); i++)
+   {
+      blocks[i].blocknum = -1;
+      blocks[i].state    = BLOCK_EMPTY;
+   }
+   block_map.clear();
+   last_blocknum = -1;
+
+#if HAVE_THREADS
+   if (block_lock)
+      slock_unlock(block_lock);
+#endif
+}
+
+#if HAVE_THREADS
+void CDAccess_PBP::WorkerMain(void *arg)
+{
+   PBP_Worker *w       = (PBP_Worker*)arg;
+   CDAccess_PBP *owner = w->owner;
+
+   slock_lock(owner->block_lock);
+
+   while (!owner->workers_quit)
+   {
+      unsigned slot;
+      PBP_Block *blk;
+      bool ok;
+
+      if (owner->prefetch_queue.empty())
+      {
+         scond_wait(owner->work_cond, owner->block_lock);
+         continue;
       }
 
-      if (size > sizeof(buff_compressed))
+      slot = owner->prefetch_queue.front();
+      blk  = &owner->blocks[slot];
+      owner->prefetch_queue.pop_front();
+
+      /* Only the reading thread evicts blocks, and never pending ones. */
+      slock_unlock(owner->block_lock);
+      ok = owner->LoadBlock(&w->decoder, blk);
+      slock_lock(owner->block_lock);
+
+      if (ok)
+         blk->state = BLOCK_READY;
+      else
       {
-         log_cb(RETRO_LOG_ERROR, "[PBP] %u: block %d is too large (%u)\n", lba, block, size);
-         return false;
+         owner->block_map.erase(blk->blocknum);
+         blk->blocknum = -1;
+         blk->state    = BLOCK_EMPTY;
+      }
+
+      owner->pending--;
+      scond_broadcast(owner->done_cond);
+   }
+
+   slock_unlock(owner->block_lock);
+}
+
+void CDAccess_PBP::StartWorkers(void)
+{
+   unsigned i;
+
+   block_lock = slock_new();
+   work_cond  = scond_new();
+   done_cond  = scond_new();
+
+   /* Without them, blocks are decompressed on the reading thread. */
+   if (!block_lock || !work_cond || !done_cond)
+   {
+      if (done_cond)
+         scond_free(done_cond);
+      if (work_cond)
+         scond_free(work_cond);
+      if (block_lock)
+         slock_free(block_lock);
+
+      block_lock     = NULL;
+      work_cond      = NULL;
+      done_cond      = NULL;
+      prefetch_depth = 0;
+      return;
+   }
+
+   /* Workers hold pointers into the vector, so it must not reallocate. */
+   workers.resize(PBP_WORKERS);
+
+   for (i = 0; i < workers.size(); i++)
+   {
+      workers[i].owner = this;
+      InitDecoderStream(&workers[i].decoder.z);
+      workers[i].thread = sthread_create(WorkerMain, &workers[i]);
+
+      if (!workers[i].thread)
+      {
+         FreeDecoderStream(&workers[i].decoder.z);
+         workers.resize(i);
+         break;
+      }
+   }
+
+   if (workers.empty())
+      prefetch_depth = 0;
+}
+
+void CDAccess_PBP::StopWorkers(void)
+{
+   unsigned i;
+
+   if (!block_lock)
+      return;
+
+   slock_lock(block_lock);
+   workers_quit = true;
+   scond_broadcast(work_cond);
+   slock_unlock(block_lock);
+
+   for (i = 0; i < workers.size(); i++)
+   {
+      sthread_join(workers[i].thread);
+      FreeDecoderStream(&workers[i].decoder.z);
+   }
+   workers.clear();
+
+   slock_free(block_lock);
+   scond_free(work_cond);
+   scond_free(done_cond);
+   block_lock = NULL;
+}
+#endif
+
+/* Returns the least recently used block that isn't pending, unmapped. */
+unsigned CDAccess_PBP::EvictBlock(void)
+{
+   unsigned best      = 0;
+   uint32_t best_age  = 0;
+   bool found         = false;
+   unsigned i;
+
+   for (i = 0; i < blocks.size(); i++)
+   {
+      uint32_t age;
+
+      if (blocks[i].state == BLOCK_PENDING)
+         continue;
+
+      if (blocks[i].state == BLOCK_EMPTY)
+         return i;
+
+      age = block_clock - blocks[i].last_use;
+
+      if (!found || age > best_age)
+      {
+         best     = i;
+         best_age = age;
+         found    = true;
       }
-      else if(size == sizeof(buff_compressed))
-         is_compressed = false;  // should be the case here?
+   }
+
+   block_map.erase(blocks[best].blocknum);
+   blocks[best].blocknum = -1;
+   blocks[best].state    = BLOCK_EMPTY;
+
+   return best;
+}
+
+void CDAccess_PBP::Prefetch(int32_t blocknum)
+{
+#if HAVE_THREADS
+   int32_t next;
+   bool queued = false;
+
+   for (next = blocknum + 1; next <= blocknum + (int32_t)prefetch_depth; next++)
+   {
+      unsigned slot;
+
+      if (next >= (int32_t)index_len || pending >= prefetch_depth)
+         break;
+
+      if (block_map.count(next))
+         continue;
+
+      slot = EvictBlock();
+
+      blocks[slot].blocknum = next;
+      blocks[slot].last_use = block_clock;
+      blocks[slot].state    = BLOCK_PENDING;
+      block_map[next]       = slot;
+
+      prefetch_queue.push_back(slot);
+      pending++;
+      queued = true;
+   }
 
-      fp->seek(start_byte, SEEK_SET);
-      fp->read(is_compressed ? buff_compressed : buff_raw[0], size);
+   if (queued)
+      scond_broadcast(work_cond);
+#endif
+}
 
-//log_cb(RETRO_LOG_DEBUG, "lba = %d, block = %u, start_byte = %#x, index_table[%i] = %#x\n", lba, block, start_byte, block, index_table[block]);
+/* Reads, decompresses and fixes all 16 sectors of blk->blocknum into
+ * blk->data. Called without block_lock held, from the reading thread or a
+ * worker. */
+bool CDAccess_PBP::LoadBlock(PBP_Decoder *dec, PBP_Block *blk)
+{
+   int32_t block = blk->blocknum;
+   uint32_t start_byte = index_table[block];
+   uint32_t size = index_table[block+1] - start_byte;
+   bool is_compressed = true;
+   int i;
 
-      if (is_compressed)
+   if (size > sizeof(dec->compressed))
+   {
+      log_cb(RETRO_LOG_ERROR, "[PBP] %u: block %d is too large (%u)\n", block << 4, block, size);
+      return false;
+   }
+   else if(size == sizeof(dec->compressed))
+      is_compressed = false;  // should be the case here?
+
+#if HAVE_THREADS
+   if (block_lock)
+      slock_lock(block_lock);
+#endif
+
+   fp->seek(start_byte, SEEK_SET);
+   fp->read(is_compressed ? dec->compressed : blk->data, size);
+
+#if HAVE_THREADS
+   if (block_lock)
+      slock_unlock(block_lock);
+#endif
+
+//log_cb(RETRO_LOG_DEBUG, "block = %u, start_byte = %#x, index_table[%i] = %#x\n", block, start_byte, block, index_table[block]);
+
+   if (is_compressed)
+   {
+      if(is_official)
+         decompress(blk->data, dec->compressed, PBP_BLOCK_SIZE);
+      else
       {
-         if(is_official)
+         uint32_t cdbuffer_size_expect = PBP_BLOCK_SIZE;
+         uint32_t cdbuffer_size = cdbuffer_size_expect;
+         int ret = decompress2(dec->z, blk->data, &cdbuffer_size, dec->compressed, size);
+         if (ret != 0)
          {
-            decompress(buff_raw[0], buff_compressed, sizeof(buff_compressed));
-            fixed_sectors = 0;
+            log_cb(RETRO_LOG_ERROR, "[PBP] uncompress failed with %d for block %d, sector %d (%u)\n", ret, block, block << 4, size);
+            return false;
          }
-         else
+         if (cdbuffer_size != cdbuffer_size_expect)
          {
-            uint32_t cdbuffer_size_expect = sizeof(buff_raw[0]) << 4;
-            uint32_t cdbuffer_size = cdbuffer_size_expect;
-            int ret = decompress2(buff_raw[0], &cdbuffer_size, buff_compressed, size);
-            if (ret != 0)
-            {
-               log_cb(RETRO_LOG_ERROR, "[PBP] uncompress failed with %d for block %d, sector %d (%u)\n", ret, block, lba, size);
-               return false;
-            }
-            if (cdbuffer_size != cdbuffer_size_expect)
-            {
-               log_cb(RETRO_LOG_WARN, "[PBP] cdbuffer_size: %lu != %lu, sector %d\n", cdbuffer_size, cdbuffer_size_expect, lba);
-               return false;
-            }
+            log_cb(RETRO_LOG_WARN, "[PBP] cdbuffer_size: %lu != %lu, sector %d\n", cdbuffer_size, cdbuffer_size_expect, block << 4);
+            return false;
          }
       }
-      current_block = block;
    }
 
+   blk->fix_failed = 0;
+
    if(is_official)
    {
-      // this will probably rarely get caught but better than trying to do it every time I guess...
-      if(!(fixed_sectors & (0x1 << sector_in_blk)))
+      for (i = 0; i < 16; i++)
       {
-         if(fix_sector(buff_raw[sector_in_blk], lba) != 0)
-            log_cb(RETRO_LOG_WARN, "[PBP] Failed to fix sector %d\n", lba);
-         else
-            fixed_sectors |= (0x1 << sector_in_blk);
+         if(fix_sector(blk->data + i * 2352, (block << 4) + i) != 0)
+            blk->fix_failed |= (0x1 << i);
       }
    }
 
-   memcpy(buf, buff_raw[sector_in_blk], 2352);
+   return true;
+}
+
+const CDAccess_PBP::PBP_Block *CDAccess_PBP::ReadBlock(int32_t blocknum)
+{
+   std::map<int32_t, unsigned>::iterator it;
+   unsigned slot;
+   bool ok;
+   /* Only read ahead while streaming, prefetches after every seek would
+    * mostly decompress blocks that are never read. */
+   bool sequential = (blocknum == last_blocknum + 1);
+
+   last_blocknum = blocknum;
+
+#if HAVE_THREADS
+   if (block_lock)
+      slock_lock(block_lock);
+#endif
+
+   block_clock++;
+
+   it = block_map.find(blocknum);
+
+#if HAVE_THREADS
+   /* A worker is already on it. */
+   while (it != block_map.end() && blocks[it->second].state == BLOCK_PENDING)
+   {
+      scond_wait(done_cond, block_lock);
+      it = block_map.find(blocknum);
+   }
+#endif
+
+   if (it != block_map.end())
+   {
+      slot                  = it->second;
+      blocks[slot].last_use = block_clock;
+      if (sequential)
+         Prefetch(blocknum);
+
+#if HAVE_THREADS
+      if (block_lock)
+         slock_unlock(block_lock);
+#endif
+      return &blocks[slot];
+   }
+
+   slot                  = EvictBlock();
+   blocks[slot].blocknum = blocknum;
+   blocks[slot].last_use = block_clock;
+   blocks[slot].state    = BLOCK_PENDING;
+   block_map[blocknum]   = slot;
+   if (sequential)
+      Prefetch(blocknum);
+
+#if HAVE_THREADS
+   if (block_lock)
+      slock_unlock(block_lock);
+#endif
+
+   ok = LoadBlock(&decoder, &blocks[slot]);
+
+#if HAVE_THREADS
+   if (block_lock)
+      slock_lock(block_lock);
+#endif
+
+   if (ok)
+      blocks[slot].state = BLOCK_READY;
+   else
+   {
+      block_map.erase(blocknum);
+      blocks[slot].blocknum = -1;
+      blocks[slot].state    = BLOCK_EMPTY;
+   }
+
+#if HAVE_THREADS
+   if (block_lock)
+      slock_unlock(block_lock);
+#endif
+
+   return ok ? &blocks[slot] : NULL;
+}
+
+bool CDAccess_PBP::Read_Raw_Sector(uint8 *buf, int32 lba)
+{
+   uint8_t SimuQ[0xC];
+   const PBP_Block *blk;
+
+   int32_t block = lba >> 4;
+   uint32_t sector_in_blk = lba & 0xf;
+
+   memset(buf + 2352, 0, 96);
+   MakeSubPQ(lba, buf + 2352);
+   subq_deinterleave(buf + 2352, SimuQ);
+
+   if (lba < 0 || block >= (int32_t)index_len)
+   {
+      log_cb(RETRO_LOG_ERROR, "[PBP] sector %d is past img end\n", lba);
+      return false;
+   }
+
+   /* Read-only for us until the next ReadBlock(), only this thread evicts. */
+   blk = ReadBlock(block);
+   if (!blk)
+      return false;
+
+   // this will probably rarely get caught
+   if(blk->fix_failed & (0x1 << sector_in_blk))
+      log_cb(RETRO_LOG_WARN, "[PBP] Failed to fix sector %d\n", lba);
+
+   memcpy(buf, blk->data + sector_in_blk * 2352, 2352);
 
    return true;
 }
 
+bool CDAccess_PBP::Get_Index_Hash(uint8_t digest[16])
+{
+   memcpy(digest, index_hash, sizeof(index_hash));
+   return true;
+}
+
 bool CDAccess_PBP::Read_TOC(TOC *toc)
 {
    struct {
@@ -485,7 +901,13 @@ bool CDAccess_PBP::Read_TOC(TOC *toc)
    uint32_t index_table_offset = 0x3C00;
    uint32_t cdimg_base = psisoimg_offset + 0x100000;
 
-   uint8_t* iso_header = (uint8_t*)malloc(0xB6600);
+   uint8_t* iso_header;
+   md5_context index_md5;
+
+   // the workers read from fp, and the cached blocks may be of another disc
+   ResetBlockCache();
+
+   iso_header = (uint8_t*)malloc(0xB6600);
 
    if(!iso_header)
    {
@@ -616,8 +1038,6 @@ bool CDAccess_PBP::Read_TOC(TOC *toc)
    read_offset = index_table_offset;
 
    // set class variables
-   fixed_sectors = 0;
-   current_block = (uint32_t)-1;
    index_len = 0xAFC80 / sizeof(index_entry);   // disc map table has a fixed size of 0xAFC80 (22500 entries)?
 
    if(index_table != NULL)
@@ -630,11 +1050,14 @@ bool CDAccess_PBP::Read_TOC(TOC *toc)
       return false;
    }
 
+   mednafen_md5_starts(&index_md5);
+
    for (i = 0; i < index_len; i++)
    {
       // TOCHECK: does struct reading (with entries that could be affected by endianness) work reliably between different platforms?
       memcpy(&index_entry, iso_header+read_offset, sizeof(index_entry));
       read_offset += sizeof(index_entry);
+      mednafen_md5_update(&index_md5, (uint8_t*)&index_entry, sizeof(index_entry));
 
       // apparently indices with marker == 0 aren't part of the original image (official pbp files only), should they be skipped?
 
@@ -642,8 +1065,12 @@ bool CDAccess_PBP::Read_TOC(TOC *toc)
          break;
 
       index_table[i] = cdimg_base + index_entry.offset;
+      // end of the last block, the terminating entry is all zeroes
+      index_table[i+1] = index_table[i] + index_entry.size;
    }
-   index_table[i] = cdimg_base + index_entry.offset + index_entry.size;
+   // blocks past the table end can't be read
+   index_len = i;
+   mednafen_md5_finish(&index_md5, index_hash);
 
    toc->tracks[100].lba = total_sectors;
    toc->tracks[100].adr = ADR_CURPOS;
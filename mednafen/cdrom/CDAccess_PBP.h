@@ -4,9 +4,16 @@
 #include <boolean.h>
 
 #include <map>
+#include <vector>
+#include <deque>
 #include "CDAccess_Image.h"
 
+#if HAVE_THREADS
+#include <rthreads/rthreads.h>
+#endif
+
 class Stream;
+struct z_stream_s;
 
 class CDAccess_PBP : public CDAccess
 {
@@ -23,6 +30,10 @@ class CDAccess_PBP : public CDAccess
 
       virtual void Eject(bool eject_status);
 
+      virtual bool Is_Compressed(void) { return true; }
+
+      virtual bool Get_Index_Hash(uint8_t digest[16]);
+
    private:
       Stream* fp;
 
@@ -41,14 +52,75 @@ class CDAccess_PBP : public CDAccess
       uint32_t pbp_file_offsets[PBP_NUM_FILES];
 
       ////////////////
-      uint8_t buff_raw[16][2352];
-      uint8_t buff_compressed[2352 * 16];
       uint32_t *index_table;
       uint32_t index_len;
-      uint32_t current_block;
-      uint32_t sector_in_blk;
+      /* md5 of the raw index entries: offset, size and checksum of each block */
+      uint8_t index_hash[16];
       ////////////////
 
+      enum
+      {
+         BLOCK_EMPTY = 0,
+         BLOCK_PENDING,
+         BLOCK_READY
+      };
+
+      struct PBP_Block
+      {
+         int32_t blocknum;
+         uint32_t last_use;
+         uint8_t state;
+         /* sectors fix_sector() couldn't repair */
+         uint16_t fix_failed;
+         uint8_t *data;
+      };
+
+      /* scratch space for decompressing blocks, one per thread */
+      struct PBP_Decoder
+      {
+         uint8_t compressed[2352 * 16];
+         struct z_stream_s *z;
+      };
+
+      /* LRU cache of decompressed and fixed blocks, all stored in blockmem */
+      uint8_t *blockmem;
+      std::vector<PBP_Block> blocks;
+      std::map<int32_t, unsigned> block_map;
+      uint32_t block_clock;
+      int32_t last_blocknum;
+      /* blocks decompressed ahead of the one being read */
+      unsigned prefetch_depth;
+      PBP_Decoder decoder;
+
+#if HAVE_THREADS
+      struct PBP_Worker
+      {
+         CDAccess_PBP *owner;
+         PBP_Decoder decoder;
+         sthread_t *thread;
+      };
+
+      std::vector<PBP_Worker> workers;
+      std::deque<unsigned> prefetch_queue;
+      unsigned pending;
+      bool workers_quit;
+      /* guards the cache and fp, which the workers share */
+      slock_t *block_lock;
+      scond_t *work_cond;
+      scond_t *done_cond;
+
+      static void WorkerMain(void *arg);
+      void StartWorkers(void);
+      void StopWorkers(void);
+#endif
+
+      void InitBlockCache(void);
+      void ResetBlockCache(void);
+      unsigned EvictBlock(void);
+      const PBP_Block *ReadBlock(int32_t blocknum);
+      bool LoadBlock(PBP_Decoder *dec, PBP_Block *blk);
+      void Prefetch(int32_t blocknum);
+
       int32_t NumTracks;
       int32_t FirstTrack;
       int32_t LastTrack;
@@ -59,7 +131,6 @@ class CDAccess_PBP : public CDAccess
       uint32_t discs_start_offset[5];
       uint32_t psisoimg_offset;
 
-      uint16_t fixed_sectors;
       bool is_official;    // TODO: find more consistent ways to check for used compression algorithm, compressed (and/or encrypted?) audio tracks and messed up sectors
 
       bool ImageOpen(const char *path, bool image_memcache);
@@ -74,7 +145,7 @@ class CDAccess_PBP : public CDAccess
       std::map<uint32, cpp11_array_doodad> SubQReplaceMap;
       void MakeSubPQ(int32 lba, uint8 *SubPWBuf);
 
-      int decompress2(void *out, uint32_t *out_size, void *in, uint32_t in_size);
+      int decompress2(struct z_stream_s *z, void *out, uint32_t *out_size, void *in, uint32_t in_size);
 
       int decode_range(unsigned int *range, unsigned int *code, unsigned char **src);
       int decode_bit(unsigned int *range, unsigned int *code, int *index, unsigned char **src, unsigned char *c);
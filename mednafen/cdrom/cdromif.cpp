@@ -43,7 +43,8 @@ enum
    // Command messages.
    CDIF_MSG_DIEDIEDIE,
    CDIF_MSG_READ_SECTOR,
-   CDIF_MSG_EJECT
+   CDIF_MSG_EJECT,
+   CDIF_MSG_READ_MODE
 };
 
 class CDIF_Message
@@ -100,6 +101,7 @@ class CDIF_MT : public CDIF
       virtual void HintReadSector(uint32 lba);
       virtual bool ReadRawSector(uint8 *buf, uint32 lba, int64 timeout_us);
       virtual bool ReadRawSectorPWOnly(uint8 *buf, uint32 lba, bool hint_fullread);
+      virtual void HintReadMode(unsigned mode, unsigned speed);
 
       // Return true if operation succeeded or it was a NOP(either due to not being implemented, or the current status matches eject_status).
       // Returns false on failure(usually drive error of some kind; not completely fatal, can try again).
@@ -120,22 +122,31 @@ class CDIF_MT : public CDIF
       CDIF_Queue EmuThreadQueue;
 
 
+      // Indexed by LBA modulo SBSize, read-ahead never gets far enough
+      // ahead to overwrite a sector that may still be read.
       enum { SBSize = 256 };
       CDIF_Sector_Buffer SectorBuffers[SBSize];
 
-      uint32 SBWritePos;
-
       slock_t *SBMutex;
       scond_t *SBCond;
 
+      // Last read mode hinted, emu-thread-only.
+      unsigned hint_mode;
+      unsigned hint_speed;
+
       //
       // Read-thread-only:
       //
       bool RT_EjectDisc(bool eject_status, bool skip_actual_eject = false);
+      void RT_SetReadMode(unsigned mode, unsigned speed);
 
       uint32 ra_lba;
       int ra_count;
       uint32 last_read_lba;
+
+      int max_ra;
+      int initial_ra;
+      int speedmult_ra;
 };
 
 #endif /* HAVE_THREAD */
@@ -276,7 +287,6 @@ bool CDIF_MT::RT_EjectDisc(bool eject_status, bool skip_actual_eject)
          }
       }
 
-      SBWritePos = 0;
       ra_lba = 0;
       ra_count = 0;
       last_read_lba = ~0U;
@@ -286,6 +296,30 @@ bool CDIF_MT::RT_EjectDisc(bool eject_status, bool skip_actual_eject)
    return true;
 }
 
+void CDIF_MT::RT_SetReadMode(unsigned mode, unsigned speed)
+{
+   // 16 sectors ahead at 1x, enough for the same number of frames at
+   // higher speeds.
+   max_ra       = 8 + 8 * speed;
+   initial_ra   = 1;
+   speedmult_ra = 2;
+
+   // XA and CD-DA streams play at a fixed rate, a stall is audible.
+   if(mode == CDIF_READ_XA || mode == CDIF_READ_CDDA)
+      max_ra *= 2;
+
+   // Sectors come in blocks, the rest of the block after a seek is cheap
+   // and the window has to cover decompressing the next one.
+   if(disc_cdaccess->Is_Compressed())
+   {
+      max_ra      *= 2;
+      initial_ra   = 8;
+      speedmult_ra = 4;
+   }
+
+   max_ra = MIN(max_ra, SBSize / 4 - 1);
+}
+
 struct RTS_Args
 {
    CDIF_MT *cdif_ptr;
@@ -303,10 +337,10 @@ int CDIF_MT::ReadThreadStart()
    bool Running = true;
 
    DiscEjected = true;
-   SBWritePos = 0;
    ra_lba = 0;
    ra_count = 0;
    last_read_lba = ~0U;
+   RT_SetReadMode(CDIF_READ_DATA, 1);
 
    RT_EjectDisc(false, true);
 
@@ -330,15 +364,14 @@ int CDIF_MT::ReadThreadStart()
                EmuThreadQueue.Write(CDIF_Message(CDIF_MSG_DONE));
                break;
 
+            case CDIF_MSG_READ_MODE:
+               RT_SetReadMode(msg.args[0], msg.args[1]);
+               break;
+
             case CDIF_MSG_READ_SECTOR:
                {
-                  static const int       max_ra = 16;
-                  static const int   initial_ra = 1;
-                  static const int speedmult_ra = 2;
                   uint32_t              new_lba = msg.args[0];
 
-                  assert((unsigned int)max_ra < (SBSize / 4));
-
                   if(last_read_lba != ~0U && new_lba == (last_read_lba + 1))
                   {
                      int how_far_ahead = ra_lba - new_lba;
@@ -376,11 +409,12 @@ int CDIF_MT::ReadThreadStart()
 
          slock_lock((slock_t*)SBMutex);
 
-         SectorBuffers[SBWritePos].lba = ra_lba;
-         memcpy(SectorBuffers[SBWritePos].data, tmpbuf, 2352 + 96);
-         SectorBuffers[SBWritePos].valid = true;
-         SectorBuffers[SBWritePos].error = error_condition;
-         SBWritePos = (SBWritePos + 1) % SBSize;
+         CDIF_Sector_Buffer *sb = &SectorBuffers[ra_lba % SBSize];
+
+         sb->lba = ra_lba;
+         memcpy(sb->data, tmpbuf, 2352 + 96);
+         sb->valid = true;
+         sb->error = error_condition;
 
          scond_signal((scond_t*)SBCond);
          slock_unlock((slock_t*)SBMutex);
@@ -393,7 +427,8 @@ int CDIF_MT::ReadThreadStart()
    return(1);
 }
 
-CDIF_MT::CDIF_MT(CDAccess *cda) : disc_cdaccess(cda), CDReadThread(NULL), SBMutex(NULL), SBCond(NULL)
+CDIF_MT::CDIF_MT(CDAccess *cda) : disc_cdaccess(cda), CDReadThread(NULL), SBMutex(NULL), SBCond(NULL),
+   hint_mode(CDIF_READ_DATA), hint_speed(1)
 {
    CDIF_Message msg;
    RTS_Args s;
@@ -456,15 +491,13 @@ bool CDIF_MT::ReadRawSector(uint8 *buf, uint32 lba, int64 timeout_us)
 
    do
    {
-      int i;
-      for(i = 0; i < SBSize; i++)
+      CDIF_Sector_Buffer *sb = &SectorBuffers[lba % SBSize];
+
+      if(sb->valid && sb->lba == lba)
       {
-         if(SectorBuffers[i].valid && SectorBuffers[i].lba == lba)
-         {
-            error_condition = SectorBuffers[i].error;
-            memcpy(buf, SectorBuffers[i].data, 2352 + 96);
-            found = true;
-         }
+         error_condition = sb->error;
+         memcpy(buf, sb->data, 2352 + 96);
+         found = true;
       }
 
       if(!found)
@@ -521,6 +554,17 @@ void CDIF_MT::HintReadSector(uint32 lba)
    ReadThreadQueue.Write(CDIF_Message(CDIF_MSG_READ_SECTOR, lba));
 }
 
+void CDIF_MT::HintReadMode(unsigned mode, unsigned speed)
+{
+   if(UnrecoverableError || (mode == hint_mode && speed == hint_speed))
+      return;
+
+   hint_mode  = mode;
+   hint_speed = speed;
+
+   ReadThreadQueue.Write(CDIF_Message(CDIF_MSG_READ_MODE, mode, speed));
+}
+
 bool CDIF_MT::Eject(bool eject_status)
 {
    CDIF_Message msg;
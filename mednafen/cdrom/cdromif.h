@@ -25,6 +25,14 @@
 
 typedef TOC CD_TOC;
 
+// How the emulated drive is reading, see CDIF::HintReadMode().
+enum
+{
+   CDIF_READ_DATA = 0,
+   CDIF_READ_XA,
+   CDIF_READ_CDDA
+};
+
 class CDIF
 {
    public:
@@ -41,6 +49,10 @@ class CDIF
       virtual bool ReadRawSector(uint8_t *buf, uint32_t lba, int64_t timeout_us = -1) = 0;
       virtual bool ReadRawSectorPWOnly(uint8_t *buf, uint32_t lba, bool hint_fullread) = 0;
 
+      // Lets read-ahead adapt to the drive; mode is one of CDIF_READ_*, speed
+      // a multiple of 1x speed.
+      virtual void HintReadMode(unsigned mode, unsigned speed) { }
+
       // Call for mode 1 or mode 2 form 1 only.
       bool ValidateRawSector(uint8_t *buf);
 
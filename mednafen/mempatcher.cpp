@@ -69,6 +69,50 @@ static bool CheatsActive = true;
 bool SubCheatsOn = 0;
 std::vector<SUBCHEAT> SubCheats[8];
 
+/* Periodic cheats are compiled when the cheat list changes, so applying
+ * them every frame doesn't parse condition strings. Accesses that fall
+ * entirely within a main RAM mirror use an offset into MainRAM instead of
+ * going through PSX_MemPeek8()/PSX_MemPoke8() byte by byte. */
+enum
+{
+ COND_GE = 0,
+ COND_LE,
+ COND_GT,
+ COND_LT,
+ COND_EQ,
+ COND_NE,
+ COND_AND,
+ COND_NAND,
+ COND_XOR,
+ COND_NXOR,
+ COND_OR,
+ COND_NOR,
+ COND_NONE	// Invalid operation, always passes
+};
+
+typedef struct __COMPILED_COND
+{
+ uint32 addr;
+ int32 ram;	// Offset into MainRAM, < 0 if not entirely in main RAM
+ unsigned length;
+ bool bigendian;
+ unsigned op;
+ uint64 value;
+} COMPILED_COND;
+
+typedef struct __COMPILED_CHEAT
+{
+ const CHEATF *cheat;
+ unsigned cond_first;
+ unsigned cond_count;
+ int32 ram;	// Same as above, for all writes of a single write or copy cheat
+ int32 copy_src_ram;	// Source offset of a byte copy cheat, < 0 if not in main RAM
+ uint8 bytes[8];	// Replace value in memory order
+} COMPILED_CHEAT;
+
+static std::vector<COMPILED_COND> CompiledConds;
+static std::vector<COMPILED_CHEAT> CompiledCheats;
+
 MemoryPatch::MemoryPatch() : addr(0), val(0), compare(0), 
 			     mltpl_count(1), mltpl_addr_inc(0), mltpl_val_inc(0), copy_src_addr(0), copy_src_addr_inc(0),
 			     length(0), bigendian(false), status(false), icount(0), type(0)
@@ -81,10 +125,14 @@ MemoryPatch::~MemoryPatch()
 
 }
 
+static void RebuildPeriodicCheats(void);
+
 static void RebuildSubCheats(void)
 {
  std::vector<CHEATF>::iterator chit;
 
+ RebuildPeriodicCheats();
+
  SubCheatsOn = 0;
  for(int x = 0; x < 8; x++)
   SubCheats[x].clear();
@@ -266,116 +314,163 @@ int MDFNI_DelCheat(uint32 which)
 
 */
 
-static bool TestConditions(const char *string)
+static int32 RAMOffset(uint32 addr, uint32 length)
 {
+ if(addr >= 0x00800000 || (addr & 0x1FFFFF) + length > 0x200000)
+  return -1;
+
+ return addr & 0x1FFFFF;
+}
+
+static void CompileConditions(const char *string, COMPILED_CHEAT *cc)
+{
+ static const char *const ops[] = { ">=", "<=", ">", "<", "==", "!=", "&", "!&", "^", "!^", "|", "!|" };
  char address[64];
  char operation[64];
  char value[64];
  char endian;
  unsigned int bytelen;
- bool passed = 1;
 
- //printf("TR: %s\n", string);
- while(sscanf(string, "%u %c %63s %63s %63s", &bytelen, &endian, address, operation, value) == 5 && passed)
+ cc->cond_first = CompiledConds.size();
+ cc->cond_count = 0;
+
+ while(sscanf(string, "%u %c %63s %63s %63s", &bytelen, &endian, address, operation, value) == 5)
  {
-  uint32 v_address;
-  uint64 v_value;
-  uint64 value_at_address;
+  COMPILED_COND cond;
 
   if(address[0] == '0' && address[1] == 'x')
-   v_address = strtoul(address + 2, NULL, 16);
+   cond.addr = strtoul(address + 2, NULL, 16);
   else
-   v_address = strtoul(address, NULL, 10);
+   cond.addr = strtoul(address, NULL, 10);
 
   if(value[0] == '0' && value[1] == 'x')
-   v_value = strtoull(value + 2, NULL, 16);
+   cond.value = strtoull(value + 2, NULL, 16);
   else
-   v_value = strtoull(value, NULL, 0);
+   cond.value = strtoull(value, NULL, 0);
 
-  value_at_address = 0;
-  for(unsigned int x = 0; x < bytelen; x++)
-  {
-   unsigned int shiftie;
+  cond.length = bytelen;
+  cond.bigendian = (endian == 'B');
+  cond.ram = RAMOffset(cond.addr, bytelen);
 
-   if(endian == 'B')
-    shiftie = (bytelen - 1 - x) * 8;
-   else
-    shiftie = x * 8;
-   value_at_address |= PSX_MemPeek8(v_address + x) << shiftie;
-  }
+  for(cond.op = 0; cond.op < COND_NONE; cond.op++)
+   if(!strcmp(operation, ops[cond.op]))
+    break;
+
+  if(cond.op == COND_NONE)
+   log_cb(RETRO_LOG_WARN, "Invalid cheat condition operation: %s\n", operation);
+
+  CompiledConds.push_back(cond);
+  cc->cond_count++;
 
-  //printf("A: %08x, V: %08llx, VA: %08llx, OP: %s\n", v_address, v_value, value_at_address, operation);
-  if(!strcmp(operation, ">="))
-  {
-   if(!(value_at_address >= v_value))
-    passed = 0;
-  }
-  else if(!strcmp(operation, "<="))
-  {
-   if(!(value_at_address <= v_value))
-    passed = 0;
-  }
-  else if(!strcmp(operation, ">"))
-  {
-   if(!(value_at_address > v_value))
-    passed = 0;
-  }
-  else if(!strcmp(operation, "<"))
-  {
-   if(!(value_at_address < v_value))
-    passed = 0;
-  }
-  else if(!strcmp(operation, "==")) 
-  {
-   if(!(value_at_address == v_value))
-    passed = 0;
-  }
-  else if(!strcmp(operation, "!="))
-  {
-   if(!(value_at_address != v_value))
-    passed = 0;
-  }
-  else if(!strcmp(operation, "&"))
-  {
-   if(!(value_at_address & v_value))
-    passed = 0;
-  }
-  else if(!strcmp(operation, "!&"))
-  {
-   if(value_at_address & v_value)
-    passed = 0;
-  }
-  else if(!strcmp(operation, "^"))
-  {
-   if(!(value_at_address ^ v_value))
-    passed = 0;
-  }
-  else if(!strcmp(operation, "!^"))
-  {
-   if(value_at_address ^ v_value)
-    passed = 0;
-  }
-  else if(!strcmp(operation, "|"))
-  {
-   if(!(value_at_address | v_value))
-    passed = 0;
-  }
-  else if(!strcmp(operation, "!|"))
-  {
-   if(value_at_address | v_value)
-    passed = 0;
-  }
-  else
-   puts("Invalid operation");
   string = strchr(string, ',');
   if(string == NULL)
    break;
   else
    string++;
-  //printf("Foo: %s\n", string);
  }
+}
+
+static void RebuildPeriodicCheats(void)
+{
+ std::vector<CHEATF>::iterator chit;
+
+ CompiledConds.clear();
+ CompiledCheats.clear();
+
+ if(!CheatsActive) return;
+
+ for(chit = cheats.begin(); chit != cheats.end(); chit++)
+ {
+  if(chit->status && (chit->type == 'R' || chit->type == 'A' || chit->type == 'T'))
+  {
+   COMPILED_CHEAT cc;
 
- return(passed);
+   memset(&cc, 0, sizeof(cc));
+
+   cc.cheat = &*chit;
+   CompileConditions(chit->conditions.c_str(), &cc);
+
+   cc.ram = -1;
+   cc.copy_src_ram = -1;
+   if(chit->type == 'T' && chit->length == 1 && chit->mltpl_addr_inc == 1 && chit->copy_src_addr_inc == 1)
+   {
+    cc.copy_src_ram = RAMOffset(chit->copy_src_addr, chit->mltpl_count);
+    if(cc.copy_src_ram >= 0)
+     cc.ram = RAMOffset(chit->addr, chit->mltpl_count);
+   }
+   else if(chit->type != 'T' && chit->mltpl_count == 1 && chit->length <= 8)
+   {
+    cc.ram = RAMOffset(chit->addr, chit->length);
+
+    for(unsigned int x = 0; x < chit->length; x++)
+    {
+     const unsigned int o = chit->bigendian ? (chit->length - 1 - x) : x;
+
+     cc.bytes[o] = chit->val >> (x * 8);
+    }
+   }
+
+   CompiledCheats.push_back(cc);
+  }
+ }
+}
+
+static INLINE uint64 CondValue(const COMPILED_COND *cond)
+{
+ uint64 value_at_address = 0;
+
+ for(unsigned int x = 0; x < cond->length; x++)
+ {
+  unsigned int shiftie;
+  uint8 b;
+
+  if(cond->bigendian)
+   shiftie = (cond->length - 1 - x) * 8;
+  else
+   shiftie = x * 8;
+
+  if(cond->ram >= 0)
+   b = MainRAM->data8[cond->ram + x];
+  else
+   b = PSX_MemPeek8(cond->addr + x);
+
+  value_at_address |= (uint64)b << shiftie;
+ }
+
+ return value_at_address;
+}
+
+static bool TestConditions(const COMPILED_CHEAT *cc)
+{
+ const COMPILED_COND *cond = cc->cond_count ? &CompiledConds[cc->cond_first] : NULL;
+
+ for(unsigned int i = 0; i < cc->cond_count; i++, cond++)
+ {
+  const uint64 value_at_address = CondValue(cond);
+  const uint64 v_value = cond->value;
+  bool passed = true;
+
+  switch(cond->op)
+  {
+   case COND_GE: passed = value_at_address >= v_value; break;
+   case COND_LE: passed = value_at_address <= v_value; break;
+   case COND_GT: passed = value_at_address > v_value; break;
+   case COND_LT: passed = value_at_address < v_value; break;
+   case COND_EQ: passed = value_at_address == v_value; break;
+   case COND_NE: passed = value_at_address != v_value; break;
+   case COND_AND: passed = (value_at_address & v_value) != 0; break;
+   case COND_NAND: passed = !(value_at_address & v_value); break;
+   case COND_XOR: passed = (value_at_address ^ v_value) != 0; break;
+   case COND_NXOR: passed = !(value_at_address ^ v_value); break;
+   case COND_OR: passed = (value_at_address | v_value) != 0; break;
+   case COND_NOR: passed = !(value_at_address | v_value); break;
+  }
+
+  if(!passed)
+   return(false);
+ }
+
+ return(true);
 }
 
 void MDFNMP_ApplyPeriodicCheats(void)
@@ -383,50 +478,68 @@ void MDFNMP_ApplyPeriodicCheats(void)
  if(!CheatsActive)
   return;
 
- //TestConditions("2 L 0x1F00F5 == 0xDEAD");
- //if(TestConditions("1 L 0x1F0058 > 0")) //, 1 L 0xC000 == 0x01"));
- for(std::vector<CHEATF>::iterator chit = cheats.begin(); chit != cheats.end(); chit++)
+ for(std::vector<COMPILED_CHEAT>::const_iterator ccit = CompiledCheats.begin(); ccit != CompiledCheats.end(); ccit++)
  {
-  if(chit->status && (chit->type == 'R' || chit->type == 'A' || chit->type == 'T'))
+  const CHEATF *chit = ccit->cheat;
+
+  if(!TestConditions(&*ccit))
+   continue;
+
+  // Plain single write into main RAM, done in one go
+  if(ccit->ram >= 0 && chit->type == 'R')
+  {
+   memcpy(MainRAM->data8 + ccit->ram, ccit->bytes, chit->length);
+   continue;
+  }
+
+  // Byte copy within main RAM, forwards like the generic path even if the
+  // ranges overlap
+  if(ccit->ram >= 0 && chit->type == 'T')
   {
-   if(chit->conditions.size() == 0 || TestConditions(chit->conditions.c_str()))
+   uint8 *dst = MainRAM->data8 + ccit->ram;
+   const uint8 *src = MainRAM->data8 + ccit->copy_src_ram;
+
+   for(uint32 x = 0; x < chit->mltpl_count; x++)
+    dst[x] = src[x];
+   continue;
+  }
+
+  {
+   uint32 mltpl_count = chit->mltpl_count;
+   uint32 mltpl_addr = chit->addr;
+   uint64 mltpl_val = chit->val;
+   uint32 copy_src_addr = chit->copy_src_addr;
+
+   while(mltpl_count--)
    {
-    uint32 mltpl_count = chit->mltpl_count;
-    uint32 mltpl_addr = chit->addr;
-    uint64 mltpl_val = chit->val;
-    uint32 copy_src_addr = chit->copy_src_addr;
+    uint8 carry = 0;
 
-    while(mltpl_count--)
+    for(unsigned int x = 0; x < chit->length; x++)
     {
-     uint8 carry = 0;
+     const uint32 tmpaddr = chit->bigendian ? (mltpl_addr + chit->length - 1 - x) : (mltpl_addr + x);
+     const uint8 tmpval = mltpl_val >> (x * 8);
 
-     for(unsigned int x = 0; x < chit->length; x++)
+     if(chit->type == 'A')
      {
-      const uint32 tmpaddr = chit->bigendian ? (mltpl_addr + chit->length - 1 - x) : (mltpl_addr + x);
-      const uint8 tmpval = mltpl_val >> (x * 8);
-
-      if(chit->type == 'A')
-      {
-       const unsigned t = PSX_MemPeek8(tmpaddr) + tmpval + carry;
+      const unsigned t = PSX_MemPeek8(tmpaddr) + tmpval + carry;
 
-       carry = t >> 8;
+      carry = t >> 8;
 
-       PSX_MemPoke8(tmpaddr, t);
-      }
-      else if(chit->type == 'T')
-      {
-       const uint8 cv = PSX_MemPeek8(chit->bigendian ? (copy_src_addr + chit->length - 1 - x) : (copy_src_addr + x));
+      PSX_MemPoke8(tmpaddr, t);
+     }
+     else if(chit->type == 'T')
+     {
+      const uint8 cv = PSX_MemPeek8(chit->bigendian ? (copy_src_addr + chit->length - 1 - x) : (copy_src_addr + x));
 
-       PSX_MemPoke8(tmpaddr, cv);
-      }
-      else
-       PSX_MemPoke8(tmpaddr, tmpval);
+      PSX_MemPoke8(tmpaddr, cv);
      }
-     mltpl_addr += chit->mltpl_addr_inc;
-     mltpl_val += chit->mltpl_val_inc;
-     copy_src_addr += chit->copy_src_addr_inc;
+     else
+      PSX_MemPoke8(tmpaddr, tmpval);
     }
-   } // end if(chit->conditions.size() == 0 || TestConditions(chit->conditions.c_str()))
+    mltpl_addr += chit->mltpl_addr_inc;
+    mltpl_val += chit->mltpl_val_inc;
+    copy_src_addr += chit->copy_src_addr_inc;
+   }
   }
  }
 }
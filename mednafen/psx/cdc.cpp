@@ -51,10 +51,15 @@
 #include "psx.h"
 #include "cdc.h"
 #include "spu.h"
+#include "profile.h"
 
 #include "../mednafen-endian.h"
 #include "../state_helpers.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 PS_CDC::PS_CDC() : DMABuffer(4096)
 {
    IsPSXDisc = false;
@@ -125,9 +130,21 @@ void PS_CDC::SetDisc(bool tray_open, CDIF *cdif, const char *disc_id)
    }
 }
 
+//
+// How far past its next sample the SPU may be left unrendered, so it can render in blocks.  A pending async IRQ
+// is checked at the end of every update chunk(see CheckAIP()), which must stay a sample apart while it is.
+//
+int32 PS_CDC::CalcSPUSlack(void)
+{
+   if(AsyncIRQPending)
+      return 0;
+
+   return PSX_SPU->GetRenderSlack();
+}
+
 int32 PS_CDC::CalcNextEvent(void)
 {
-   int32 next_event = SPUCounter;
+   int32 next_event = SPUCounter + CalcSPUSlack();
 
    if(PSRCounter > 0 && next_event > PSRCounter)
       next_event = PSRCounter;
@@ -504,7 +521,8 @@ bool PS_CDC::DecodeSubQ(uint8 *subpw)
    return(false);
 }
 
-static const int16 CDADPCMImpulse[7][25] =
+// Rows are zero-padded out to 32 taps for the SIMD path.
+static const int16 CDADPCMImpulse[7][32] =
 {
    {     0,    -5,    17,   -35,    70,   -23,   -68,   347,  -839,  2062, -4681, 15367, 21472, -5882,  2810, -1352,   635,  -235,    26,    43,   -35,    16,    -8,     2,     0,  }, /* 0 */
    {     0,    -2,    10,   -34,    65,   -84,    52,     9,  -266,  1024, -2680,  9036, 26516, -6016,  3021, -1571,   848,  -365,   107,    10,   -16,    17,    -8,     3,    -1,  }, /* 1 */
@@ -542,36 +560,27 @@ INLINE void PS_CDC::ApplyVolume(int32 samples[2])
    samples[1] = right_out;
 }
 
-// This function must always set samples[0] and samples[1], even if just to 0; 
-// range of samples[n] shall be restricted to -32768 through 32767.
-void PS_CDC::GetCDAudio(int32 samples[2], const unsigned freq)
+//
+// Resamples up to count(at most 32) CD-XA ADPCM samples, stopping early if the buffered sector runs out; returns the
+// number produced.  Only stepping the phase and pulling in input is serial, so that's done first, into a linear copy of
+// the filter window, and the filter then runs over the whole block.
+//
+unsigned PS_CDC::ResampleCDAudio(int32 (*samples)[2], const unsigned count)
 {
-   if(freq == 7 || freq == 14)
-   {
-      ReadAudioBuffer(samples);
-      if(freq == 14)
-         ReadAudioBuffer(samples);
-   }
-   else
-   {
-      int32 out_tmp[2];
-
-      out_tmp[0] = out_tmp[1] = 0;
+   const unsigned freq = AudioBuffer.Freq;
+   int16 wf[2][64];
+   uint8 phase[32];
+   uint8 offset[32];
+   unsigned n = 0;
+   unsigned k;
 
-      for(unsigned i = 0; i < 2; i++)
-      {
-         const int16* imp = CDADPCMImpulse[ADPCM_ResampCurPhase];
-         int16* wf = &ADPCM_ResampBuf[i][(ADPCM_ResampCurPos + 32 - 25) & 0x1F];
-
-         for(unsigned s = 0; s < 25; s++)
-         {
-            out_tmp[i] += imp[s] * wf[s];
-         }
+   for(unsigned i = 0; i < 2; i++)
+      memcpy(wf[i], &ADPCM_ResampBuf[i][(ADPCM_ResampCurPos + 32 - 25) & 0x1F], 25 * sizeof(int16));
 
-         out_tmp[i] >>= 15;
-         clamp(&out_tmp[i], -32768, 32767);
-         samples[i] = out_tmp[i];
-      }
+   for(k = 0; k < count && AudioBuffer.ReadPos < AudioBuffer.Size; k++)
+   {
+      phase[k] = ADPCM_ResampCurPhase;
+      offset[k] = n;
 
       ADPCM_ResampCurPhase += freq;
 
@@ -588,14 +597,98 @@ void PS_CDC::GetCDAudio(int32 samples[2], const unsigned freq)
          {
             ADPCM_ResampBuf[i][ADPCM_ResampCurPos +  0] = 
                ADPCM_ResampBuf[i][ADPCM_ResampCurPos + 32] = raw[i];
+            wf[i][25 + n] = raw[i];
          }
          ADPCM_ResampCurPos = (ADPCM_ResampCurPos + 1) & 0x1F;
+         n++;
       }
    }
 
-   // Algorithmically, volume is applied after resampling for CD-XA ADPCM playback, 
-   // per PS1 tests(though when "mute" is applied wasn't tested).
-   ApplyVolume(samples);
+   // The SIMD path reads(and multiplies by 0) up to 7 samples past the window.
+   for(unsigned i = 0; i < 2; i++)
+      memset(&wf[i][25 + n], 0, (64 - 25 - n) * sizeof(int16));
+
+   for(unsigned j = 0; j < k; j++)
+   {
+      const int16* imp = CDADPCMImpulse[phase[j]];
+#if defined(__SSE2__)
+      __m128i acc[2];
+
+      for(unsigned i = 0; i < 2; i++)
+      {
+         const int16* w = &wf[i][offset[j]];
+
+         acc[i] = _mm_madd_epi16(_mm_loadu_si128((const __m128i*)&w[0]), _mm_loadu_si128((const __m128i*)&imp[0]));
+         acc[i] = _mm_add_epi32(acc[i], _mm_madd_epi16(_mm_loadu_si128((const __m128i*)&w[8]), _mm_loadu_si128((const __m128i*)&imp[8])));
+         acc[i] = _mm_add_epi32(acc[i], _mm_madd_epi16(_mm_loadu_si128((const __m128i*)&w[16]), _mm_loadu_si128((const __m128i*)&imp[16])));
+         acc[i] = _mm_add_epi32(acc[i], _mm_madd_epi16(_mm_loadu_si128((const __m128i*)&w[24]), _mm_loadu_si128((const __m128i*)&imp[24])));
+      }
+
+      // l0+l2, r0+r2, l1+l3, r1+r3
+      __m128i sum = _mm_add_epi32(_mm_unpacklo_epi32(acc[0], acc[1]), _mm_unpackhi_epi32(acc[0], acc[1]));
+      sum = _mm_srai_epi32(_mm_add_epi32(sum, _mm_srli_si128(sum, 8)), 15);
+
+      samples[j][0] = _mm_cvtsi128_si32(sum);
+      samples[j][1] = _mm_cvtsi128_si32(_mm_srli_si128(sum, 4));
+
+      for(unsigned i = 0; i < 2; i++)
+         clamp(&samples[j][i], -32768, 32767);
+#else
+      for(unsigned i = 0; i < 2; i++)
+      {
+         const int16* w = &wf[i][offset[j]];
+         int32 out_tmp = 0;
+
+         for(unsigned s = 0; s < 25; s++)
+         {
+            out_tmp += imp[s] * w[s];
+         }
+
+         out_tmp >>= 15;
+         clamp(&out_tmp, -32768, 32767);
+         samples[j][i] = out_tmp;
+      }
+#endif
+
+      // Algorithmically, volume is applied after resampling for CD-XA ADPCM playback, 
+      // per PS1 tests(though when "mute" is applied wasn't tested).
+      ApplyVolume(samples[j]);
+   }
+
+   return k;
+}
+
+//
+// Fills samples[0] through samples[count - 1], restricted to -32768 through 32767; samples past the end of the buffered
+// sector are 0.  The rate can't change within a call, since only the CDC's own sector processing refills the buffer.
+//
+void PS_CDC::GetCDAudio(int32 (*samples)[2], const unsigned count)
+{
+   const unsigned freq = AudioBuffer.Freq;
+   unsigned k = 0;
+
+   if(freq == 7 || freq == 14)
+   {
+      for(; k < count && AudioBuffer.ReadPos < AudioBuffer.Size; k++)
+      {
+         ReadAudioBuffer(samples[k]);
+         if(freq == 14)
+            ReadAudioBuffer(samples[k]);
+
+         ApplyVolume(samples[k]);
+      }
+   }
+   else
+   {
+      while(k < count && AudioBuffer.ReadPos < AudioBuffer.Size)
+         k += ResampleCDAudio(&samples[k], std::min<unsigned>(count - k, 32));
+   }
+
+   for(; k < count; k++)
+   {
+      samples[k][0] = 0;
+      samples[k][1] = 0;
+   }
 }
 
 
@@ -691,31 +784,142 @@ void PS_CDC::ClearAudioBuffers(void)
    ADPCM_ResampCurPos = 0;
 }
 
+// Weights copied over from SPU channel ADPCM playback code, 
+// may not be entirely the same for CD-XA ADPCM, we need to run tests.
+static const int32 XA_Weights[16][2] =
+{
+   // s-1    s-2
+   {   0,    0 },
+   {  60,    0 },
+   { 115,  -52 },
+   {  98,  -55 },
+   { 122,  -60 },
+};
+
+#if defined(__SSE2__)
 //
-// output should be readable at -2 and -1
-static void DecodeXAADPCM(const uint8 *input, int16 *output, const unsigned shift, const unsigned weight)
-{
-   // Weights copied over from SPU channel ADPCM playback code, 
-   // may not be entirely the same for CD-XA ADPCM, we need to run tests.
-   static const int32 Weights[16][2] =
-   {
-      // s-1    s-2
-      {   0,    0 },
-      {  60,    0 },
-      { 115,  -52 },
-      {  98,  -55 },
-      { 122,  -60 },
-   };
+// Transposes rows[0...3](16 rows of 4 bytes, one byte per unit column) into one register per column, each holding
+// that column's 16 rows.
+//
+static INLINE void XA_TransposeRows(const __m128i *rows, __m128i *cols)
+{
+   __m128i y[4];
+
+   for(unsigned i = 0; i < 4; i++)
+   {
+      const __m128i x = _mm_unpacklo_epi8(rows[i], _mm_srli_si128(rows[i], 8));
+
+      y[i] = _mm_unpacklo_epi8(x, _mm_srli_si128(x, 8));
+   }
+
+   const __m128i t0 = _mm_unpacklo_epi32(y[0], y[1]);
+   const __m128i t1 = _mm_unpacklo_epi32(y[2], y[3]);
+   const __m128i t2 = _mm_unpackhi_epi32(y[0], y[1]);
+   const __m128i t3 = _mm_unpackhi_epi32(y[2], y[3]);
+
+   cols[0] = _mm_unpacklo_epi64(t0, t1);
+   cols[1] = _mm_unpackhi_epi64(t0, t1);
+   cols[2] = _mm_unpacklo_epi64(t2, t3);
+   cols[3] = _mm_unpackhi_epi64(t2, t3);
+}
+#endif
+
+//
+// Unpacks every unit of a sound group into units[unit][0...27], sign-extended into the top of 16 bits and shifted
+// right by the unit's shift parameter, ready for filtering.
+//
+static void XA_UnpackGroup(const XA_SoundGroup *sg, const unsigned unit_index_shift, int16 (*units)[32])
+{
+   const unsigned unit_count = 4U << unit_index_shift;
+#if defined(__SSE2__)
+   __m128i rows[8];
+   __m128i cols[2][4];
+
+   for(unsigned i = 0; i < 7; i++)
+      rows[i] = _mm_loadu_si128((const __m128i*)&sg->samples[i * 16]);
+   rows[7] = _mm_setzero_si128();
+
+   XA_TransposeRows(&rows[0], cols[0]);
+   XA_TransposeRows(&rows[4], cols[1]);
+
+   for(unsigned unit = 0; unit < unit_count; unit++)
+   {
+      const __m128i shift = _mm_cvtsi32_si128(sg->params[(unit & 3) | ((unit & 4) << 1)] & 0x0F);
+
+      for(unsigned h = 0; h < 2; h++)
+      {
+         __m128i b = cols[h][unit >> unit_index_shift];
+
+         if(unit_index_shift)
+         {
+            if(!(unit & 1))
+               b = _mm_slli_epi16(b, 4);
+            b = _mm_and_si128(b, _mm_set1_epi8((char)0xF0));
+         }
+
+         _mm_storeu_si128((__m128i*)&units[unit][h * 16 + 0], _mm_sra_epi16(_mm_unpacklo_epi8(_mm_setzero_si128(), b), shift));
+         _mm_storeu_si128((__m128i*)&units[unit][h * 16 + 8], _mm_sra_epi16(_mm_unpackhi_epi8(_mm_setzero_si128(), b), shift));
+      }
+   }
+#else
+   for(unsigned unit = 0; unit < unit_count; unit++)
+   {
+      const unsigned shift = sg->params[(unit & 3) | ((unit & 4) << 1)] & 0x0F;
+
+      for(unsigned i = 0; i < 28; i++)
+      {
+         uint8 tmp = sg->samples[i * 4 + (unit >> unit_index_shift)];
+
+         if(unit_index_shift)
+         {
+            tmp <<= (unit & 1) ? 0 : 4;
+            tmp &= 0xf0;
+         }
+
+         units[unit][i] = (int16)(tmp << 8) >> shift;
+      }
+   }
+#endif
+}
+
+//
+// Filters 28 unpacked samples for each of num_ch channels; the channels are independent, so their dependency chains
+// run interleaved.  previous[ch] holds the channel's last two outputs, oldest first.
+//
+template<unsigned num_ch>
+static INLINE void DecodeXAADPCM(const int16* const* input, int16* const* output, int16 (*previous)[2], const unsigned* weight)
+{
+   int32 w0[num_ch], w1[num_ch];
+   int32 p1[num_ch], p2[num_ch];
+
+   for(unsigned ch = 0; ch < num_ch; ch++)
+   {
+      w0[ch] = XA_Weights[weight[ch]][0];
+      w1[ch] = XA_Weights[weight[ch]][1];
+      p2[ch] = previous[ch][0];
+      p1[ch] = previous[ch][1];
+   }
 
-   for(int i = 0; i < 28; i++)
+   for(unsigned i = 0; i < 28; i++)
    {
-      int32 sample = (int16)(input[i] << 8);
-      sample >>= shift;
+      for(unsigned ch = 0; ch < num_ch; ch++)
+      {
+         int32 sample = input[ch][i];
 
-      sample += ((output[i - 1] * Weights[weight][0]) >> 6) + ((output[i - 2] * Weights[weight][1]) >> 6);
+         sample += ((p1[ch] * w0[ch]) >> 6) + ((p2[ch] * w1[ch]) >> 6);
 
-      clamp(&sample, -32768, 32767);
-      output[i] = sample;
+         clamp(&sample, -32768, 32767);
+         output[ch][i] = sample;
+
+         p2[ch] = p1[ch];
+         p1[ch] = sample;
+      }
+   }
+
+   for(unsigned ch = 0; ch < num_ch; ch++)
+   {
+      previous[ch][0] = p2[ch];
+      previous[ch][1] = p1[ch];
    }
 }
 
@@ -723,11 +927,13 @@ void PS_CDC::XA_ProcessSector(const uint8 *sdata, CD_Audio_Buffer *ab)
 {
    const XA_Subheader *sh = (const XA_Subheader *)&sdata[12 + 4];
    const unsigned unit_index_shift = (sh->coding & XA_CODING_8BIT) ? 0 : 1;
+   const unsigned unit_count = 4U << unit_index_shift;
+   const bool stereo = (bool)(sh->coding & XA_CODING_STEREO);
 
    ab->ReadPos = 0;
-   ab->Size = 18 * (4 << unit_index_shift) * 28;
+   ab->Size = 18 * unit_count * 28;
 
-   if(sh->coding & XA_CODING_STEREO)
+   if(stereo)
       ab->Size >>= 1;
 
    ab->Freq = (sh->coding & XA_CODING_189) ? 3 : 6;
@@ -737,59 +943,62 @@ void PS_CDC::XA_ProcessSector(const uint8 *sdata, CD_Audio_Buffer *ab)
    for(unsigned group = 0; group < 18; group++)
    {
       const XA_SoundGroup *sg = (const XA_SoundGroup *)&sdata[12 + 4 + 8 + group * 128];
+      int16 units[8][32];
+      bool param_ok[8];
 
-      for(unsigned unit = 0; unit < (4U << unit_index_shift); unit++)
+      XA_UnpackGroup(sg, unit_index_shift, units);
+
+      for(unsigned unit = 0; unit < unit_count; unit++)
       {
          const uint8 param = sg->params[(unit & 3) | ((unit & 4) << 1)];
          const uint8 param_copy = sg->params[4 | (unit & 3) | ((unit & 4) << 1)];
-         uint8 ibuffer[28];
-         int16 obuffer[2 + 28];
 
-         if(param != param_copy)
+         param_ok[unit] = (param == param_copy);
+
+         if(!param_ok[unit])
          {
             PSX_WARNING("[CDC] CD-XA param != param_copy --- %d %02x %02x\n", unit, param, param_copy);
          }
+      }
 
-         for(unsigned i = 0; i < 28; i++)
+      if(stereo)
+      {
+         // Even units are the left channel, odd units the right.
+         for(unsigned unit = 0; unit < unit_count; unit += 2)
          {
-            uint8 tmp = sg->samples[i * 4 + (unit >> unit_index_shift)];
+            const int16* input[2] = { units[unit], units[unit + 1] };
+            int16* output[2];
+            unsigned weight[2];
 
-            if(unit_index_shift)
+            for(unsigned ch = 0; ch < 2; ch++)
             {
-               tmp <<= (unit & 1) ? 0 : 4;
-               tmp &= 0xf0;
+               output[ch] = &ab->Samples[ch][group * (2 << unit_index_shift) * 28 + (unit >> 1) * 28];
+               weight[ch] = sg->params[((unit + ch) & 3) | (((unit + ch) & 4) << 1)] >> 4;
             }
 
-            ibuffer[i] = tmp;
-         }
-
-         const bool ocn = (bool)(unit & 1) && (sh->coding & XA_CODING_STEREO);
+            DecodeXAADPCM<2>(input, output, xa_previous, weight);
 
-         obuffer[0] = xa_previous[ocn][0];
-         obuffer[1] = xa_previous[ocn][1];
-
-         DecodeXAADPCM(ibuffer, &obuffer[2], param & 0x0F, param >> 4);
-
-         xa_previous[ocn][0] = obuffer[28];
-         xa_previous[ocn][1] = obuffer[29];
-
-         if(param != param_copy)
-            memset(obuffer, 0, sizeof(obuffer));
-
-         if(sh->coding & XA_CODING_STEREO)
-         {
-            for(unsigned s = 0; s < 28; s++)
+            for(unsigned ch = 0; ch < 2; ch++)
             {
-               ab->Samples[ocn][group * (2 << unit_index_shift) * 28 + (unit >> 1) * 28 + s] = obuffer[2 + s];
+               if(!param_ok[unit + ch])
+                  memset(output[ch], 0, 28 * sizeof(int16));
             }
          }
-         else
+      }
+      else
+      {
+         for(unsigned unit = 0; unit < unit_count; unit++)
          {
-            for(unsigned s = 0; s < 28; s++)
-            {
-               ab->Samples[0][group * (4 << unit_index_shift) * 28 + unit * 28 + s] = obuffer[2 + s];
-               ab->Samples[1][group * (4 << unit_index_shift) * 28 + unit * 28 + s] = obuffer[2 + s];
-            }
+            const int16* input[1] = { units[unit] };
+            int16* output[1] = { &ab->Samples[0][group * unit_count * 28 + unit * 28] };
+            unsigned weight[1] = { (unsigned)sg->params[(unit & 3) | ((unit & 4) << 1)] >> 4 };
+
+            DecodeXAADPCM<1>(input, output, xa_previous, weight);
+
+            if(!param_ok[unit])
+               memset(output[0], 0, 28 * sizeof(int16));
+
+            memcpy(&ab->Samples[1][group * unit_count * 28 + unit * 28], output[0], 28 * sizeof(int16));
          }
       }
    }
@@ -890,6 +1099,26 @@ void PS_CDC::EnbufferizeCDDASector(const uint8 *buf)
    ab->ReadPos = 0;
 }
 
+// Multiple of 1x speed sectors are read at.
+unsigned PS_CDC::ReadSpeed(void)
+{
+   if (Mode & MODE_SPEED) {
+      // We're in 2x mode
+      if (Mode & (MODE_CDDA | MODE_STRSND)) {
+         // We're probably streaming audio to the CD drive, keep the
+         // native speed
+         return 2;
+      }
+
+      // *Probably* not streaming audio, we can try increasing the
+      // *CD speed beyond native
+      return 2 * cd_2x_speedup;
+   }
+
+   // 1x mode
+   return 1;
+}
+
 void PS_CDC::HandlePlayRead(void)
 {
    uint8 read_buf[2352 + 96];
@@ -910,6 +1139,9 @@ void PS_CDC::HandlePlayRead(void)
       PSX_WARNING("[CDC] In leadout area: %u", CurSector);
    }
 
+   Cur_CDIF->HintReadMode(DriveStatus == DS_PLAYING ? CDIF_READ_CDDA :
+         (Mode & MODE_STRSND) ? CDIF_READ_XA : CDIF_READ_DATA, ReadSpeed());
+
    if (cd_async && SeekRetryCounter)
    {
       if (!Cur_CDIF->ReadRawSector(read_buf, CurSector, 0))
@@ -1086,25 +1318,7 @@ void PS_CDC::HandlePlayRead(void)
    SectorPipe_Pos = (SectorPipe_Pos + 1) % SectorPipe_Count;
    SectorPipe_In++;
 
-   unsigned speed_mul;
-
-   if (Mode & MODE_SPEED) {
-      // We're in 2x mode
-      if (Mode & (MODE_CDDA | MODE_STRSND)) {
-         // We're probably streaming audio to the CD drive, keep the
-         // native speed
-         speed_mul = 2;
-      } else {
-         // *Probably* not streaming audio, we can try increasing the
-         // *CD speed beyond native
-         speed_mul = 2 * cd_2x_speedup;
-      }
-   } else {
-      // 1x mode
-      speed_mul = 1;
-   }
-
-   PSRCounter += 33868800 / (75 * speed_mul);
+   PSRCounter += 33868800 / (75 * ReadSpeed());
 
    if(DriveStatus == DS_PLAYING)
    {
@@ -1129,6 +1343,7 @@ void PS_CDC::HandlePlayRead(void)
 
 int32_t PS_CDC::Update(const int32_t timestamp)
 {
+   PSX_PROFILE_SCOPE(PSX_PROF_CDC);
    int32 clocks = timestamp - lastts;
 
    overclock_cpu_to_device(clocks);
@@ -1145,7 +1360,7 @@ int32_t PS_CDC::Update(const int32_t timestamp)
       if(PendingCommandCounter > 0 && chunk_clocks > PendingCommandCounter)
          chunk_clocks = PendingCommandCounter;
 
-      if(chunk_clocks > SPUCounter)
+      if(chunk_clocks > SPUCounter && !CalcSPUSlack())
          chunk_clocks = SPUCounter;
 
       if(DiscStartupDelay > 0)
@@ -1168,6 +1383,14 @@ int32_t PS_CDC::Update(const int32_t timestamp)
             CDCReadyReceiveCounter -= chunk_clocks;
       }
 
+      //
+      // The SPU may be rendering more than one sample per chunk(see CalcSPUSlack()); render all but the chunk's last
+      // clock ahead of its events, so that, as when chunks were cut at every sample, a sample due before a sector
+      // event is played from the old audio buffer and one due at the same time from the new.
+      //
+      if(chunk_clocks > 1)
+         PSX_SPU->UpdateFromCDC(chunk_clocks - 1);
+
       CheckAIP();
 
       if(PSRCounter > 0)
@@ -1358,7 +1581,7 @@ int32_t PS_CDC::Update(const int32_t timestamp)
          }
       }
 
-      SPUCounter = PSX_SPU->UpdateFromCDC(chunk_clocks);
+      SPUCounter = PSX_SPU->UpdateFromCDC(1);
 
       clocks -= chunk_clocks;
    } // end while(clocks > 0)
@@ -1368,6 +1591,20 @@ int32_t PS_CDC::Update(const int32_t timestamp)
    return(timestamp + CalcNextEvent());
 }
 
+//
+// Brings the SPU up to timestamp before it's accessed, if it has samples due by then that it was let put off;
+// reschedule is for when the access may have changed how far ahead it can be put off.
+//
+void PS_CDC::SyncSPU(const int32_t timestamp, const bool reschedule)
+{
+   int32 clocks = timestamp - lastts;
+
+   overclock_cpu_to_device(clocks);
+
+   if(clocks >= SPUCounter || reschedule)
+      PSX_SetEventNT(PSX_EVENT_CDC, Update(timestamp));
+}
+
 void PS_CDC::Write(const int32_t timestamp, uint32 A, uint8 V)
 {
    A &= 0x3;
@@ -29,6 +29,7 @@ class PS_CDC
       int32 CalcNextEvent(void);	// Returns in master cycles to next event.
 
       int32_t Update(const int32_t timestamp);
+      void SyncSPU(const int32_t timestamp, const bool reschedule = false);
 
       void Write(const int32_t timestamp, uint32 A, uint8 V);
       uint8 Read(const int32_t timestamp, uint32 A);
@@ -37,7 +38,7 @@ class PS_CDC
       uint32 DMARead(void);
       void SoftReset(void);
 
-      void GetCDAudio(int32 samples[2], const unsigned freq);
+      void GetCDAudio(int32 (*samples)[2], const unsigned count);
 
       CD_Audio_Buffer AudioBuffer;
 
@@ -54,6 +55,7 @@ class PS_CDC
 
       void ApplyVolume(int32 samples[2]);
       void ReadAudioBuffer(int32 samples[2]);
+      unsigned ResampleCDAudio(int32 (*samples)[2], const unsigned count);
 
       void ClearAudioBuffers(void);
 
@@ -129,6 +131,7 @@ class PS_CDC
       int32 PendingCommandCounter;
 
       int32 SPUCounter;
+      int32 CalcSPUSlack(void);
 
       enum { MODE_SPEED = 0x80 };
       enum { MODE_STRSND = 0x40 };
@@ -205,6 +208,7 @@ class PS_CDC
       uint8 ReportLastF;
 
       void HandlePlayRead(void);
+      unsigned ReadSpeed(void);
 
       struct CDC_CTEntry
       {
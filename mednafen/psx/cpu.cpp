@@ -23,6 +23,7 @@
 
 #include "psx.h"
 #include "cpu.h"
+#include "profile.h"
 
 #include "../state_helpers.h"
 #include "../mednafen-endian.h"
@@ -2703,6 +2704,8 @@ pscpu_timestamp_t PS_CPU::RunReal(pscpu_timestamp_t timestamp_in)
 
 pscpu_timestamp_t PS_CPU::Run(pscpu_timestamp_t timestamp_in, bool BIOSPrintMode, bool ILHMode)
 {
+ PSX_PROFILE_SCOPE(PSX_PROF_CPU);
+
 #ifdef HAVE_LIGHTREC
 //track options changing
  if(MDFN_UNLIKELY(psx_dynarec != prev_dynarec || pgxpMode != PGXP_GetModes()) ||
@@ -19,6 +19,7 @@
 #include "mdec.h"
 #include "cdc.h"
 #include "spu.h"
+#include "profile.h"
 
 #include "../state_helpers.h"
 
@@ -304,6 +305,10 @@ static INLINE void RunChannel(int32_t timestamp, int32_t clocks, int ch)
    uint32_t CRModeCache = DMACH[ch].ChanControl &~(0x11 << 24);
    uint32_t crmodecache = CRModeCache;
 
+   // The SPU may be behind(see PS_CDC::SyncSPU()).
+   if(ch == CH_SPU && (DMACH[ch].ChanControl & (1 << 24)))
+      PSX_CDC->SyncSPU(timestamp);
+
    switch(ch)
    {
       case 0:
@@ -523,6 +528,7 @@ static INLINE int32_t CalcNextEvent(int32_t next_event)
 
 int32_t DMA_Update(const int32_t timestamp)
 {
+   PSX_PROFILE_SCOPE(PSX_PROF_DMA);
    int32_t clocks, i;
    //   uint32_t dc = (DMAControl >> (ch * 4)) & 0xF;
    clocks = timestamp - lastts;
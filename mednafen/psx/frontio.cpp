@@ -17,6 +17,8 @@
 
 #include "psx.h"
 #include "frontio.h"
+#include "memcard_writer.h"
+#include "profile.h"
 #include <compat/msvc.h>
 
 #include "../state_helpers.h"
@@ -101,7 +103,7 @@ static void crosshair_plot( uint32 *pixels,
 	int r, g, b, a;
 	int nr, ng, nb;
 
-	format->DecodeColor(pixels[x], r, g, b, a);
+	format->DecodeColor(format->ReadPixel(pixels, x), r, g, b, a);
 
 	nr = (r + chair_r * 3) >> 2;
 	ng = (g + chair_g * 3) >> 2;
@@ -123,7 +125,7 @@ static void crosshair_plot( uint32 *pixels,
 		}
 	}
 
-	pixels[x] = MAKECOLOR(nr, ng, nb, a);
+	format->WritePixel(pixels, x, MAKECOLOR(nr, ng, nb, a));
 }
 
 INLINE void InputDevice::DrawCrosshairs(uint32 *pixels, const MDFN_PixelFormat* const format, const unsigned width, const unsigned pix_clock, const unsigned surf_pitchinpix, const unsigned upscale_factor)
@@ -347,6 +349,10 @@ InputDevice *FrontIO::GetMemcardDevice(unsigned int which)
 void FrontIO::MapDevicesToPorts(void)
 {
    int i;
+
+   /* Devices save different state. */
+   StateLayoutSerial++;
+
    if(emulate_multitap[0] && emulate_multitap[1])
    {
       for (i = 0; i < 2; i++)
@@ -706,6 +712,7 @@ uint32_t FrontIO::Read(int32_t timestamp, uint32_t A)
 
 int32_t FrontIO::Update(int32_t timestamp)
 {
+   PSX_PROFILE_SCOPE(PSX_PROF_FIO);
    int32_t clocks, i;
    bool need_start_stop_check = false;
 
@@ -942,9 +949,17 @@ void FrontIO::SetInput(unsigned int port, const char *type, void *ptr)
 
 uint64_t FrontIO::GetMemcardDirtyCount(unsigned int which)
 {
+ uint64_t dc;
+
  assert(which < 8);
 
- return(DevicesMC[which]->GetNVDirtyCount());
+ dc = DevicesMC[which]->GetNVDirtyCount();
+
+ // A card whose last write failed is still unsaved, so it's saved again.
+ if(!dc && !MemcardPath[which].empty() && MemcardWriter_Failed(MemcardPath[which].c_str()))
+  dc = 1;
+
+ return(dc);
 }
 
 void FrontIO::LoadMemcard(unsigned int which)
@@ -964,7 +979,14 @@ void FrontIO::LoadMemcard(unsigned int which, const char *path, bool force_load)
 
  if(DevicesMC[which]->GetNVSize())
  {
-    RFILE *mf = filestream_open(path, RETRO_VFS_FILE_ACCESS_READ, 
+    RFILE *mf;
+
+    MemcardPath[which] = path;
+
+    // The file may still have a write queued.
+    MemcardWriter_Wait(path);
+
+    mf = filestream_open(path, RETRO_VFS_FILE_ACCESS_READ, 
           RETRO_VFS_FILE_ACCESS_HINT_NONE);
 
     if (!mf)
@@ -1003,19 +1025,13 @@ void FrontIO::SaveMemcard(unsigned int which, const char *path, bool force_save)
 {
  assert(which < 8);
 
- if(DevicesMC[which]->GetNVSize() && (force_save || DevicesMC[which]->GetNVDirtyCount()))
+ if(DevicesMC[which]->GetNVSize() && (force_save || DevicesMC[which]->GetNVDirtyCount() || MemcardWriter_Failed(path)))
  {
-    RFILE *mf = filestream_open(path, 
-          RETRO_VFS_FILE_ACCESS_WRITE,
-          RETRO_VFS_FILE_ACCESS_HINT_NONE);
-
-    if (!mf)
-       return;
+    MemcardPath[which] = path;
 
+    // Written in the background from a copy of the card.
     DevicesMC[which]->ReadNV(DevicesMC[which]->GetNVData(), 0, (1 << 17));
-    filestream_write(mf, DevicesMC[which]->GetNVData(), (1 << 17));
-
-    filestream_close(mf);	// Call before resetting the NV dirty count!
+    MemcardWriter_Queue(path, DevicesMC[which]->GetNVData(), (1 << 17));
 
     DevicesMC[which]->ResetNVDirtyCount();
  }
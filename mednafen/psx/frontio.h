@@ -1,6 +1,8 @@
 #ifndef __MDFN_PSX_FRONTIO_H
 #define __MDFN_PSX_FRONTIO_H
 
+#include <string>
+
 #include "../state_helpers.h"
 
 class InputDevice_Multitap;
@@ -115,6 +117,8 @@ class FrontIO
       void *DeviceData[8];
 
       InputDevice *DevicesMC[8];
+      // File each card was last loaded from or saved to.
+      std::string MemcardPath[8];
 
       int32_t ClockDivider;
 
@@ -26,6 +26,13 @@
 #include "../pgxp/pgxp_mem.h"
 
 #include "gpu_common.h"
+#include "gpu_simd.h"
+#include "gpu_replay.h"
+#include "profile.h"
+
+#ifdef HAVE_THREADS
+#include <rthreads/rthreads.h>
+#endif
 
 #include "gpu_polygon.cpp"
 #include "gpu_sprite.cpp"
@@ -101,6 +108,8 @@ static INLINE void InvalidateTexCache(PS_GPU *gpu)
    unsigned i;
    for (i = 0; i < 256; i++)
       gpu->TexCache[i].Tag = ~0U;
+
+   gpu->texcache_exact = false;
 }
 
 static INLINE void InvalidateCache(PS_GPU *gpu)
@@ -179,6 +188,8 @@ static void Command_FBFill(PS_GPU* gpu, const uint32 *cb)
    //printf("[GPU] FB Fill %d:%d w=%d, h=%d\n", destX, destY, width, height);
    gpu->DrawTimeAvail       -= 46; // Approximate
 
+   MarkDirty(gpu, destX, destY, width, height);
+
    for(y = 0; y < height; y++)
    {
       unsigned x;
@@ -189,6 +200,9 @@ static void Command_FBFill(PS_GPU* gpu, const uint32 *cb)
 
       gpu->DrawTimeAvail -= (width >> 3) + 9;
 
+      if(gpu->timing_only || !BandOwnsLine(gpu, d_y))
+         continue;
+
       for(x = 0; x < width; x++)
       {
          const int32 d_x = (x + destX) & 1023;
@@ -221,31 +235,39 @@ static void Command_FBCopy(PS_GPU* g, const uint32 *cb)
 
    g->DrawTimeAvail -= (width * height) * 2;
 
-   for(y = 0; y < height; y++)
-   {
-      unsigned x;
+   MarkDirty(g, destX, destY, width, height);
 
-      for(x = 0; x < width; x += 128)
+   if(!g->timing_only)
+   {
+      for(y = 0; y < height; y++)
       {
-         const int32 chunk_x_max = std::min<int32>(width - x, 128);
-         uint16 tmpbuf[128]; // TODO: Check and see if the GPU is actually (ab)using the CLUT or texture cache.
+         unsigned x;
+
+         if(!BandOwnsLine(g, (y + destY) & 511))
+            continue;
 
-         for(int32 chunk_x = 0; chunk_x < chunk_x_max; chunk_x++)
+         for(x = 0; x < width; x += 128)
          {
-            int32 s_y = (y + sourceY) & 511;
-            int32 s_x = (x + chunk_x + sourceX) & 1023;
+            const int32 chunk_x_max = std::min<int32>(width - x, 128);
+            uint16 tmpbuf[128]; // TODO: Check and see if the GPU is actually (ab)using the CLUT or texture cache.
 
-            // XXX make upscaling-friendly, as it is we copy at 1x
-            tmpbuf[chunk_x] = texel_fetch(g, s_x, s_y);
-         }
+            for(int32 chunk_x = 0; chunk_x < chunk_x_max; chunk_x++)
+            {
+               int32 s_y = (y + sourceY) & 511;
+               int32 s_x = (x + chunk_x + sourceX) & 1023;
 
-         for(int32 chunk_x = 0; chunk_x < chunk_x_max; chunk_x++)
-         {
-            int32 d_y = (y + destY) & 511;
-            int32 d_x = (x + chunk_x + destX) & 1023;
+               // XXX make upscaling-friendly, as it is we copy at 1x
+               tmpbuf[chunk_x] = texel_fetch(g, s_x, s_y);
+            }
 
-            if(!(texel_fetch(g, d_x, d_y) & g->MaskEvalAND))
-               texel_put(d_x, d_y, tmpbuf[chunk_x] | g->MaskSetOR);
+            for(int32 chunk_x = 0; chunk_x < chunk_x_max; chunk_x++)
+            {
+               int32 d_y = (y + destY) & 511;
+               int32 d_x = (x + chunk_x + destX) & 1023;
+
+               if(!(texel_fetch(g, d_x, d_y) & g->MaskEvalAND))
+                  texel_put(d_x, d_y, tmpbuf[chunk_x] | g->MaskSetOR);
+            }
          }
       }
    }
@@ -332,7 +354,7 @@ static void Command_DrawMode(PS_GPU* g, const uint32 *cb)
 
    if (g->dfe)
    {
-      GPU.display_possibly_dirty = true;
+      g->display_possibly_dirty = true;
       //printf("Display possibly dirty this frame\n");
    }
 
@@ -618,6 +640,901 @@ static void RSX_UpdateDisplayMode(void)
          curr_width_mode);
 }
 
+/* Writes one FIFO word of an FBWrite transfer at the current cursor
+ * position (only if plot is set) and advances the cursor. Returns true
+ * once the whole rectangle has been transferred. */
+static bool FBWrite_Data(PS_GPU *g, uint32_t InData, bool plot)
+{
+   unsigned i;
+   bool sw = rsx_intf_has_software_renderer();
+
+   for(i = 0; i < 2; i++)
+   {
+      MarkDirty(g, g->FBRW_CurX, g->FBRW_CurY, 1, 1);
+
+      if (plot && BandOwnsLine(g, g->FBRW_CurY & 511))
+      {
+         /* Cannot rely on mask bit if we don't have SW renderer, HW renderer will
+          * perform masking. */
+         bool fetch = false;
+         if (sw)
+            fetch = texel_fetch(g, g->FBRW_CurX & 1023, g->FBRW_CurY & 511) & g->MaskEvalAND;
+
+         if (!fetch)
+            texel_put(g->FBRW_CurX & 1023, g->FBRW_CurY & 511, InData | g->MaskSetOR);
+      }
+
+      g->FBRW_CurX++;
+      if(g->FBRW_CurX == (g->FBRW_X + g->FBRW_W))
+      {
+         g->FBRW_CurX = g->FBRW_X;
+         g->FBRW_CurY++;
+         if(g->FBRW_CurY == (g->FBRW_Y + g->FBRW_H))
+         {
+            g->InCmd = INCMD_NONE;
+            return true;
+         }
+      }
+      InData >>= 16;
+   }
+
+   return false;
+}
+
+#ifdef HAVE_THREADS
+/* Threaded software rasterizer
+ *
+ * The emulation thread still runs every GP0 command, but with
+ * GPU.timing_only set: DrawTimeAvail, the texture cache tags and the
+ * command state evolve exactly as in the synchronous renderer, while VRAM
+ * is left untouched. The commands are also recorded into a ring and
+ * replayed by a pool of rasterizer threads, each on its own copy of the
+ * drawing state; those threads are the only writers of VRAM while the
+ * mode is active.
+ *
+ * With more than one thread, VRAM rows are split into interleaved bands
+ * of RASTER_BAND_ROWS native rows and every thread only draws the rows
+ * it owns. Each thread walks the whole command stream in order, so
+ * primitive order (and with it blending and mask results) within a row
+ * is the same as in the synchronous renderer. Reads of rows owned by
+ * other threads (textures, CLUTs) are ordered with barriers, inserted by
+ * the emulation thread from a coarse map of what was read and written
+ * since the last barrier. Commands that read what they write themselves,
+ * and FBCopy, run on a single thread between two barriers.
+ *
+ * The emulation thread only waits for the rasterizers when it needs VRAM
+ * contents itself: FBRead, scanout of a line with pending writes, save
+ * states, and the end of the frame.
+ */
+
+#define RASTER_RING_SIZE     4096
+#define RASTER_BATCH_SIZE    64
+#define RASTER_PUBLISH_SIZE  32
+#define RASTER_MAX_REGIONS   32
+#define RASTER_MAX_THREADS   16
+#define RASTER_BAND_ROWS     8
+#define RASTER_SNAPSHOTS     8
+
+enum raster_entry_type
+{
+   RASTER_CMD = 0,
+   RASTER_CMD_TPAGE,    // Command preceded by the SetTPage() kludge
+   RASTER_FBWRITE_DATA,
+   RASTER_TEXCACHE      // Start mirroring the texture cache, see Raster_CheckTexCache()
+};
+
+enum
+{
+   RASTER_BARRIER_BEFORE = 1 << 0,  // All earlier entries done everywhere first
+   RASTER_BARRIER_AFTER  = 1 << 1,  // Done everywhere before any later entry
+   RASTER_SOLO           = 1 << 2   // Drawn entirely by the first thread
+};
+
+struct raster_entry
+{
+   void (*func)(PS_GPU* g, const uint32 *cb);
+   uint32 cb[0x10];
+
+   // Display state that LineSkipTest() depends on, and command state
+   // that can change outside of recorded commands.
+   uint32 DisplayMode;
+   uint32 DisplayFB_YStart;
+   bool field_ram_readout;
+   bool TexDisableAllowChange;
+   uint8 InCmd;
+   uint8 InCmd_CC;
+
+   uint8 type;
+   uint8 flags;
+};
+
+/* Rows of VRAM with writes still in flight. */
+struct raster_region
+{
+   unsigned y0, y1;  // Inclusive, native resolution
+   uint32 seq;       // Written once completed reaches this
+};
+
+/* Coarse map of VRAM in 64x8 tiles, one bit each, 16 tiles per row. */
+struct raster_tiles
+{
+   uint64 bits[16];
+};
+
+struct raster_worker
+{
+   PS_GPU gpu;        // This thread's copy of the drawing state
+   uint32 completed;  // Protected by Raster.lock
+   unsigned index;
+   sthread_t *thread;
+};
+
+static struct
+{
+   raster_entry ring[RASTER_RING_SIZE];
+   uint32 snapshots[RASTER_SNAPSHOTS][256];
+
+   // Emulation thread only
+   uint32 submitted;
+   uint32 completed_seen;
+   uint32 snapshot_seq[RASTER_SNAPSHOTS];
+   unsigned snapshot_next;
+   raster_region regions[RASTER_MAX_REGIONS];
+   unsigned region_count;
+   raster_tiles read;      // Since the last barrier
+   raster_tiles written;   // Since the last barrier
+   unsigned requested;
+   unsigned started;       // What the running pool was asked for; count may be less
+   bool active;
+
+   // Protected by lock
+   uint32 published;
+   uint32 completed;       // Minimum over all workers
+   bool quit;
+
+   raster_worker *workers;
+   unsigned count;
+   slock_t *lock;
+   scond_t *work_cond;
+   scond_t *done_cond;
+} Raster;
+
+static void Raster_Publish(raster_worker *w, uint32 seq)
+{
+   unsigned i;
+   uint32 min = seq;
+
+   w->completed = seq;
+
+   for (i = 0; i < Raster.count; i++)
+   {
+      if ((int32)(Raster.workers[i].completed - min) < 0)
+         min = Raster.workers[i].completed;
+   }
+
+   if (min != Raster.completed)
+   {
+      Raster.completed = min;
+      scond_broadcast(Raster.done_cond);
+   }
+}
+
+/* Marks seq as reached by w and waits for every other worker to get there. */
+static void Raster_Barrier(raster_worker *w, uint32 seq)
+{
+   slock_lock(Raster.lock);
+   Raster_Publish(w, seq);
+   while ((int32)(Raster.completed - seq) < 0)
+      scond_wait(Raster.done_cond, Raster.lock);
+   slock_unlock(Raster.lock);
+}
+
+static void Raster_LoadTexCache(PS_GPU *g, const uint32 *tags)
+{
+   unsigned i, j;
+
+   for (i = 0; i < 256; i++)
+   {
+      g->TexCache[i].Tag = tags[i];
+
+      if (tags[i] == ~0U)
+         continue;
+
+      for (j = 0; j < 4; j++)
+         g->TexCache[i].Data[j] = texel_fetch(g, (tags[i] + j) & 1023, (tags[i] >> 10) & 511);
+   }
+
+   g->texcache_exact = true;
+}
+
+static void Raster_Execute(raster_worker *w, const raster_entry *e)
+{
+   PS_GPU *g = &w->gpu;
+   uint64 band_rows[8];
+
+   g->DisplayMode           = e->DisplayMode;
+   g->DisplayFB_YStart      = e->DisplayFB_YStart;
+   g->field_ram_readout     = e->field_ram_readout;
+   g->TexDisableAllowChange = e->TexDisableAllowChange;
+   g->InCmd                 = e->InCmd;
+   g->InCmd_CC              = e->InCmd_CC;
+   g->DrawTimeAvail         = 0;
+
+   if (e->flags & RASTER_SOLO)
+   {
+      memcpy(band_rows, g->band_rows, sizeof(band_rows));
+      memset(g->band_rows, w->index ? 0x00 : 0xFF, sizeof(g->band_rows));
+   }
+
+   switch (e->type)
+   {
+      case RASTER_FBWRITE_DATA:
+         FBWrite_Data(g, e->cb[0], true);
+         break;
+      case RASTER_TEXCACHE:
+         Raster_LoadTexCache(g, Raster.snapshots[e->cb[0]]);
+         break;
+      case RASTER_CMD_TPAGE:
+         {
+            const uint32 cc = e->cb[0] >> 24;
+            SetTPage(g, e->cb[4 + ((cc >> 4) & 0x1)] >> 16);
+         }
+         /* fall-through */
+      case RASTER_CMD:
+         e->func(g, e->cb);
+         break;
+   }
+
+   if (e->flags & RASTER_SOLO)
+      memcpy(g->band_rows, band_rows, sizeof(band_rows));
+}
+
+static void Raster_ThreadMain(void *data)
+{
+   raster_worker *w = (raster_worker*)data;
+
+   slock_lock(Raster.lock);
+
+   for (;;)
+   {
+      uint32 seq, end;
+
+      while (w->completed == Raster.published && !Raster.quit)
+         scond_wait(Raster.work_cond, Raster.lock);
+
+      if (w->completed == Raster.published)
+         break;
+
+      seq = w->completed;
+      end = Raster.published;
+      if (end - seq > RASTER_BATCH_SIZE)
+         end = seq + RASTER_BATCH_SIZE;
+      slock_unlock(Raster.lock);
+
+      for (; seq != end; seq++)
+      {
+         const raster_entry *e = &Raster.ring[seq % RASTER_RING_SIZE];
+
+         if (e->flags & RASTER_BARRIER_BEFORE)
+            Raster_Barrier(w, seq);
+
+         Raster_Execute(w, e);
+
+         if (e->flags & RASTER_BARRIER_AFTER)
+            Raster_Barrier(w, seq + 1);
+      }
+
+      slock_lock(Raster.lock);
+      Raster_Publish(w, end);
+   }
+
+   slock_unlock(Raster.lock);
+}
+
+/* Hands everything submitted so far over to the workers. */
+static void Raster_Flush(void)
+{
+   if (!Raster.active || Raster.published == Raster.submitted)
+      return;
+
+   slock_lock(Raster.lock);
+   Raster.published = Raster.submitted;
+   scond_broadcast(Raster.work_cond);
+   slock_unlock(Raster.lock);
+}
+
+static void Raster_WaitFor(uint32 seq)
+{
+   if ((int32)(Raster.completed_seen - seq) >= 0)
+      return;
+
+   Raster_Flush();
+
+   slock_lock(Raster.lock);
+   while ((int32)(Raster.completed - seq) < 0)
+      scond_wait(Raster.done_cond, Raster.lock);
+   Raster.completed_seen = Raster.completed;
+   slock_unlock(Raster.lock);
+}
+
+static void Raster_Sync(void)
+{
+   if (!Raster.active)
+      return;
+
+   Raster_WaitFor(Raster.submitted);
+   Raster.region_count = 0;
+   memset(&Raster.read, 0, sizeof(Raster.read));
+   memset(&Raster.written, 0, sizeof(Raster.written));
+}
+
+/* Waits until no pending command can still write to VRAM row y. */
+static void Raster_WaitRow(unsigned y)
+{
+   unsigned i, j;
+
+   if (!Raster.active)
+      return;
+
+   // Regions are kept in submission order, so the last match is the
+   // one that completes last.
+   for (i = Raster.region_count; i-- > 0;)
+   {
+      if (y >= Raster.regions[i].y0 && y <= Raster.regions[i].y1)
+      {
+         Raster_WaitFor(Raster.regions[i].seq);
+         break;
+      }
+   }
+
+   for (i = j = 0; i < Raster.region_count; i++)
+   {
+      if ((int32)(Raster.completed_seen - Raster.regions[i].seq) < 0)
+         Raster.regions[j++] = Raster.regions[i];
+   }
+   Raster.region_count = j;
+}
+
+static void Raster_AddRegion(uint32 y, uint32 h)
+{
+   raster_region *r;
+   unsigned y0 = y & 511;
+   unsigned y1 = y0 + h - 1;
+
+   if (h >= 512 || y1 > 511)
+   {
+      y0 = 0;
+      y1 = 511;
+   }
+
+   if (Raster.region_count)
+   {
+      r = &Raster.regions[Raster.region_count - 1];
+
+      if (r->y0 == y0 && r->y1 == y1)
+      {
+         r->seq = Raster.submitted;
+         return;
+      }
+   }
+
+   if (Raster.region_count == RASTER_MAX_REGIONS)
+   {
+      // Out of slots, fold everything into one conservative region.
+      r = &Raster.regions[0];
+
+      for (unsigned i = 1; i < Raster.region_count; i++)
+      {
+         r->y0 = std::min(r->y0, Raster.regions[i].y0);
+         r->y1 = std::max(r->y1, Raster.regions[i].y1);
+      }
+
+      r->y0  = std::min(r->y0, y0);
+      r->y1  = std::max(r->y1, y1);
+      r->seq = Raster.submitted;
+      Raster.region_count = 1;
+      return;
+   }
+
+   r = &Raster.regions[Raster.region_count++];
+   r->y0  = y0;
+   r->y1  = y1;
+   r->seq = Raster.submitted;
+}
+
+/* Adds the (wrapping) VRAM rectangle to a tile map. */
+static void Raster_TileRect(raster_tiles *t, uint32 x, uint32 y, uint32 w, uint32 h)
+{
+   uint32 tx0, tx1, ty0, ty1, ty;
+   uint64 mask;
+
+   if (!w || !h)
+      return;
+
+   x &= 1023;
+   y &= 511;
+   w  = std::min<uint32>(w, 1024);
+   h  = std::min<uint32>(h, 512);
+
+   if (x + w > 1024)
+   {
+      Raster_TileRect(t, 0, y, x + w - 1024, h);
+      w = 1024 - x;
+   }
+
+   if (y + h > 512)
+   {
+      Raster_TileRect(t, x, 0, w, y + h - 512);
+      h = 512 - y;
+   }
+
+   tx0  = x >> 6;
+   tx1  = (x + w - 1) >> 6;
+   ty0  = y >> 3;
+   ty1  = (y + h - 1) >> 3;
+   mask = ((2ULL << tx1) - 1) & ~((1ULL << tx0) - 1);
+
+   for (ty = ty0; ty <= ty1; ty++)
+      t->bits[ty >> 2] |= mask << ((ty & 3) * 16);
+}
+
+static bool Raster_TilesOverlap(const raster_tiles *a, const raster_tiles *b)
+{
+   unsigned i;
+
+   for (i = 0; i < 16; i++)
+   {
+      if (a->bits[i] & b->bits[i])
+         return true;
+   }
+
+   return false;
+}
+
+static void Raster_TilesOr(raster_tiles *a, const raster_tiles *b)
+{
+   unsigned i;
+
+   for (i = 0; i < 16; i++)
+      a->bits[i] |= b->bits[i];
+}
+
+static raster_entry *Raster_Begin(uint8 type)
+{
+   raster_entry *e;
+
+   if (Raster.submitted - Raster.completed_seen == RASTER_RING_SIZE)
+   {
+      Raster_Flush();
+
+      slock_lock(Raster.lock);
+      while (Raster.submitted - Raster.completed == RASTER_RING_SIZE)
+         scond_wait(Raster.done_cond, Raster.lock);
+      Raster.completed_seen = Raster.completed;
+      slock_unlock(Raster.lock);
+   }
+
+   e = &Raster.ring[Raster.submitted % RASTER_RING_SIZE];
+
+   e->type                  = type;
+   e->flags                 = 0;
+   e->DisplayMode           = GPU.DisplayMode;
+   e->DisplayFB_YStart      = GPU.DisplayFB_YStart;
+   e->field_ram_readout     = GPU.field_ram_readout;
+   e->TexDisableAllowChange = GPU.TexDisableAllowChange;
+   e->InCmd                 = GPU.InCmd;
+   e->InCmd_CC              = GPU.InCmd_CC;
+
+   return e;
+}
+
+/* Queues the entry from Raster_Begin(), which may write VRAM rows y to
+ * y + h - 1 (h == 0 if it doesn't write VRAM at all). */
+static void Raster_Submit(uint32 y, uint32 h)
+{
+   Raster.submitted++;
+
+   if (h)
+      Raster_AddRegion(y, h);
+
+   if (Raster.submitted - Raster.published >= RASTER_PUBLISH_SIZE)
+      Raster_Flush();
+}
+
+/* Orders an entry reading and writing the given tiles against what other
+ * workers may still be doing, and records its accesses. */
+static void Raster_Order(raster_entry *e, const raster_tiles *rd, const raster_tiles *wr)
+{
+   if (Raster.count < 2)
+      return;
+
+   if (Raster_TilesOverlap(rd, wr))
+      e->flags |= RASTER_SOLO | RASTER_BARRIER_BEFORE | RASTER_BARRIER_AFTER;
+   else if (Raster_TilesOverlap(rd, &Raster.written) || Raster_TilesOverlap(wr, &Raster.read))
+      e->flags |= RASTER_BARRIER_BEFORE;
+
+   if (e->flags & (RASTER_BARRIER_BEFORE | RASTER_BARRIER_AFTER))
+   {
+      memset(&Raster.read, 0, sizeof(Raster.read));
+      memset(&Raster.written, 0, sizeof(Raster.written));
+   }
+
+   if (!(e->flags & RASTER_BARRIER_AFTER))
+   {
+      Raster_TilesOr(&Raster.read, rd);
+      Raster_TilesOr(&Raster.written, wr);
+   }
+}
+
+/* Banded workers normally bypass the texture cache and fetch texels
+ * straight from VRAM, which gives the same result as long as nothing
+ * cached has been overwritten since it was loaded. Before a write that
+ * would make a cached block stale, hand every worker the emulation
+ * thread's (exact) cache tags so they can mirror the cache from then on,
+ * until it's next invalidated. Commands that texture from what they draw
+ * always need this, since they can overwrite blocks they cached. */
+static void Raster_CheckTexCache(const raster_tiles *wr, bool force)
+{
+   static const uint32 page_width[4] = { 64, 128, 256, 256 };
+   raster_tiles page, tag;
+   raster_entry *e;
+   unsigned i, slot;
+   bool stale = false;
+
+   if (Raster.count < 2 || GPU.texcache_exact)
+      return;
+
+   memset(&page, 0, sizeof(page));
+   stale = force;
+   Raster_TileRect(&page, GPU.TexPageX, GPU.TexPageY, page_width[GPU.TexMode & 3], 256);
+
+   if (!stale && !Raster_TilesOverlap(&page, wr))
+      return;
+
+   for (i = 0; i < 256 && !stale; i++)
+   {
+      if (GPU.TexCache[i].Tag == ~0U)
+         continue;
+
+      memset(&tag, 0, sizeof(tag));
+      Raster_TileRect(&tag, GPU.TexCache[i].Tag & 1023, (GPU.TexCache[i].Tag >> 10) & 511, 4, 1);
+      stale = Raster_TilesOverlap(&tag, wr);
+   }
+
+   if (!stale)
+      return;
+
+   slot = Raster.snapshot_next;
+   Raster.snapshot_next = (slot + 1) % RASTER_SNAPSHOTS;
+
+   // The slot's previous snapshot may still be waiting to be loaded.
+   Raster_WaitFor(Raster.snapshot_seq[slot]);
+
+   for (i = 0; i < 256; i++)
+      Raster.snapshots[slot][i] = GPU.TexCache[i].Tag;
+
+   e        = Raster_Begin(RASTER_TEXCACHE);
+   e->flags = RASTER_BARRIER_BEFORE | RASTER_BARRIER_AFTER;
+   e->cb[0] = slot;
+   Raster_Submit(0, 0);
+
+   Raster.snapshot_seq[slot] = Raster.submitted;
+   GPU.texcache_exact = true;
+
+   memset(&Raster.read, 0, sizeof(Raster.read));
+   memset(&Raster.written, 0, sizeof(Raster.written));
+}
+
+static void Raster_RecordFBWriteData(uint32 InData)
+{
+   raster_entry *e;
+
+   if (!Raster.active)
+      return;
+
+   e        = Raster_Begin(RASTER_FBWRITE_DATA);
+   e->cb[0] = InData;
+
+   // A word covers two pixels, possibly wrapping onto the next row.
+   Raster_Submit(GPU.FBRW_CurY, 2);
+}
+
+static void Raster_RecordCommand(uint32 cc, const uint32 *CB, unsigned len,
+      void (*func)(PS_GPU* g, const uint32 *cb), bool set_tpage)
+{
+   static const uint32 page_width[4] = { 64, 128, 256, 256 };
+   raster_entry *e;
+   raster_tiles rd, wr;
+   uint32 y = 0, h = 0;
+
+   if (!Raster.active || func == Command_IRQ)
+      return;
+
+   memset(&rd, 0, sizeof(rd));
+   memset(&wr, 0, sizeof(wr));
+
+   if (cc == 0x02)
+   {
+      y = (CB[1] >> 16) & 0x3FF;
+      h = (CB[2] >> 16) & 0x1FF;
+      Raster_TileRect(&wr, CB[1] & 0x3F0, y, ((CB[2] & 0x3FF) + 0xF) & ~0xF, h);
+   }
+   else if (cc >= 0x20 && cc <= 0x7F)
+   {
+      y = GPU.ClipY0;
+      h = GPU.ClipY1 >= GPU.ClipY0 ? GPU.ClipY1 - GPU.ClipY0 + 1 : 0;
+
+      if (GPU.ClipX1 >= GPU.ClipX0)
+         Raster_TileRect(&wr, GPU.ClipX0, y, GPU.ClipX1 - GPU.ClipX0 + 1, h);
+
+      // Textured polygons and sprites
+      if ((cc < 0x40 || cc >= 0x60) && (cc & 0x4))
+      {
+         Raster_TileRect(&rd, GPU.TexPageX, GPU.TexPageY, page_width[GPU.TexMode & 3], 256);
+
+         if (GPU.TexMode < 2 && GPU.InCmd == INCMD_NONE)
+         {
+            const uint32 clut = CB[2] >> 16;
+            Raster_TileRect(&rd, (clut & 0x3F) << 4, (clut >> 6) & 0x1FF, GPU.TexMode ? 256 : 16, 1);
+         }
+      }
+   }
+   else if (cc >= 0x80 && cc <= 0x9F)
+   {
+      y = (CB[2] >> 16) & 0x3FF;
+      h = ((CB[3] >> 16) & 0x1FF) ? ((CB[3] >> 16) & 0x1FF) : 0x200;
+   }
+   else if (cc >= 0xA0 && cc <= 0xBF)
+   {
+      const uint32 fw = (CB[2] & 0x3FF) ? (CB[2] & 0x3FF) : 0x400;
+      const uint32 fh = ((CB[2] >> 16) & 0x1FF) ? ((CB[2] >> 16) & 0x1FF) : 0x200;
+      Raster_TileRect(&wr, CB[1] & 0x3FF, (CB[1] >> 16) & 0x3FF, fw, fh);
+   }
+
+   // FBWrite and FBCopy invalidate the cache before writing anything.
+   if (cc < 0x80)
+      Raster_CheckTexCache(&wr, Raster_TilesOverlap(&rd, &wr));
+
+   e       = Raster_Begin(set_tpage ? RASTER_CMD_TPAGE : RASTER_CMD);
+   e->func = func;
+   memcpy(e->cb, CB, len * sizeof(*CB));
+
+   if (cc >= 0x80 && cc <= 0x9F)
+   {
+      if (Raster.count > 1)
+      {
+         e->flags = RASTER_SOLO | RASTER_BARRIER_BEFORE | RASTER_BARRIER_AFTER;
+         memset(&Raster.read, 0, sizeof(Raster.read));
+         memset(&Raster.written, 0, sizeof(Raster.written));
+      }
+   }
+   else
+      Raster_Order(e, &rd, &wr);
+
+   Raster_Submit(y, h);
+
+   // FBRead data is returned straight from VRAM by GPU_ReadData().
+   if (cc >= 0xC0 && cc <= 0xDF)
+      Raster_Sync();
+}
+
+/* Makes GPU whole again: waits for the rasterizers and copies back the
+ * cache contents the emulation thread doesn't maintain. */
+static void Raster_Pull(void)
+{
+   if (!Raster.active)
+      return;
+
+   Raster_Sync();
+
+   memcpy(GPU.CLUT_Cache, Raster.workers[0].gpu.CLUT_Cache, sizeof(GPU.CLUT_Cache));
+
+   if (Raster.workers[0].gpu.banded && !Raster.workers[0].gpu.texcache_exact)
+   {
+      // Nothing cached is stale, so VRAM has the data for our tags.
+      for (unsigned i = 0; i < 256; i++)
+      {
+         const uint32 tag = GPU.TexCache[i].Tag;
+
+         if (tag == ~0U)
+            continue;
+
+         for (unsigned j = 0; j < 4; j++)
+            GPU.TexCache[i].Data[j] = texel_fetch(&GPU, (tag + j) & 1023, (tag >> 10) & 511);
+      }
+   }
+   else
+      memcpy(GPU.TexCache, Raster.workers[0].gpu.TexCache, sizeof(GPU.TexCache));
+}
+
+/* Reseeds the rasterizers' copies of the drawing state from GPU, which
+ * must be whole (see Raster_Pull()). */
+static void Raster_Push(void)
+{
+   unsigned i, y;
+
+   if (!Raster.active)
+      return;
+
+   for (i = 0; i < Raster.count; i++)
+   {
+      PS_GPU *g = &Raster.workers[i].gpu;
+
+      *g                = GPU;
+      g->timing_only    = false;
+      g->track_writes   = false;
+      g->banded         = Raster.count > 1;
+      g->texcache_exact = false;
+
+      if (!g->banded)
+         continue;
+
+      memset(g->band_rows, 0, sizeof(g->band_rows));
+
+      for (y = 0; y < 512; y++)
+      {
+         if ((y / RASTER_BAND_ROWS) % Raster.count == i)
+            g->band_rows[y >> 6] |= 1ULL << (y & 63);
+      }
+
+      // GPU's cache contents are whole here, so every worker can start
+      // out mirroring it.
+      g->texcache_exact = true;
+   }
+
+   if (Raster.count > 1)
+      GPU.texcache_exact = true;
+
+   memset(&Raster.read, 0, sizeof(Raster.read));
+   memset(&Raster.written, 0, sizeof(Raster.written));
+}
+
+static void Raster_Stop(void)
+{
+   unsigned i;
+
+   if (!Raster.active)
+      return;
+
+   Raster_Pull();
+
+   slock_lock(Raster.lock);
+   Raster.quit = true;
+   scond_broadcast(Raster.work_cond);
+   slock_unlock(Raster.lock);
+
+   for (i = 0; i < Raster.count; i++)
+      sthread_join(Raster.workers[i].thread);
+
+   scond_free(Raster.done_cond);
+   scond_free(Raster.work_cond);
+   slock_free(Raster.lock);
+   delete [] Raster.workers;
+
+   Raster.workers   = NULL;
+   Raster.count     = 0;
+   Raster.done_cond = NULL;
+   Raster.work_cond = NULL;
+   Raster.lock      = NULL;
+
+   Raster.active   = false;
+   GPU.timing_only = false;
+}
+
+static void Raster_Start(unsigned count)
+{
+   unsigned i;
+
+   if (Raster.active)
+      return;
+
+   Raster.submitted      = 0;
+   Raster.completed_seen = 0;
+   Raster.region_count   = 0;
+   Raster.snapshot_next  = 0;
+   Raster.published      = 0;
+   Raster.completed      = 0;
+   Raster.quit           = false;
+   memset(Raster.snapshot_seq, 0, sizeof(Raster.snapshot_seq));
+
+   Raster.lock      = slock_new();
+   Raster.work_cond = scond_new();
+   Raster.done_cond = scond_new();
+   Raster.workers   = new raster_worker[count];
+   Raster.count     = 0;
+
+   // Workers only start running once there's something published, so
+   // they can be seeded afterwards.
+   Raster.active   = true;
+   GPU.timing_only = true;
+
+   if (Raster.lock && Raster.work_cond && Raster.done_cond)
+   {
+      for (i = 0; i < count; i++)
+      {
+         raster_worker *w = &Raster.workers[i];
+
+         w->completed = 0;
+         w->index     = i;
+         w->thread    = sthread_create(Raster_ThreadMain, w);
+
+         if (!w->thread)
+            break;
+
+         Raster.count++;
+      }
+   }
+
+   // Make do with however many threads could be started; the next restart
+   // tries for the full count again.
+   Raster.started = count;
+
+   if (!Raster.count)
+   {
+      if (Raster.done_cond)
+         scond_free(Raster.done_cond);
+      if (Raster.work_cond)
+         scond_free(Raster.work_cond);
+      if (Raster.lock)
+         slock_free(Raster.lock);
+      delete [] Raster.workers;
+
+      Raster.workers   = NULL;
+      Raster.done_cond = NULL;
+      Raster.work_cond = NULL;
+      Raster.lock      = NULL;
+      Raster.active    = false;
+      GPU.timing_only  = false;
+      return;
+   }
+
+   Raster_Push();
+}
+
+/* Starts, stops or resizes the rasterizer pool as settings require;
+ * called between frames. Only plain software rendering can use it: the
+ * hardware renderers need their own draw calls in order, and PGXP keeps
+ * per-vertex state on the emulation thread. */
+static void Raster_Update(void)
+{
+   unsigned want = Raster.requested;
+
+   if (rsx_intf_is_type() != RSX_SOFTWARE || PGXP_enabled())
+      want = 0;
+
+#ifdef RSX_DUMP
+   want = 0;
+#endif
+
+   if (Raster.active && Raster.started != want)
+      Raster_Stop();
+
+   if (!want)
+      return;
+
+   if (!Raster.active)
+   {
+      Raster_Start(want);
+      return;
+   }
+
+   // Pick up anything changed between frames (dither/upscale settings).
+   Raster_Pull();
+   Raster_Push();
+}
+#else
+static INLINE void Raster_Flush(void) { }
+static INLINE void Raster_WaitRow(unsigned y) { }
+static INLINE void Raster_RecordFBWriteData(uint32 InData) { }
+static INLINE void Raster_RecordCommand(uint32 cc, const uint32 *CB, unsigned len,
+      void (*func)(PS_GPU* g, const uint32 *cb), bool set_tpage) { }
+static INLINE void Raster_Sync(void) { }
+static INLINE void Raster_Pull(void) { }
+static INLINE void Raster_Push(void) { }
+static INLINE void Raster_Stop(void) { }
+static INLINE void Raster_Update(void) { }
+#endif
+
 /* Forward decls */
 void GPU_RestoreStateP1(bool);
 void GPU_RestoreStateP2(bool);
@@ -637,6 +1554,17 @@ static uint16_t *VRAM_Alloc(uint8 upscale_shift)
    return vram;
 }
 
+static void RecalcDitherRow(void)
+{
+   for(unsigned y = 0; y < 4; y++)
+      for(unsigned x = 0; x < 64 + 16; x++)
+         GPU.DitherRow[y][x] = dither_table[y][(x >> GPU.dither_upscale_shift) & 3];
+}
+
+#ifdef GPU_SIMD_X86_DISPATCH
+static void Scanout_InitKernels(void);
+#endif
+
 void GPU_Init(bool pal_clock_and_tv,
       int sls, int sle, uint8 upscale_shift)
 {
@@ -645,6 +1573,10 @@ void GPU_Init(bool pal_clock_and_tv,
 
    int x, y, v;
 
+#ifdef GPU_SIMD_X86_DISPATCH
+   Scanout_InitKernels();
+#endif
+
    GPU.HardwarePALType = pal_clock_and_tv;
 
    for(y = 0; y < 4; y++)
@@ -684,11 +1616,16 @@ void GPU_Init(bool pal_clock_and_tv,
 
    GPU.display_possibly_dirty = false;
    GPU.display_change_count = 0;
+   GPU.display_dirty = true;
+   GPU.track_writes = true;
 
    GPU.upscale_shift = upscale_shift;
    GPU.dither_upscale_shift = 0;
+   RecalcDitherRow();
 
    GPU.killQuadPart = 0;
+
+   memset(GPU.band_rows, 0xFF, sizeof(GPU.band_rows));
 }
 
 void GPU_RecalcClockRatio(void) {
@@ -702,6 +1639,7 @@ void GPU_RecalcClockRatio(void) {
 
 void GPU_Destroy(void)
 {
+   Raster_Stop();
    delete [] GPU.vram;
 }
 
@@ -715,6 +1653,8 @@ void GPU_Destroy(void)
  */
 void GPU_Rescale(uint8 ushift)
 {
+   Raster_Pull();
+
    if (GPU.upscale_shift == 0) 
    {
       /* VRAM is already at 1x, make the buffer point to the old VRAM
@@ -758,6 +1698,10 @@ void GPU_Rescale(uint8 ushift)
    if (vram_new)
       delete [] vram_new;
    vram_new = NULL;
+
+   MarkDirty(&GPU, 0, 0, 1024, 512);
+
+   Raster_Push();
 }
 
 void GPU_FillVideoParams(MDFNGI* gi)
@@ -805,6 +1749,8 @@ void GPU_FillVideoParams(MDFNGI* gi)
 
 void GPU_SoftReset(void) // Control command 0x00
 {
+   Raster_Sync();
+
    GPU.IRQPending = false;
    IRQ_Assert(IRQ_GPU, GPU.IRQPending);
 
@@ -869,11 +1815,16 @@ void GPU_SoftReset(void) // Control command 0x00
 
    GPU.TexDisable = false;
    GPU.TexDisableAllowChange = false;
+
+   Raster_Push();
 }
 
 void GPU_Power(void)
 {
+   Raster_Sync();
+
    memset(GPU.vram, 0, 512 * 1024 * UPSCALE(&GPU) * UPSCALE(&GPU) * sizeof(*GPU.vram));
+   MarkDirty(&GPU, 0, 0, 1024, 512);
 
    memset(GPU.CLUT_Cache, 0, sizeof(GPU.CLUT_Cache));
    GPU.CLUT_Cache_VB = ~0U;
@@ -985,7 +1936,8 @@ static void ProcessFIFO(uint32_t in_count)
    uint32_t cc            = GPU.InCmd_CC;
    const CTEntry *command = &Commands[cc];
    bool read_fifo         = false;
-   bool sw                = rsx_intf_has_software_renderer();
+   bool set_tpage         = false;
+   void (*func)(PS_GPU* g, const uint32 *cb) = NULL;
 
    switch (GPU.InCmd)
    {
@@ -993,38 +1945,19 @@ static void ProcessFIFO(uint32_t in_count)
       case INCMD_NONE:
          break;
       case INCMD_FBWRITE:
-         InData = GPU_BlitterFIFO.Read();
-
-         for(i = 0; i < 2; i++)
-         {
-            /* Cannot rely on mask bit if we don't have SW renderer, HW renderer will
-             * perform masking. */
-            bool fetch = false;
-            if (sw)
-                fetch = texel_fetch(&GPU, GPU.FBRW_CurX & 1023, GPU.FBRW_CurY & 511) & GPU.MaskEvalAND;
+         InData = GPU_BlitterFIFO.Read();
 
-            if (!fetch)
-               texel_put(GPU.FBRW_CurX & 1023, GPU.FBRW_CurY & 511, InData | GPU.MaskSetOR);
+         Raster_RecordFBWriteData(InData);
 
-            GPU.FBRW_CurX++;
-            if(GPU.FBRW_CurX == (GPU.FBRW_X + GPU.FBRW_W))
-            {
-               GPU.FBRW_CurX = GPU.FBRW_X;
-               GPU.FBRW_CurY++;
-               if(GPU.FBRW_CurY == (GPU.FBRW_Y + GPU.FBRW_H))
-               {
-                  /* Upload complete, send over to RSX */
-                  rsx_intf_load_image(
-                        GPU.FBRW_X, GPU.FBRW_Y,
-                        GPU.FBRW_W, GPU.FBRW_H,
-                        GPU.vram,
-                        GPU.MaskEvalAND,
-                        GPU.MaskSetOR);
-                  GPU.InCmd = INCMD_NONE;
-                  break;   // Break out of the for() loop.
-               }
-            }
-            InData >>= 16;
+         if (FBWrite_Data(&GPU, InData, !GPU.timing_only))
+         {
+            /* Upload complete, send over to RSX */
+            rsx_intf_load_image(
+                  GPU.FBRW_X, GPU.FBRW_Y,
+                  GPU.FBRW_W, GPU.FBRW_H,
+                  GPU.vram,
+                  GPU.MaskEvalAND,
+                  GPU.MaskSetOR);
          }
          return;
 
@@ -1083,27 +2016,52 @@ static void ProcessFIFO(uint32_t in_count)
       
       /* Don't alter SpriteFlip here. */
       if(cc >= 0x20 && cc <= 0x3F && (cc & 0x4))
+      {
          SetTPage(&GPU, CB[4 + ((cc >> 4) & 0x1)] >> 16);
+         set_tpage = true;
+      }
    }
 
    if ((cc >= 0x80) && (cc <= 0x9F))
-      Command_FBCopy(&GPU, CB);
+      func = Command_FBCopy;
    else if ((cc >= 0xA0) && (cc <= 0xBF))
-      Command_FBWrite(&GPU, CB);
+      func = Command_FBWrite;
    else if ((cc >= 0xC0) && (cc <= 0xDF))
-      Command_FBRead(&GPU, CB);
-   else
+      func = Command_FBRead;
+   else if (command->func[GPU.abr][GPU.TexMode])
+      func = command->func[GPU.abr][GPU.TexMode | (GPU.MaskEvalAND ? 0x4 : 0x0)];
+
+   if (!func)
+      return;
+
+   PSX_PROFILE_SCOPE(PSX_Profile_GP0Section(cc));
+
+   Raster_RecordCommand(cc, CB, command_len, func, set_tpage);
+
+#ifdef GPU_REPLAY
+   if(gpu_replay_stats)
    {
-      if (command->func[GPU.abr][GPU.TexMode])
-         command->func[GPU.abr][GPU.TexMode | (GPU.MaskEvalAND ? 0x4 : 0x0)](&GPU, CB);
+      uint64 start = PSX_Profile_Clock();
+      func(&GPU, CB);
+      GPU_Replay_CountCommand(cc, PSX_Profile_Clock() - start);
    }
+   else
+      func(&GPU, CB);
+#else
+   func(&GPU, CB);
+#endif
 }
 
-static INLINE void GPU_WriteCB(uint32_t InData, uint32_t addr)
+static INLINE bool FIFOHasRoom(void)
 {
-   if(GPU_BlitterFIFO.in_count >= 0x10
+   return !(GPU_BlitterFIFO.in_count >= 0x10
       && (GPU.InCmd != INCMD_NONE || 
-      (GPU_BlitterFIFO.in_count - 0x10) >= Commands[GPU_BlitterFIFO.Peek() >> 24].fifo_fb_len))
+      (GPU_BlitterFIFO.in_count - 0x10) >= Commands[GPU_BlitterFIFO.Peek() >> 24].fifo_fb_len));
+}
+
+static INLINE void GPU_WriteCB(uint32_t InData, uint32_t addr)
+{
+   if(!FIFOHasRoom())
    {
       PSX_DBG(PSX_DBG_WARNING, "GPU FIFO overflow!!!\n");
       return;
@@ -1121,6 +2079,11 @@ void GPU_Write(const int32_t timestamp, uint32_t A, uint32_t V)
 {
    V <<= (A & 3) * 8;
 
+#ifdef GPU_REPLAY
+   if(gpu_capture_active)
+      GPU_Capture_Write((A & 4) ? GPU_STREAM_GP1 : GPU_STREAM_GP0, timestamp, V);
+#endif
+
    if(A & 4)   // GP1 ("Control")
    {
       uint32_t command = V >> 24;
@@ -1253,6 +2216,10 @@ void GPU_Write(const int32_t timestamp, uint32_t A, uint32_t V)
 
 void GPU_WriteDMA(uint32_t V, uint32 addr)
 {
+#ifdef GPU_REPLAY
+   if(gpu_capture_active)
+      GPU_Capture_Write(GPU_STREAM_DMA, GPU.lastts, V);
+#endif
    GPU_WriteCB(V, addr);
 }
 
@@ -1362,9 +2329,480 @@ uint32_t GPU_Read(const int32_t timestamp, uint32_t A)
    return(ret >> ((A & 3) * 8));
 }
 
-static INLINE void ReorderRGB_Var(uint32_t out_Rshift,
-      uint32_t out_Gshift, uint32_t out_Bshift,
-      bool bpp24, const uint16_t *src, uint32_t *dest,
+// Upscaled columns of the picture scanout writes, see GPU_set_scanout_window().
+static uint32 scanout_x0 = 0;
+static uint32 scanout_x1 = 0xFFFFFFFF;
+
+// Start of a surface line, in whatever format the surface is.
+static INLINE uint32_t *SurfaceLine(const MDFN_Surface *surface, int32 y)
+{
+   return (uint32_t *)((uint8_t *)surface->pixels + y * surface->pitchinpix * (surface->format.bpp / 8));
+}
+
+// How an output line was scanned out.
+struct scanout_key
+{
+   uint32 src_y;
+   int32 fb_x, dx_start, dx_end, width;
+   uint32 mode;   // 24bpp, upscale shift and surface bpp
+   uint32 x0, x1; // Scanout window
+};
+
+// Per native output line: what it showed, and the surface line it was
+// written to (NULL if that can't be reused). A line showing the same as
+// before, with no VRAM writes to its source since, is left as it is.
+static struct
+{
+   scanout_key key;
+   const void *dest;
+} scanout_lines[1024];
+
+static INLINE bool ScanoutLineCached(const MDFN_Surface *surface, int32 dest_line)
+{
+   const int32 top = dest_line << GPU.upscale_shift;
+
+   return top < surface->h
+      && scanout_lines[dest_line & 1023].dest == SurfaceLine(surface, top);
+}
+
+template<typename T> static INLINE T ScanoutPixel(uint32_t color);
+template<> INLINE uint32_t ScanoutPixel<uint32_t>(uint32_t color) { return color; }
+template<> INLINE uint16_t ScanoutPixel<uint16_t>(uint32_t color) { return COLOR_TO_RGB565(color); }
+
+#ifdef GPU_SIMD_X86_DISPATCH
+// Set by GPU_Init() from what the CPU supports.
+static bool scanout_ssse3 = false;
+static bool scanout_avx2 = false;
+
+static void Scanout_InitKernels(void)
+{
+   scanout_ssse3 = __builtin_cpu_supports("ssse3");
+   scanout_avx2  = __builtin_cpu_supports("avx2");
+}
+
+// AVX2 versions of the vector loop in ReorderRGB15_Run, 16 pixels at a
+// time. They return how many pixels they converted.
+GPU_SIMD_TARGET_AVX2
+static int32 ReorderRGB15_AVX2(const uint16_t *src, uint16_t *dest, int32 count)
+{
+   int32 x;
+
+   for(x = 0; x + 16 <= count; x += 16)
+   {
+      const __m256i pix = _mm256_loadu_si256((const __m256i *)(src + x));
+
+      _mm256_storeu_si256((__m256i *)(dest + x), _mm256_or_si256(_mm256_or_si256(
+                  _mm256_slli_epi16(pix, 11),
+                  _mm256_and_si256(_mm256_slli_epi16(pix, 1), _mm256_set1_epi16(0x07C0))),
+               _mm256_and_si256(_mm256_srli_epi16(pix, 10), _mm256_set1_epi16(0x001F))));
+   }
+
+   return x;
+}
+
+GPU_SIMD_TARGET_AVX2
+static int32 ReorderRGB15_AVX2(const uint16_t *src, uint32_t *dest, int32 count)
+{
+   int32 x;
+
+   for(x = 0; x + 16 <= count; x += 16)
+   {
+      const __m256i pix = _mm256_loadu_si256((const __m256i *)(src + x));
+      const __m256i lo  = _mm256_or_si256(
+            _mm256_and_si256(_mm256_srli_epi16(pix, 7), _mm256_set1_epi16(0x00F8)),
+            _mm256_and_si256(_mm256_slli_epi16(pix, 6), _mm256_set1_epi16((short)0xF800)));
+      const __m256i hi  = _mm256_and_si256(_mm256_slli_epi16(pix, 3), _mm256_set1_epi16(0x00F8));
+      // The unpacks work within 128-bit halves, put the quarters back in order.
+      const __m256i a   = _mm256_unpacklo_epi16(lo, hi);
+      const __m256i b   = _mm256_unpackhi_epi16(lo, hi);
+
+      _mm256_storeu_si256((__m256i *)(dest + x) + 0, _mm256_permute2x128_si256(a, b, 0x20));
+      _mm256_storeu_si256((__m256i *)(dest + x) + 1, _mm256_permute2x128_si256(a, b, 0x31));
+   }
+
+   return x;
+}
+#endif
+
+// 24bpp scanout works on runs of whole pixels, packed first into native
+// RGB byte order, three bytes a pixel.
+#define SCANOUT24_CHUNK 64
+
+#ifdef GPU_SIMD_X86_DISPATCH
+// Stores 4 XRGB8888 pixels, each upscale times.
+GPU_SIMD_TARGET_SSSE3
+static INLINE void Scanout24_Store4(uint32_t *dest, __m128i v, unsigned upscale)
+{
+   __m128i *p = (__m128i *)dest;
+   unsigned i, n = upscale >> 2;
+
+   switch(upscale)
+   {
+      case 1:
+         _mm_storeu_si128(p, v);
+         break;
+      case 2:
+         _mm_storeu_si128(p + 0, _mm_unpacklo_epi32(v, v));
+         _mm_storeu_si128(p + 1, _mm_unpackhi_epi32(v, v));
+         break;
+      default:
+         for(i = 0; i < n; i++)
+         {
+            _mm_storeu_si128(p + 0 * n + i, _mm_shuffle_epi32(v, 0x00));
+            _mm_storeu_si128(p + 1 * n + i, _mm_shuffle_epi32(v, 0x55));
+            _mm_storeu_si128(p + 2 * n + i, _mm_shuffle_epi32(v, 0xAA));
+            _mm_storeu_si128(p + 3 * n + i, _mm_shuffle_epi32(v, 0xFF));
+         }
+         break;
+   }
+}
+
+// Stores 4 XRGB8888 pixels as RGB565, each upscale times.
+GPU_SIMD_TARGET_SSSE3
+static INLINE void Scanout24_Store4(uint16_t *dest, __m128i v, unsigned upscale)
+{
+   __m128i *p = (__m128i *)dest;
+   unsigned i, n = upscale >> 3;
+   __m128i w, d, q0, q1;
+
+   v = _mm_or_si128(_mm_or_si128(
+            _mm_and_si128(_mm_srli_epi32(v, 8), _mm_set1_epi32(0xF800)),
+            _mm_and_si128(_mm_srli_epi32(v, 5), _mm_set1_epi32(0x07E0))),
+         _mm_and_si128(_mm_srli_epi32(v, 3), _mm_set1_epi32(0x001F)));
+   // The four pixels in the low 64 bits.
+   w = _mm_shuffle_epi8(v, _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -128, -128, -128, -128, -128, -128, -128, -128));
+   d = _mm_unpacklo_epi16(w, w);
+
+   switch(upscale)
+   {
+      case 1:
+         _mm_storel_epi64(p, w);
+         break;
+      case 2:
+         _mm_storeu_si128(p, d);
+         break;
+      case 4:
+         _mm_storeu_si128(p + 0, _mm_unpacklo_epi32(d, d));
+         _mm_storeu_si128(p + 1, _mm_unpackhi_epi32(d, d));
+         break;
+      default:
+         q0 = _mm_unpacklo_epi32(d, d);
+         q1 = _mm_unpackhi_epi32(d, d);
+
+         for(i = 0; i < n; i++)
+         {
+            _mm_storeu_si128(p + 0 * n + i, _mm_unpacklo_epi64(q0, q0));
+            _mm_storeu_si128(p + 1 * n + i, _mm_unpackhi_epi64(q0, q0));
+            _mm_storeu_si128(p + 2 * n + i, _mm_unpacklo_epi64(q1, q1));
+            _mm_storeu_si128(p + 3 * n + i, _mm_unpackhi_epi64(q1, q1));
+         }
+         break;
+   }
+}
+
+// Unpacks count packed pixels, count being a multiple of 4, 4 at a time.
+// Reads up to 4 bytes past the last pixel.
+template<typename T>
+GPU_SIMD_TARGET_SSSE3
+static void Scanout24_SSSE3(const uint8_t *bytes, T *dest, int32 count, unsigned upscale)
+{
+   // R, G and B bytes into XRGB8888 lanes.
+   const __m128i shuf = _mm_setr_epi8(2, 1, 0, -128, 5, 4, 3, -128, 8, 7, 6, -128, 11, 10, 9, -128);
+   int32 i;
+
+   for(i = 0; i < count; i += 4)
+      Scanout24_Store4(dest + i * upscale,
+            _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(bytes + i * 3)), shuf), upscale);
+}
+
+// Same as Scanout24_SSSE3, 8 pixels at a time, count being a multiple of 8.
+GPU_SIMD_TARGET_AVX2
+static void Scanout24_AVX2(const uint8_t *bytes, uint32_t *dest, int32 count, unsigned upscale)
+{
+   const __m256i shuf = _mm256_setr_epi8(2, 1, 0, -128, 5, 4, 3, -128, 8, 7, 6, -128, 11, 10, 9, -128,
+         2, 1, 0, -128, 5, 4, 3, -128, 8, 7, 6, -128, 11, 10, 9, -128);
+   int32 i;
+   unsigned k, n = upscale >> 3;
+
+   for(i = 0; i < count; i += 8, bytes += 24, dest += 8 * upscale)
+   {
+      const __m256i v = _mm256_shuffle_epi8(_mm256_inserti128_si256(
+               _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)bytes)),
+               _mm_loadu_si128((const __m128i *)(bytes + 12)), 1), shuf);
+      __m256i *p = (__m256i *)dest;
+
+      if(upscale == 1)
+         _mm256_storeu_si256(p, v);
+      else if(upscale < 8)
+      {
+         Scanout24_Store4(dest, _mm256_castsi256_si128(v), upscale);
+         Scanout24_Store4(dest + 4 * upscale, _mm256_extracti128_si256(v, 1), upscale);
+      }
+      else
+      {
+         const __m128i lo = _mm256_castsi256_si128(v);
+         const __m128i hi = _mm256_extracti128_si256(v, 1);
+
+         for(k = 0; k < n; k++)
+         {
+            _mm256_storeu_si256(p + 0 * n + k, _mm256_broadcastd_epi32(lo));
+            _mm256_storeu_si256(p + 1 * n + k, _mm256_broadcastd_epi32(_mm_srli_si128(lo, 4)));
+            _mm256_storeu_si256(p + 2 * n + k, _mm256_broadcastd_epi32(_mm_srli_si128(lo, 8)));
+            _mm256_storeu_si256(p + 3 * n + k, _mm256_broadcastd_epi32(_mm_srli_si128(lo, 12)));
+            _mm256_storeu_si256(p + 4 * n + k, _mm256_broadcastd_epi32(hi));
+            _mm256_storeu_si256(p + 5 * n + k, _mm256_broadcastd_epi32(_mm_srli_si128(hi, 4)));
+            _mm256_storeu_si256(p + 6 * n + k, _mm256_broadcastd_epi32(_mm_srli_si128(hi, 8)));
+            _mm256_storeu_si256(p + 7 * n + k, _mm256_broadcastd_epi32(_mm_srli_si128(hi, 12)));
+         }
+      }
+   }
+}
+
+GPU_SIMD_TARGET_AVX2
+static void Scanout24_AVX2(const uint8_t *bytes, uint16_t *dest, int32 count, unsigned upscale)
+{
+   const __m256i shuf = _mm256_setr_epi8(2, 1, 0, -128, 5, 4, 3, -128, 8, 7, 6, -128, 11, 10, 9, -128,
+         2, 1, 0, -128, 5, 4, 3, -128, 8, 7, 6, -128, 11, 10, 9, -128);
+   const __m256i pack = _mm256_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -128, -128, -128, -128, -128, -128, -128, -128,
+         0, 1, 4, 5, 8, 9, 12, 13, -128, -128, -128, -128, -128, -128, -128, -128);
+   int32 i;
+
+   for(i = 0; i < count; i += 8, bytes += 24, dest += 8 * upscale)
+   {
+      __m256i v = _mm256_shuffle_epi8(_mm256_inserti128_si256(
+               _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)bytes)),
+               _mm_loadu_si128((const __m128i *)(bytes + 12)), 1), shuf);
+
+      if(upscale == 1)
+      {
+         v = _mm256_or_si256(_mm256_or_si256(
+                  _mm256_and_si256(_mm256_srli_epi32(v, 8), _mm256_set1_epi32(0xF800)),
+                  _mm256_and_si256(_mm256_srli_epi32(v, 5), _mm256_set1_epi32(0x07E0))),
+               _mm256_and_si256(_mm256_srli_epi32(v, 3), _mm256_set1_epi32(0x001F)));
+         // Each half packs into its low 64 bits, then the two are joined.
+         v = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, pack), 0x08);
+         _mm_storeu_si128((__m128i *)dest, _mm256_castsi256_si128(v));
+      }
+      else
+      {
+         Scanout24_Store4(dest, _mm256_castsi256_si128(v), upscale);
+         Scanout24_Store4(dest + 4 * upscale, _mm256_extracti128_si256(v, 1), upscale);
+      }
+   }
+}
+#elif defined(GPU_SIMD_NEON) && !defined(MSB_FIRST)
+// Stores 4 XRGB8888 pixels, each upscale times.
+static INLINE void Scanout24_Store4(uint32_t *dest, uint32x4_t v, unsigned upscale)
+{
+   uint32_t c[4];
+   unsigned i, j;
+
+   switch(upscale)
+   {
+      case 1:
+         vst1q_u32(dest, v);
+         break;
+      case 2:
+         vst1q_u32(dest + 0, vzipq_u32(v, v).val[0]);
+         vst1q_u32(dest + 4, vzipq_u32(v, v).val[1]);
+         break;
+      default:
+         vst1q_u32(c, v);
+
+         for(j = 0; j < 4; j++)
+            for(i = 0; i < upscale; i += 4)
+               vst1q_u32(dest + j * upscale + i, vdupq_n_u32(c[j]));
+         break;
+   }
+}
+
+// Stores 8 RGB565 pixels, each upscale times.
+static INLINE void Scanout24_Store8(uint16_t *dest, uint16x8_t v, unsigned upscale)
+{
+   uint16_t c[8];
+   uint16x8x2_t d, q0, q1;
+   unsigned i, j;
+
+   switch(upscale)
+   {
+      case 1:
+         vst1q_u16(dest, v);
+         break;
+      case 2:
+         d = vzipq_u16(v, v);
+         vst1q_u16(dest + 0, d.val[0]);
+         vst1q_u16(dest + 8, d.val[1]);
+         break;
+      case 4:
+         d  = vzipq_u16(v, v);
+         q0 = vzipq_u16(d.val[0], d.val[0]);
+         q1 = vzipq_u16(d.val[1], d.val[1]);
+         vst1q_u16(dest + 0,  q0.val[0]);
+         vst1q_u16(dest + 8,  q0.val[1]);
+         vst1q_u16(dest + 16, q1.val[0]);
+         vst1q_u16(dest + 24, q1.val[1]);
+         break;
+      default:
+         vst1q_u16(c, v);
+
+         for(j = 0; j < 8; j++)
+            for(i = 0; i < upscale; i += 8)
+               vst1q_u16(dest + j * upscale + i, vdupq_n_u16(c[j]));
+         break;
+   }
+}
+
+// Unpacks count packed pixels, count being a multiple of 8, 8 at a time.
+static void Scanout24_NEON(const uint8_t *bytes, uint32_t *dest, int32 count, unsigned upscale)
+{
+   int32 i;
+
+   for(i = 0; i < count; i += 8, bytes += 24, dest += 8 * upscale)
+   {
+      const uint8x8x3_t c   = vld3_u8(bytes);
+      const uint8x8x2_t bg  = vzip_u8(c.val[2], c.val[1]);
+      const uint16x8x2_t px = vzipq_u16(vreinterpretq_u16_u8(vcombine_u8(bg.val[0], bg.val[1])), vmovl_u8(c.val[0]));
+
+      Scanout24_Store4(dest, vreinterpretq_u32_u16(px.val[0]), upscale);
+      Scanout24_Store4(dest + 4 * upscale, vreinterpretq_u32_u16(px.val[1]), upscale);
+   }
+}
+
+static void Scanout24_NEON(const uint8_t *bytes, uint16_t *dest, int32 count, unsigned upscale)
+{
+   int32 i;
+
+   for(i = 0; i < count; i += 8, bytes += 24, dest += 8 * upscale)
+   {
+      const uint8x8x3_t c = vld3_u8(bytes);
+
+      Scanout24_Store8(dest, vorrq_u16(vorrq_u16(
+                  vshlq_n_u16(vmovl_u8(vshr_n_u8(c.val[0], 3)), 11),
+                  vshlq_n_u16(vmovl_u8(vshr_n_u8(c.val[1], 2)), 5)),
+               vmovl_u8(vshr_n_u8(c.val[2], 3))), upscale);
+   }
+}
+#endif
+
+#if defined(GPU_SIMD_X86_DISPATCH) || (defined(GPU_SIMD_NEON) && !defined(MSB_FIRST))
+#define HAVE_SCANOUT24_VEC
+
+// Converts whole 24bpp pixels from dest + x on with the vector kernels, as
+// far as dx_end or the end of the VRAM row. Returns the x it got to and
+// moves fb_x along; the scalar loop does the rest.
+template<typename T>
+static int32 ReorderRGB24_Vec(const uint16_t *src, T *dest, int32 x, int32 dx_end,
+      int32 &fb_x, unsigned upscale_shift, unsigned upscale)
+{
+   const int32 fb_mask = ((0x7FF << upscale_shift) + upscale - 1);
+   // Upscaled VRAM columns read for pixels starting on an even native
+   // byte and on an odd one, as the scalar loop reads them.
+   const uint16_t *even = src + ((fb_x & (upscale - 1)) >> 1);
+   const uint16_t *odd  = even + ((1 << upscale_shift) >> 1);
+   uint16_t packed[SCANOUT24_CHUNK * 3 / 2 + 2];
+   int32 step, n, h, i;
+
+#ifdef GPU_SIMD_X86_DISPATCH
+   if(!scanout_ssse3)
+      return x;
+   step = scanout_avx2 ? 8 : 4;
+#else
+   step = 8;
+#endif
+
+   // Every other pixel starts on an odd byte; the packing below starts
+   // with an even one, the caller converts the odd one.
+   if((fb_x >> upscale_shift) & 1)
+      return x;
+
+   for(;;)
+   {
+      // Whole pixels left, and those before the row wraps around.
+      n = std::min<int32>((dx_end - x) >> upscale_shift, (2047 - (fb_x >> upscale_shift)) / 3 + 1);
+      n = std::min<int32>(n, SCANOUT24_CHUNK) & ~(step - 1);
+
+      if(n <= 0)
+         break;
+
+      // Pixels two at a time, six bytes from halfwords h to h + 2.
+      h = fb_x >> (upscale_shift + 1);
+      for(i = 0; i < n / 2; i++, h += 3)
+      {
+         packed[i * 3 + 0] = even[h << upscale_shift];
+         packed[i * 3 + 1] = (even[(h + 1) << upscale_shift] & 0x00FF) | (odd[(h + 1) << upscale_shift] & 0xFF00);
+         packed[i * 3 + 2] = odd[(h + 2) << upscale_shift];
+      }
+      packed[i * 3 + 0] = 0;
+      packed[i * 3 + 1] = 0;
+
+#ifdef GPU_SIMD_X86_DISPATCH
+      if(scanout_avx2)
+         Scanout24_AVX2((const uint8_t *)packed, dest + x, n, upscale);
+      else
+         Scanout24_SSSE3((const uint8_t *)packed, dest + x, n, upscale);
+#else
+      Scanout24_NEON((const uint8_t *)packed, dest + x, n, upscale);
+#endif
+
+      x   += n << upscale_shift;
+      fb_x = (fb_x + n * (3 << upscale_shift)) & fb_mask;
+   }
+
+   return x;
+}
+#endif
+
+// Converts count 15bpp pixels that don't wrap around the VRAM row.
+template<typename T>
+static INLINE void ReorderRGB15_Run(const uint16_t *src, T *dest, int32 count)
+{
+   int32 x = 0;
+
+#if defined(GPU_SIMD_X86_DISPATCH) && defined(GPU_SIMD_SSE2)
+   if(scanout_avx2)
+      x = ReorderRGB15_AVX2(src, dest, count);
+#endif
+
+#if defined(HAVE_GPU_SIMD) && !defined(MSB_FIRST)
+   for(; x + GPU_SIMD_LANES <= count; x += GPU_SIMD_LANES)
+   {
+      const span_vec pix = span_load(src + x);
+
+      if(sizeof(T) == 2)
+      {
+         // RGB565, green's low bit stays clear.
+         span_store((uint16 *)dest + x, span_or(span_or(
+                     span_sll(pix, 11),
+                     span_and(span_sll(pix, 1), span_set1(0x07C0))),
+                  span_and(span_srl(pix, 10), span_set1(0x001F))));
+      }
+      else
+      {
+         // Blue in the low byte, green in the high byte...
+         const span_vec lo = span_or(
+               span_and(span_srl(pix, 7), span_set1(0x00F8)),
+               span_and(span_sll(pix, 6), span_set1(0xF800)));
+         // ...and red in the low byte of the upper half.
+         const span_vec hi = span_and(span_sll(pix, 3), span_set1(0x00F8));
+
+         span_store32((uint32 *)dest + x, lo, hi);
+      }
+   }
+#endif
+
+   for(; x < count; x++)
+   {
+      uint32_t srcpix = src[x];
+      dest[x] = ScanoutPixel<T>(MAKECOLOR(
+               (((srcpix >> 0) & 0x1F) << 3),
+               (((srcpix >> 5) & 0x1F) << 3),
+               (((srcpix >> 10) & 0x1F) << 3),
+               0));
+   }
+}
+
+template<typename T>
+static INLINE void ReorderRGB_Var(bool bpp24, const uint16_t *src, T *dest,
       const int32 dx_start, const int32 dx_end, int32 fb_x,
       unsigned upscale_shift, unsigned upscale)
 {
@@ -1374,7 +2812,14 @@ static INLINE void ReorderRGB_Var(uint32_t out_Rshift,
    {
       for(int32 x = dx_start; x < dx_end; x+= upscale)
       {
-         int i;
+#ifdef HAVE_SCANOUT24_VEC
+         // Pixels the vector kernels can't take, at an odd start, the row
+         // wrap and the end, go through the scalar code below.
+         x = ReorderRGB24_Vec(src, dest, x, dx_end, fb_x, upscale_shift, upscale);
+         if(x >= dx_end)
+            break;
+#endif
+
          uint32_t color;
          uint32_t srcpix = src[(fb_x >> 1) + 0]
             | (src[((fb_x >> 1) + (1 << upscale_shift)) & fb_mask] << 16);
@@ -1384,30 +2829,81 @@ static INLINE void ReorderRGB_Var(uint32_t out_Rshift,
             | (((srcpix >> 8) << GREEN_SHIFT) & (0xFF << GREEN_SHIFT))
             | (((srcpix >> 16) << BLUE_SHIFT) & (0xFF << BLUE_SHIFT));
 
-         for (i = 0; i < upscale; i++)
-            dest[x + i] = color;
+#ifdef HAVE_GPU_SIMD
+         if (sizeof(T) == 4 && upscale >= 4)
+            span_fill32((uint32 *)dest + x, color, upscale);
+         else
+#endif
+         {
+            unsigned i;
+
+            for (i = 0; i < upscale; i++)
+               dest[x + i] = ScanoutPixel<T>(color);
+         }
 
          fb_x = (fb_x + (3 << upscale_shift)) & fb_mask;
       }
    }           // 15bpp
    else
    {
-      for(int32 x = dx_start; x < dx_end; x++)
+      // Source pixels are contiguous up to the end of the VRAM row, where
+      // fb_x wraps around to its start.
+      const int32 row_pixels = 1024 << upscale_shift;
+      int32 x = dx_start;
+
+      while(x < dx_end)
       {
-         uint32_t srcpix = src[(fb_x >> 1)];
-         dest[x] = MAKECOLOR(
-               (((srcpix >> 0) & 0x1F) << 3),
-               (((srcpix >> 5) & 0x1F) << 3),
-               (((srcpix >> 10) & 0x1F) << 3),
-               0);
+         const int32 src_x = fb_x >> 1;
+         int32 count       = dx_end - x;
 
-         fb_x = (fb_x + 2) & fb_mask;
+         if(count > row_pixels - src_x)
+            count = row_pixels - src_x;
+
+         ReorderRGB15_Run(src + src_x, dest + x, count);
+
+         x   += count;
+         fb_x = (fb_x + count * 2) & fb_mask;
       }
    }
 }
 
+// Writes upscaled columns [0, width) of a line, the picture between dx_start
+// and dx_end and black around it, clipped to the scanout window.
+template<typename T>
+static void ScanoutRow(bool bpp24, const uint16_t *src, T *dest,
+      int32 dx_start, int32 dx_end, int32 width, int32 fb_x,
+      unsigned upscale_shift, unsigned upscale)
+{
+   const int32 x0 = scanout_x0;
+   const int32 x1 = std::min<uint32>(width, scanout_x1);
+
+   if(x0 >= x1)
+      return;
+
+   // Window columns from here on.
+   dx_start -= x0;
+   dx_end   -= x0;
+   width     = x1 - x0;
+
+   if(dx_start < 0)
+   {
+      int32_t fb_mask = ((0x7FF << upscale_shift) + upscale - 1);
+
+      fb_x     = (fb_x - dx_start * (bpp24 ? 3 : 2)) & fb_mask;
+      dx_start = 0;
+   }
+
+   dx_start = std::min(dx_start, width);
+   dx_end   = std::max(dx_start, std::min(dx_end, width));
+
+   memset(dest, 0, dx_start * sizeof(T));
+   ReorderRGB_Var(bpp24, src, dest, dx_start, dx_end, fb_x, upscale_shift, upscale);
+   memset(dest + dx_end, 0, (width - dx_end) * sizeof(T));
+}
+
 int32_t GPU_Update(const int32_t sys_timestamp)
 {
+   PSX_PROFILE_SCOPE(PSX_PROF_GPU);
    int32 gpu_clocks;
    static const uint32_t DotClockRatios[5] = { 10, 8, 5, 4, 7 };
    const uint32_t dmc = (GPU.DisplayMode & 0x40) ? 4 : (GPU.DisplayMode & 0x3);
@@ -1558,13 +3054,16 @@ int32_t GPU_Update(const int32_t sys_timestamp)
                      GPU.DisplayRect->w = 384;
                      GPU.DisplayRect->h = VisibleLineCount;
 
+                     GPU_invalidate_scanout();
+                     GPU.display_dirty = true;
+
                      for(int32 y = 0; y < GPU.DisplayRect->h; y++)
                      {
-                        uint32_t *dest = GPU.surface->pixels + y * GPU.surface->pitch32;
-
                         GPU.LineWidths[y] = 384;
 
-                        memset(dest, 0, 384 * sizeof(int32));
+                        if(y < GPU.surface->h)
+                           memset(SurfaceLine(GPU.surface, y), 0,
+                                 std::min<int32>(384, GPU.surface->w) * (GPU.surface->format.bpp / 8));
                      }
 
                      //char buffer[256];
@@ -1587,8 +3086,13 @@ int32_t GPU_Update(const int32_t sys_timestamp)
 
                      for(int i = 0; i < (GPU.DisplayRect->y + GPU.DisplayRect->h); i++)
                      {
-                        GPU.surface->pixels[i * GPU.surface->pitch32 + 0] =
-                           GPU.surface->pixels[i * GPU.surface->pitch32 + 1] = 0;
+                        // Lines kept from the previous frame are left whole.
+                        if(i < GPU.surface->h
+                              && !ScanoutLineCached(GPU.surface, i >> GPU.upscale_shift))
+                        {
+                           GPU.surface->format.WritePixel(SurfaceLine(GPU.surface, i), 0, 0);
+                           GPU.surface->format.WritePixel(SurfaceLine(GPU.surface, i), 1, 0);
+                        }
                         GPU.LineWidths[i] = 2;
                      }
                   }
@@ -1705,50 +3209,80 @@ int32_t GPU_Update(const int32_t sys_timestamp)
 
                if (rsx_intf_is_type() == RSX_SOFTWARE)
                {
+                  const bool rgb24   = GPU.DisplayMode & DISP_RGB24;
+                  const uint32 src_y = GPU.DisplayFB_CurLineYReadout;
+                  const int32 top    = dest_line << GPU.upscale_shift;
+                  scanout_key key;
+                  uint64 src_mask    = 0;
+                  bool changed;
+
                   // Convert the necessary variables to the upscaled version
-                  uint32_t x;
-                  uint32_t y        = GPU.DisplayFB_CurLineYReadout << GPU.upscale_shift;
+                  uint32_t y        = src_y << GPU.upscale_shift;
                   uint32_t udmw     = dmw      << GPU.upscale_shift;
                   int32 udx_start   = dx_start << GPU.upscale_shift;
                   int32 udx_end     = dx_end   << GPU.upscale_shift;
                   int32 ufb_x       = fb_x     << GPU.upscale_shift;
                   unsigned _upscale = UPSCALE(&GPU);
 
-                  for (uint32_t i = 0; i < _upscale; i++)
+                  // VRAM pixels the line reads, rounded outwards.
+                  if(dx_end > dx_start)
+                     src_mask = DirtySpan(fb_x >> 1, ((dx_end - dx_start) * (rgb24 ? 3 : 2) + 3) >> 1);
+
+                  memset(&key, 0, sizeof(key));
+                  key.src_y    = src_y;
+                  key.fb_x     = fb_x;
+                  key.dx_start = dx_start;
+                  key.dx_end   = dx_end;
+                  key.width    = dmw;
+                  key.mode     = rgb24 | (GPU.upscale_shift << 1) | (GPU.surface->format.bpp << 8);
+                  key.x0       = scanout_x0;
+                  key.x1       = scanout_x1;
+
+                  // Interlaced fields are woven together by the
+                  // deinterlacer, which writes over the surface.
+                  changed = GPU.espec->InterlaceOn
+                     || (vram_dirty[src_y] & src_mask)
+                     || memcmp(&key, &scanout_lines[dest_line & 1023].key, sizeof(key));
+
+                  vram_dirty[src_y] &= ~src_mask;
+                  GPU.display_dirty |= changed;
+
+                  if(changed || !ScanoutLineCached(GPU.surface, dest_line))
                   {
-                     const uint16_t *src = GPU.vram +
-                        ((y + i) << (10 + GPU.upscale_shift));
-
-                     // printf("surface: %dx%d (%d) %u %u + %u\n",
-                     //       surface->w, surface->h, surface->pitchinpix,
-                     //       dest_line, y, i);
-
-                     dest = GPU.surface->pixels +
-                        ((dest_line << GPU.upscale_shift) + i) * GPU.surface->pitch32;
-                     memset(dest, 0, udx_start * sizeof(int32));
-
-                     //printf("%d %d %d - %d %d\n", scanline, dx_start, dx_end, HorizStart, HorizEnd);
-                     ReorderRGB_Var(
-                           RED_SHIFT,
-                           GREEN_SHIFT,
-                           BLUE_SHIFT,
-                           GPU.DisplayMode & DISP_RGB24,
-                           src,
-                           dest,
-                           udx_start,
-                           udx_end,
-                           ufb_x,
-                           GPU.upscale_shift,
-                           _upscale);
-
-                     //printf("dx_end: %d, dmw: %d\n", udx_end, udmw);
-                     //
-                     for(x = udx_end; x < udmw; x++)
-                        dest[x] = 0;
+                     Raster_WaitRow(src_y);
+
+                     for (uint32_t i = 0; i < _upscale; i++)
+                     {
+                        const uint16_t *src = GPU.vram +
+                           ((y + i) << (10 + GPU.upscale_shift));
+                        const int32 row = top + i;
+
+                        if(row >= GPU.surface->h)
+                           break;
+
+                        //printf("%d %d %d - %d %d\n", scanline, dx_start, dx_end, HorizStart, HorizEnd);
+                        if(GPU.surface->format.bpp == 16)
+                           ScanoutRow(rgb24, src,
+                                 GPU.surface->pixels16 + row * GPU.surface->pitchinpix,
+                                 udx_start, udx_end, udmw, ufb_x,
+                                 GPU.upscale_shift, _upscale);
+                        else
+                           ScanoutRow(rgb24, src,
+                                 GPU.surface->pixels + row * GPU.surface->pitchinpix,
+                                 udx_start, udx_end, udmw, ufb_x,
+                                 GPU.upscale_shift, _upscale);
+                     }
                   }
 
-                  //reset dest back to i=0 for PSX_GPULineHook call
-                  dest = GPU.surface->pixels + ((dest_line << GPU.upscale_shift) * GPU.surface->pitch32);
+                  scanout_lines[dest_line & 1023].key  = key;
+                  scanout_lines[dest_line & 1023].dest =
+                     (GPU.espec->InterlaceOn || top >= GPU.surface->h) ? NULL
+                     : SurfaceLine(GPU.surface, top);
+
+                  // Light guns look at and draw over the whole line, which
+                  // a scanout window cuts off.
+                  if(scanout_x0 == 0 && scanout_x1 >= udmw && top < GPU.surface->h)
+                     dest = SurfaceLine(GPU.surface, top);
                }
 
                //if(GPU.scanline == 64)
@@ -1800,6 +3334,9 @@ int32_t GPU_Update(const int32_t sys_timestamp)
 TheEnd:
    GPU.lastts = sys_timestamp;
 
+   // Don't let recorded commands wait for a full batch.
+   Raster_Flush();
+
    int32 next_dt = GPU.LineClockCounter;
 
    next_dt = (((int64)next_dt << 16) - GPU.GPUClockCounter + GPU.GPUClockRatio - 1) / GPU.GPUClockRatio;
@@ -1814,6 +3351,8 @@ TheEnd:
 
 void GPU_StartFrame(EmulateSpecStruct *espec_arg)
 {
+   Raster_Update();
+
    GPU.sl_zero_reached = false;
    GPU.espec           = espec_arg;
    GPU.surface         = GPU.espec->surface;
@@ -1927,6 +3466,8 @@ void GPU_RestoreStateP3(void)
 
 int GPU_StateAction(StateMem *sm, int load, int data_only)
 {
+   Raster_Pull();
+
    GPU_RestoreStateP1(load);
 
    SFORMAT StateRegs[] =
@@ -2055,11 +3596,33 @@ int GPU_StateAction(StateMem *sm, int load, int data_only)
    GPU_RestoreStateP2(load);
 
    if(load)
+   {
       GPU_RestoreStateP3();
+      MarkDirty(&GPU, 0, 0, 1024, 512);
+      Raster_Push();
+   }
 
    return(ret);
 }
 
+bool GPU_get_display_dirty(void)
+{
+   return GPU.display_dirty;
+}
+
+void GPU_set_display_dirty(bool dirty)
+{
+   GPU.display_dirty = dirty;
+}
+
+/* Scanout writes every line again, the surface contents were changed
+ * behind its back. */
+void GPU_invalidate_scanout(void)
+{
+   for(unsigned i = 0; i < 1024; i++)
+      scanout_lines[i].dest = NULL;
+}
+
 bool GPU_get_display_possibly_dirty(void)
 {
    return GPU.display_possibly_dirty;
@@ -2083,6 +3646,7 @@ unsigned GPU_get_display_change_count(void)
 void GPU_set_dither_upscale_shift(uint8 factor)
 {
    GPU.dither_upscale_shift = factor;
+   RecalcDitherRow();
 }
 
 uint8 GPU_get_dither_upscale_shift(void)
@@ -2105,6 +3669,11 @@ bool GPU_DMACanWrite(void)
    return CalcFIFOReadyBit();
 }
 
+bool GPU_FIFOHasRoom(void)
+{
+   return FIFOHasRoom();
+}
+
 uint16 *GPU_get_vram(void)
 {
    return GPU.vram;
@@ -2112,11 +3681,14 @@ uint16 *GPU_get_vram(void)
 
 uint16 GPU_PeekRAM(uint32 A)
 {
+   Raster_Sync();
    return texel_fetch(&GPU, A & 0x3FF, (A >> 10) & 0x1FF);
 }
 
 void GPU_PokeRAM(uint32 A, uint16 V)
 {
+   Raster_Sync();
+   MarkDirty(&GPU, A & 0x3FF, (A >> 10) & 0x1FF, 1, 1);
    texel_put(A & 0x3FF, (A >> 10) & 0x1FF, V);
 }
 
@@ -2147,3 +3719,34 @@ void GPU_set_visible_scanlines(int sls, int sle)
    GPU.LineVisFirst = sls;
    GPU.LineVisLast = sle;
 }
+
+/* Limits scanout to upscaled columns x to x + w - 1 of the picture, which
+ * land in columns 0 to w - 1 of the surface; the rest of each line isn't
+ * written. Lines past the bottom of the surface are always skipped. */
+void GPU_set_scanout_window(unsigned x, unsigned w)
+{
+   scanout_x0 = x;
+   scanout_x1 = x + w;
+}
+
+/* Scanout writes every column again. */
+void GPU_reset_scanout_window(void)
+{
+   scanout_x0 = 0;
+   scanout_x1 = 0xFFFFFFFF;
+}
+
+/* Number of threads to run software rasterization on (0 to draw on the
+ * emulation thread); takes effect at the start of the next frame. */
+void GPU_set_render_threads(unsigned count)
+{
+#ifdef HAVE_THREADS
+   Raster.requested = std::min<unsigned>(count, RASTER_MAX_THREADS);
+#endif
+}
+
+/* Wait for all queued rasterization to land in VRAM. */
+void GPU_Sync(void)
+{
+   Raster_Sync();
+}
@@ -172,6 +172,8 @@ struct PS_GPU
 
    bool display_possibly_dirty;
    unsigned display_change_count;
+   // Software scanout produced a different picture.
+   bool display_dirty;
 
    uint32 HorizStart;
    uint32 HorizEnd;
@@ -205,6 +207,23 @@ struct PS_GPU
 
    int32 DrawTimeAvail;
 
+   // Run commands for their timing and state side effects only, leaving
+   // VRAM alone (the threaded software rasterizer does the drawing).
+   bool timing_only;
+
+   // Record what VRAM is drawn to for scanout (see MarkDirty()). Off in
+   // the rasterizers' copies, which only draw what GPU already recorded.
+   bool track_writes;
+
+   // Native VRAM rows drawn by this instance; the threaded rasterizer
+   // splits them between its threads when there's more than one.
+   uint64 band_rows[8];
+   bool banded;
+   // Banded rasterizers fetch texels straight from VRAM unless this is
+   // set, in which case they keep the texture cache in step with the
+   // emulated one (see Raster_CheckTexCache()).
+   bool texcache_exact;
+
    int32_t lastts;
 
    bool sl_zero_reached;
@@ -218,6 +237,11 @@ struct PS_GPU
 
    uint8_t DitherLUT[4][4][512]; // Y, X, 8-bit source value(256 extra for saturation)
 
+   // Dither offsets along a row at the current dither_upscale_shift, for the
+   // span kernels.  The pattern repeats every (4 << dither_upscale_shift)
+   // pixels and is padded so a full vector can be loaded from any phase.
+   int16 DitherRow[4][64 + 16];
+
    /*
    VRAM has to be a ptr type or else we have to rely on smartcode void* shenanigans to
    wrestle a variable-sized struct.
@@ -235,6 +259,11 @@ uint32_t GPU_ReadDMA(void);
 
 bool GPU_DMACanWrite(void);
 
+// Whether a GP0 write would be accepted rather than dropped as a FIFO
+// overflow.  Unlike GPU_DMACanWrite() this stays true while a polyline is
+// waiting for more vertices.
+bool GPU_FIFOHasRoom(void);
+
 uint8 GPU_get_dither_upscale_shift(void);
 
 void GPU_set_dither_upscale_shift(uint8 factor);
@@ -243,6 +272,12 @@ uint8 GPU_get_upscale_shift(void);
 
 void GPU_set_upscale_shift(uint8 factor);
 
+bool GPU_get_display_dirty(void);
+
+void GPU_set_display_dirty(bool dirty);
+
+void GPU_invalidate_scanout(void);
+
 bool GPU_get_display_possibly_dirty(void);
 
 void GPU_set_display_possibly_dirty(bool dirty);
@@ -288,4 +323,12 @@ void texel_put(uint32 x, uint32 y, uint16 v);
 
 void GPU_set_visible_scanlines(int sls, int sle); // Beetle PSX addition
 
+void GPU_set_render_threads(unsigned count);
+
+void GPU_set_scanout_window(unsigned x, unsigned w);
+
+void GPU_reset_scanout_window(void);
+
+void GPU_Sync(void);
+
 #endif
@@ -126,11 +126,14 @@ static INLINE void Update_CLUT_Cache(PS_GPU *g, uint16 raw_clut)
 
      g->DrawTimeAvail -= count;
 
-     for(unsigned i = 0; i < count; i++)
+     if(!g->timing_only)
+     {
+        for(unsigned i = 0; i < count; i++)
         {
            uint16_t x = (cxo + i) & 0x3FF;
            g->CLUT_Cache[i] = texel_fetch(g, x, y);
         }
+     }
 
    g->CLUT_Cache_VB = new_ccvb;
   }
@@ -195,34 +198,40 @@ static INLINE uint16_t GetTexel(PS_GPU *g, int32_t u_arg, int32_t v_arg)
 
      PS_GPU::TexCache_t *TexCache = &g->TexCache[0];
      PS_GPU::TexCache_t *c = NULL;
+     uint16 fbw;
 
-     switch(TexMode_TA)
+     if(MDFN_UNLIKELY(g->banded && !g->texcache_exact))
+      fbw = texel_fetch(g, fbtex_x, fbtex_y);
+     else
      {
-      case 0: c = &TexCache[((gro >> 2) & 0x3) | ((gro >> 8) & 0xFC)]; break;	// 64x64
-      case 1: c = &TexCache[((gro >> 2) & 0x7) | ((gro >> 7) & 0xF8)]; break;	// 64x32 (NOT 32x64!)
-      case 2: c = &TexCache[((gro >> 2) & 0x7) | ((gro >> 7) & 0xF8)]; break;	// 32x32
+      switch(TexMode_TA)
+      {
+       case 0: c = &TexCache[((gro >> 2) & 0x3) | ((gro >> 8) & 0xFC)]; break;	// 64x64
+       case 1: c = &TexCache[((gro >> 2) & 0x7) | ((gro >> 7) & 0xF8)]; break;	// 64x32 (NOT 32x64!)
+       case 2: c = &TexCache[((gro >> 2) & 0x7) | ((gro >> 7) & 0xF8)]; break;	// 32x32
+      }
+
+      if(MDFN_UNLIKELY(c->Tag != (gro &~ 0x3)))
+      {
+       // SCPH-1001 old revision GPU is like(for sprites at least): (20 + 4)
+       // SCPH-5501 new revision GPU is like(for sprites at least): (12 + 4)
+       //
+       // We'll be conservative and just go with 4 for now, until we can run some tests with triangles too.
+       //
+       g->DrawTimeAvail -= 4;
+
+       uint32_t cache_x= fbtex_x & ~3;
+
+       c->Data[0] = texel_fetch(g, cache_x + 0, fbtex_y);
+       c->Data[1] = texel_fetch(g, cache_x + 1, fbtex_y);
+       c->Data[2] = texel_fetch(g, cache_x + 2, fbtex_y);
+       c->Data[3] = texel_fetch(g, cache_x + 3, fbtex_y);
+       c->Tag = (gro &~ 0x3);
+      }
+
+      fbw = c->Data[gro & 0x3];
      }
 
-     if(MDFN_UNLIKELY(c->Tag != (gro &~ 0x3)))
-     {
-      // SCPH-1001 old revision GPU is like(for sprites at least): (20 + 4)
-      // SCPH-5501 new revision GPU is like(for sprites at least): (12 + 4)
-      //
-      // We'll be conservative and just go with 4 for now, until we can run some tests with triangles too.
-      //
-      g->DrawTimeAvail -= 4;
-
-      uint32_t cache_x= fbtex_x & ~3;
-
-      c->Data[0] = texel_fetch(g, cache_x + 0, fbtex_y);
-      c->Data[1] = texel_fetch(g, cache_x + 1, fbtex_y);
-      c->Data[2] = texel_fetch(g, cache_x + 2, fbtex_y);
-      c->Data[3] = texel_fetch(g, cache_x + 3, fbtex_y);
-      c->Tag = (gro &~ 0x3);
-     }
-
-     uint16 fbw = c->Data[gro & 0x3];
-
      if(TexMode_TA != 2)
      {
       if(TexMode_TA == 0)
@@ -236,6 +245,99 @@ static INLINE uint16_t GetTexel(PS_GPU *g, int32_t u_arg, int32_t v_arg)
      return(fbw);
 }
 
+/* Timing-only counterpart of GetTexel(): charges the texture cache miss
+ * penalty and updates the tag, but doesn't touch VRAM. */
+template<uint32_t TexMode_TA>
+static INLINE void TouchTexel(PS_GPU *g, int32_t u_arg, int32_t v_arg)
+{
+     uint32_t u_ext = ((u_arg & g->SUCV.TWX_AND) + g->SUCV.TWX_ADD);
+     uint32_t fbtex_x = ((u_ext >> (2 - TexMode_TA))) & 1023;
+     uint32_t fbtex_y = (v_arg & g->SUCV.TWY_AND) + g->SUCV.TWY_ADD;
+     uint32_t gro = fbtex_y * 1024U + fbtex_x;
+
+     PS_GPU::TexCache_t *TexCache = &g->TexCache[0];
+     PS_GPU::TexCache_t *c = NULL;
+
+     switch(TexMode_TA)
+     {
+      case 0: c = &TexCache[((gro >> 2) & 0x3) | ((gro >> 8) & 0xFC)]; break;
+      case 1: c = &TexCache[((gro >> 2) & 0x7) | ((gro >> 7) & 0xF8)]; break;
+      case 2: c = &TexCache[((gro >> 2) & 0x7) | ((gro >> 7) & 0xF8)]; break;
+     }
+
+     if(MDFN_UNLIKELY(c->Tag != (gro &~ 0x3)))
+     {
+      g->DrawTimeAvail -= 4;
+      c->Tag = (gro &~ 0x3);
+     }
+}
+
+/* Whether native VRAM row y is drawn by this instance. */
+static INLINE bool BandOwnsLine(PS_GPU *g, unsigned y)
+{
+   y &= 511;
+   return (g->band_rows[y >> 6] >> (y & 63)) & 1;
+}
+
+/* VRAM written since it was last scanned out, one bit per 16 pixels of
+ * each native row. */
+static uint64 vram_dirty[512];
+
+/* Bits of the native row span starting at x, which wraps around. */
+static INLINE uint64 DirtySpan(uint32 x, uint32 w)
+{
+   const uint32 tx0 = (x & 1023) >> 4;
+   const uint32 tx1 = ((x & 1023) + std::min<uint32>(w, 1024) - 1) >> 4;
+
+   if(tx1 < 64)
+      return ((2ULL << tx1) - 1) & ~((1ULL << tx0) - 1);
+
+   return ~((1ULL << tx0) - 1) | ((2ULL << (tx1 - 64)) - 1);
+}
+
+/* Records a write to the native VRAM rectangle, which wraps around. */
+static INLINE void MarkDirty(PS_GPU *g, uint32 x, uint32 y, uint32 w, uint32 h)
+{
+   uint64 mask;
+
+   if(!g->track_writes || !w || !h)
+      return;
+
+   mask = DirtySpan(x, w);
+   h    = std::min<uint32>(h, 512);
+
+   for(uint32 i = 0; i < h; i++)
+      vram_dirty[(y + i) & 511] |= mask;
+}
+
+/* Same for a primitive covering native (x0, y0) to (x1, y1) inclusive,
+ * which only draws inside the drawing area. The rasterizers wrap pixel
+ * coordinates at 11 bits, so the box is also marked where it lands one
+ * wrap (2048 pixels) either way. */
+static INLINE void MarkDrawDirty(PS_GPU *g, int32 x0, int32 y0, int32 x1, int32 y1)
+{
+   if(!g->track_writes)
+      return;
+
+   for(int32 wy = -2048; wy <= 2048; wy += 2048)
+   {
+      const int32 cy0 = std::max<int32>(y0 + wy, g->ClipY0);
+      const int32 cy1 = std::min<int32>(y1 + wy, g->ClipY1);
+
+      if(cy0 > cy1)
+         continue;
+
+      for(int32 wx = -2048; wx <= 2048; wx += 2048)
+      {
+         const int32 cx0 = std::max<int32>(x0 + wx, g->ClipX0);
+         const int32 cx1 = std::min<int32>(x1 + wx, g->ClipX1);
+
+         if(cx0 <= cx1)
+            MarkDirty(g, cx0, cy0, cx1 - cx0 + 1, cy1 - cy0 + 1);
+      }
+   }
+}
+
 static INLINE bool LineSkipTest(PS_GPU* g, unsigned y)
 {
    if((g->DisplayMode & 0x24) != 0x24)
@@ -115,6 +115,13 @@ static void DrawLine(PS_GPU *gpu, line_point *points)
 
    gpu->DrawTimeAvail -= k * 2;
 
+   MarkDrawDirty(gpu,
+         std::min(points[0].x, points[1].x), std::min(points[0].y, points[1].y),
+         std::max(points[0].x, points[1].x), std::max(points[0].y, points[1].y));
+
+   if(gpu->timing_only)
+      return;
+
    line_points_to_fixed_point_step<goraud>(&points[0], &points[1], k, &step);
    line_point_to_fixed_point_coord<goraud>(&points[0], &step, &cur_point);
 
@@ -124,7 +131,7 @@ static void DrawLine(PS_GPU *gpu, line_point *points)
       int32_t x = (cur_point.x >> LINE_XY_FRACTBITS) & 2047;
       int32_t y = (cur_point.y >> LINE_XY_FRACTBITS) & 2047;
 
-      if(!LineSkipTest(gpu, y))
+      if(!LineSkipTest(gpu, y) && BandOwnsLine(gpu, y))
       {
          uint8_t r, g, b;
          uint16_t pix = 0x8000;
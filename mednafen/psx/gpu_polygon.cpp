@@ -1,6 +1,7 @@
 #include <math.h>
 #include <algorithm>
 #include "beetle_psx_globals.h"
+#include "gpu_simd.h"
 
 #define COORD_FBS 12
 #define COORD_MF_INT(n) ((n) << COORD_FBS)
@@ -115,6 +116,185 @@ static INLINE void AddIDeltas_DY(i_group &ig, const i_deltas &idl, uint32_t coun
    }
 }
 
+#ifdef HAVE_GPU_SIMD
+template<int BlendMode>
+static INLINE span_vec SpanBlend(span_vec bg_pix, span_vec fore_pix)
+{
+   // Same operations as PlotPixelBlend(), rearranged so that nothing needs
+   // more than 16 bits.
+   span_vec sum, carry;
+
+   switch(BlendMode)
+   {
+      case BLEND_MODE_AVERAGE:
+         bg_pix = span_or(bg_pix, span_set1(0x8000));
+         return span_add(span_and(fore_pix, bg_pix), span_srl(span_and(span_xor(fore_pix, bg_pix), span_set1(0xFBDE)), 1));
+
+      case BLEND_MODE_ADD_FOURTH:
+         fore_pix = span_or(span_and(span_srl(fore_pix, 2), span_set1(0x1CE7)), span_set1(0x8000));
+         // fall through
+      case BLEND_MODE_ADD:
+         bg_pix = span_and(bg_pix, span_set1(0x7FFF));
+         sum    = span_add(fore_pix, bg_pix);
+         carry  = span_and(span_sub(sum, span_and(span_xor(fore_pix, bg_pix), span_set1(0x8421))), span_set1(0x8420));
+         return span_or(span_sub(sum, carry), span_sub(carry, span_srl(carry, 5)));
+
+      case BLEND_MODE_SUBTRACT:
+         {
+            span_vec diff, borrow;
+
+            bg_pix   = span_or(bg_pix, span_set1(0x8000));
+            fore_pix = span_and(fore_pix, span_set1(0x7FFF));
+            diff     = span_add(span_sub(bg_pix, fore_pix), span_set1(0x8420));
+            borrow   = span_and(span_sub(diff, span_and(span_xor(bg_pix, fore_pix), span_set1(0x8420))), span_set1(0x8420));
+            return span_or(span_and(span_sub(diff, borrow), span_sub(borrow, span_srl(borrow, 5))), span_set1(0x8000));
+         }
+   }
+
+   return fore_pix;
+}
+
+// DitherLUT[][][v] computed from the dither offsets d.
+static INLINE span_vec SpanDither(span_vec v, span_vec d)
+{
+   return span_min_s(span_max_s(span_sra(span_add(v, d), 3), span_set1(0)), span_set1(0x1F));
+}
+
+// The ModTexel() product for one 5-bit texel component c.
+static INLINE span_vec SpanModComponent(span_vec c, span_vec m, span_vec d)
+{
+   return SpanDither(span_srl(span_mul(c, m), 4), d);
+}
+
+// Whether texels fetched for this span could come from the pixels the span
+// writes, in which case the scalar loop has to interleave reads and writes.
+template<uint32 TexMode_TA>
+static INLINE bool SpanTexOverlap(PS_GPU *gpu, int32 y, int32 x, int32 w)
+{
+   const uint32 ny = (y >> gpu->upscale_shift) & 511;
+   const int32 x0  = x >> gpu->upscale_shift;
+   const int32 x1  = (x + w - 1) >> gpu->upscale_shift;
+   const int32 tx0 = (gpu->SUCV.TWX_ADD >> (2 - TexMode_TA)) & ~3;
+   const int32 tx1 = ((gpu->SUCV.TWX_ADD + 255) >> (2 - TexMode_TA)) | 3;
+
+   if(ny < gpu->TexPageY || ny > gpu->TexPageY + 255)
+      return false;
+
+   return (x1 >= tx0 && x0 <= tx1) || (x1 >= tx0 - 1024 && x0 <= tx1 - 1024);
+}
+
+// Draws GPU_SIMD_LANES pixels per iteration for as long as the span allows,
+// leaving any remainder to the scalar loop in DrawSpan().
+template<bool goraud, bool textured, int BlendMode, bool TexMult, uint32 TexMode_TA, bool MaskEval_TA>
+static INLINE void DrawSpanSIMD(PS_GPU *gpu, int y, int32 &x, int32 &w, i_group &ig, const i_deltas &idl)
+{
+   uint16 *row = gpu->vram + ((y & ((512 << gpu->upscale_shift) - 1)) << (10 + gpu->upscale_shift));
+   const int16 *dither_row = gpu->DitherRow[(y >> gpu->dither_upscale_shift) & 3];
+   const int32 dither_phase = (4 << gpu->dither_upscale_shift) - 1;
+   const bool dither = DitherEnabled(gpu);
+   const span_vec mask_or = span_set1(gpu->MaskSetOR);
+   const span_vec flat_r = span_set1(ig.r >> (COORD_FBS + COORD_POST_PADDING));
+   const span_vec flat_g = span_set1(ig.g >> (COORD_FBS + COORD_POST_PADDING));
+   const span_vec flat_b = span_set1(ig.b >> (COORD_FBS + COORD_POST_PADDING));
+   span_vec d = span_set1(0);
+   span_ramp r_ramp, g_ramp, b_ramp;
+
+   if(goraud)
+   {
+      span_ramp_init(&r_ramp, idl.dr_dx);
+      span_ramp_init(&g_ramp, idl.dg_dx);
+      span_ramp_init(&b_ramp, idl.db_dx);
+   }
+
+   // Without dithering, texture modulation still goes through DitherLUT[2][3].
+   if(textured && TexMult && !dither)
+      d = span_set1(gpu->DitherRow[2][3 << gpu->dither_upscale_shift]);
+
+   do
+   {
+      const span_vec bg = span_load(row + x);
+      span_vec r = flat_r, g = flat_g, b = flat_b;
+      span_vec fore, keep;
+
+      if(goraud)
+      {
+         r = span_ramp_at(&r_ramp, ig.r);
+         g = span_ramp_at(&g_ramp, ig.g);
+         b = span_ramp_at(&b_ramp, ig.b);
+         ig.r += idl.dr_dx * GPU_SIMD_LANES;
+         ig.g += idl.dg_dx * GPU_SIMD_LANES;
+         ig.b += idl.db_dx * GPU_SIMD_LANES;
+      }
+
+      if(dither && (goraud || (textured && TexMult)))
+         d = span_load((const uint16 *)&dither_row[x & dither_phase]);
+
+      if(textured)
+      {
+         // The texture cache is stateful, so texels are still fetched one
+         // at a time and in order.
+         uint16 texels[GPU_SIMD_LANES];
+
+         for(unsigned i = 0; i < GPU_SIMD_LANES; i++)
+         {
+            texels[i] = GetTexel<TexMode_TA>(gpu, ig.u >> (COORD_FBS + COORD_POST_PADDING), ig.v >> (COORD_FBS + COORD_POST_PADDING));
+            ig.u += idl.du_dx;
+            ig.v += idl.dv_dx;
+         }
+
+         fore = span_load(texels);
+         keep = span_cmpeq(fore, span_set1(0));
+
+         if(TexMult)
+         {
+            const span_vec c5 = span_set1(0x1F);
+
+            fore = span_or(span_or(span_and(fore, span_set1(0x8000)),
+                     SpanModComponent(span_and(fore, c5), r, d)),
+                  span_or(span_sll(SpanModComponent(span_and(span_srl(fore, 5), c5), g, d), 5),
+                     span_sll(SpanModComponent(span_and(span_srl(fore, 10), c5), b, d), 10)));
+         }
+
+         if(BlendMode >= 0)
+            fore = span_select(span_sra(fore, 15), SpanBlend<BlendMode>(bg, fore), fore);
+
+         fore = span_or(fore, mask_or);
+      }
+      else
+      {
+         if(goraud && dither)
+         {
+            r = SpanDither(r, d);
+            g = SpanDither(g, d);
+            b = SpanDither(b, d);
+         }
+         else
+         {
+            r = span_srl(r, 3);
+            g = span_srl(g, 3);
+            b = span_srl(b, 3);
+         }
+
+         fore = span_or(span_or(span_set1(0x8000), r), span_or(span_sll(g, 5), span_sll(b, 10)));
+
+         if(BlendMode >= 0)
+            fore = SpanBlend<BlendMode>(bg, fore);
+
+         fore = span_or(span_and(fore, span_set1(0x7FFF)), mask_or);
+         keep = span_set1(0);
+      }
+
+      if(MaskEval_TA)
+         keep = span_or(keep, span_sra(bg, 15));
+
+      span_store(row + x, span_select(keep, bg, fore));
+
+      x += GPU_SIMD_LANES;
+      w -= GPU_SIMD_LANES;
+   } while(w >= GPU_SIMD_LANES);
+}
+#endif
+
 template<bool goraud, bool textured, int BlendMode, bool TexMult, uint32 TexMode_TA, bool MaskEval_TA>
 static INLINE void DrawSpan(PS_GPU *gpu, int y, const int32 x_start, const int32 x_bound, i_group ig, const i_deltas &idl)
 {
@@ -162,6 +342,45 @@ static INLINE void DrawSpan(PS_GPU *gpu, int y, const int32 x_start, const int32
         gpu->DrawTimeAvail -= w >> gpu->upscale_shift;
   }
 
+  if(gpu->timing_only)
+  {
+     // Texture cache misses still cost time, so walk the tags.
+     if(textured)
+     {
+        do
+        {
+           TouchTexel<TexMode_TA>(gpu, ig.u >> (COORD_FBS + COORD_POST_PADDING), ig.v >> (COORD_FBS + COORD_POST_PADDING));
+           AddIDeltas_DX<goraud, textured>(ig, idl);
+        } while(MDFN_LIKELY(--w > 0));
+     }
+     return;
+  }
+
+  if(!BandOwnsLine(gpu, y >> gpu->upscale_shift))
+  {
+     // Another thread draws this row, but the texture cache may still
+     // have to be kept in step.
+     if(textured && gpu->texcache_exact)
+     {
+        do
+        {
+           GetTexel<TexMode_TA>(gpu, ig.u >> (COORD_FBS + COORD_POST_PADDING), ig.v >> (COORD_FBS + COORD_POST_PADDING));
+           AddIDeltas_DX<goraud, textured>(ig, idl);
+        } while(MDFN_LIKELY(--w > 0));
+     }
+     return;
+  }
+
+#ifdef HAVE_GPU_SIMD
+  if(w >= GPU_SIMD_LANES && (!textured || !SpanTexOverlap<TexMode_TA>(gpu, y, x, w)))
+  {
+     DrawSpanSIMD<goraud, textured, BlendMode, TexMult, TexMode_TA, MaskEval_TA>(gpu, y, x, w, ig, idl);
+
+     if(w <= 0)
+        return;
+  }
+#endif
+
   do
   {
    const uint32 r = ig.r >> (COORD_FBS + COORD_POST_PADDING);
@@ -276,6 +495,14 @@ static INLINE void DrawTriangle(PS_GPU *gpu, tri_vertex *vertices)
    if(!CalcIDeltas<goraud, textured>(idl, vertices[0], vertices[1], vertices[2]))
       return;
 
+   // Rows from the top vertex down to (not including) the bottom one, one
+   // extra column on the right for rounding.
+   MarkDrawDirty(gpu,
+         std::min(vertices[0].x, std::min(vertices[1].x, vertices[2].x)) >> gpu->upscale_shift,
+         vertices[0].y >> gpu->upscale_shift,
+         (std::max(vertices[0].x, std::max(vertices[1].x, vertices[2].x)) >> gpu->upscale_shift) + 1,
+         (vertices[2].y - 1) >> gpu->upscale_shift);
+
 
  // [0] should be top vertex, [2] should be bottom vertex, [1] should be off to the side vertex.
  //
@@ -0,0 +1,692 @@
+#include "psx.h"
+#include "gpu_replay.h"
+#include "profile.h"
+#include "../mednafen-endian.h"
+#include "../video/surface.h"
+#include "../../rsx/rsx_intf.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+extern enum dither_mode psx_gpu_dither_mode;
+extern PS_GPU GPU;
+
+/* Emulated clocks the GPU is run for whenever the replay has to wait on it. */
+#define REPLAY_STEP_CLOCKS 128
+
+/* Waits longer than this many steps mean the stream left the GPU stuck
+ * (e.g. in the middle of a polyline) and the replay moves on. */
+#define REPLAY_MAX_STEPS 0x2000
+
+/* Timestamps are rebased once they get this large. */
+#define REPLAY_TS_LIMIT (1 << 24)
+
+/* Nominal length of a frame, for streams that don't record it. */
+#define REPLAY_FRAME_CLOCKS (33868800 / 60)
+
+/* GP1 status bits */
+#define STATUS_IDLE   (1 << 26)
+#define STATUS_FBREAD (1 << 27)
+
+struct replay_stats
+{
+   uint64 count[256];
+   uint64 ns[256];
+};
+
+static replay_stats stats;
+/* Set while a replay is timing its commands. */
+bool gpu_replay_stats;
+
+static int32 replay_ts;
+
+void GPU_Replay_CountCommand(uint8 cc, uint64 ns)
+{
+   stats.count[cc]++;
+   stats.ns[cc] += ns;
+}
+
+static const char *command_name(unsigned cc)
+{
+   if (cc >= 0x20 && cc < 0x40)
+      return "polygon";
+   if (cc >= 0x40 && cc < 0x60)
+      return "line";
+   if (cc >= 0x60 && cc < 0x80)
+      return "sprite";
+   if (cc >= 0x80 && cc < 0xA0)
+      return "vram copy";
+   if (cc >= 0xA0 && cc < 0xC0)
+      return "vram write";
+   if (cc >= 0xC0 && cc < 0xE0)
+      return "vram read";
+   if (cc >= 0xE0)
+      return "state";
+   if (cc == 0x02)
+      return "fill";
+
+   return "misc";
+}
+
+enum
+{
+   REPLAY_RECORD,
+   REPLAY_FRAME,
+   REPLAY_DONE,
+   REPLAY_ERROR
+};
+
+struct replay_source
+{
+   FILE *file;
+   unsigned version;
+};
+
+static replay_source live;
+static unsigned live_frames;
+static uint64 live_start;
+
+static bool read_u32(FILE *file, uint32 *value)
+{
+   uint8 b[4];
+
+   if (fread(b, 1, 4, file) != 4)
+      return false;
+
+   *value = MDFN_de32lsb<false>(b);
+   return true;
+}
+
+static bool open_stream(replay_source *src, const char *path)
+{
+   char magic[8];
+
+   src->file = fopen(path, "rb");
+   if (!src->file)
+   {
+      log_cb(RETRO_LOG_ERROR, "[GPU replay] Can't open \"%s\"\n", path);
+      return false;
+   }
+
+   if (fread(magic, 1, 8, src->file) == 8 && !memcmp(magic, "GPUSTRM", 7)
+         && magic[7] >= '1' && magic[7] <= '2')
+   {
+      src->version = magic[7] - '0';
+      return true;
+   }
+
+   log_cb(RETRO_LOG_ERROR, "[GPU replay] \"%s\" isn't a GPU command stream\n", path);
+   fclose(src->file);
+   src->file = NULL;
+   return false;
+}
+
+/* Nobody is on the other end of a VRAM read, drain it. */
+static void replay_drain_read(void)
+{
+   unsigned words;
+
+   for (words = 0; (GPU_Read(replay_ts, 4) & STATUS_FBREAD) && words < 1024 * 512; words++)
+      GPU_Read(replay_ts, 0);
+}
+
+static void replay_step(void)
+{
+   replay_ts += REPLAY_STEP_CLOCKS;
+   GPU_Update(replay_ts);
+   replay_drain_read();
+}
+
+/* Runs the GPU until everything written so far has been processed. */
+static void replay_drain(void)
+{
+   unsigned steps;
+
+   for (steps = 0; !(GPU_Read(replay_ts, 4) & STATUS_IDLE) && steps < REPLAY_MAX_STEPS; steps++)
+      replay_step();
+}
+
+/* GPU_Update() overflows its clock counter if it is handed much more than
+ * an event period at once, so catch up in steps like the event loop does. */
+static void replay_advance(int32 timestamp)
+{
+   while (replay_ts < timestamp)
+   {
+      replay_ts = std::min<int32>(replay_ts + REPLAY_STEP_CLOCKS, timestamp);
+      GPU_Update(replay_ts);
+   }
+}
+
+/* Waits for room rather than dropping the word. The GPU state a stream
+ * starts from isn't exact, so its FIFO can be fuller than it was when the
+ * stream was recorded. */
+static void replay_gp0(uint32 value, bool dma)
+{
+   for (unsigned steps = 0; !GPU_FIFOHasRoom() && steps < REPLAY_MAX_STEPS; steps++)
+      replay_step();
+
+   if (dma)
+      GPU_WriteDMA(value, 0);
+   else
+      GPU_Write(replay_ts, 0, value);
+
+   replay_drain_read();
+}
+
+/* The snapshot goes in through a regular VRAM upload, so it reaches
+ * whichever renderer is active. */
+static bool replay_vram(FILE *file)
+{
+   uint8 row[1024 * 2];
+
+   replay_gp0(0xA0000000, false);
+   replay_gp0(0x00000000, false);
+   replay_gp0(0x00000000, false); /* 1024x512 */
+
+   for (unsigned y = 0; y < 512; y++)
+   {
+      if (fread(row, 1, sizeof(row), file) != sizeof(row))
+         return false;
+
+      for (unsigned x = 0; x < 1024; x += 2)
+         replay_gp0(MDFN_de32lsb<false>(row + x * 2), false);
+   }
+
+   return true;
+}
+
+/* Feeds one record of the stream to the GPU. */
+static int replay_record(replay_source *src, int32 *frame_ts)
+{
+   uint32 tag, timestamp = 0, value;
+
+   if (!read_u32(src->file, &tag) || tag == GPU_STREAM_END)
+      return REPLAY_DONE;
+
+   if (src->version >= 2)
+   {
+      if (!read_u32(src->file, &timestamp))
+         goto truncated;
+
+      /* Give the GPU the time it had when the write was made. */
+      replay_advance(timestamp);
+   }
+
+   switch (tag)
+   {
+      case GPU_STREAM_GP0:
+      case GPU_STREAM_DMA:
+         if (!read_u32(src->file, &value))
+            goto truncated;
+
+         replay_gp0(value, tag == GPU_STREAM_DMA);
+         break;
+
+      case GPU_STREAM_GP1:
+         if (!read_u32(src->file, &value))
+            goto truncated;
+
+         /* GP1 writes can reset the FIFO. Without timestamps, keep them in
+          * order with the GP0 words written before. */
+         if (src->version < 2)
+            replay_drain();
+         GPU_Write(replay_ts, 4, value);
+         break;
+
+      case GPU_STREAM_VRAM:
+         if (!replay_vram(src->file))
+            goto truncated;
+         break;
+
+      case GPU_STREAM_FRAME:
+         if (src->version < 2)
+         {
+            replay_drain();
+            timestamp = replay_ts;
+         }
+
+         *frame_ts = timestamp;
+         return REPLAY_FRAME;
+
+      default:
+         log_cb(RETRO_LOG_ERROR, "[GPU replay] Unknown record 0x%08X\n", tag);
+         return REPLAY_ERROR;
+   }
+
+   return REPLAY_RECORD;
+
+truncated:
+   log_cb(RETRO_LOG_ERROR, "[GPU replay] Stream is truncated\n");
+   return REPLAY_ERROR;
+}
+
+/* Hashes VRAM, then what was scanned out of it so far, which catches
+ * scanout lines wrongly skipped as unchanged. */
+static uint64 hash_frame(unsigned shift, const MDFN_Surface *surface)
+{
+   const uint16 *vram  = GPU_get_vram();
+   const size_t count  = (size_t)(1024 << shift) * (512 << shift);
+   const size_t pixels = (size_t)surface->pitchinpix * surface->h;
+   uint64 hash         = UINT64_C(0xCBF29CE484222325);
+
+   GPU_Sync();
+
+   for (size_t i = 0; i < count; i++)
+   {
+      hash ^= vram[i];
+      hash *= UINT64_C(0x100000001B3);
+   }
+
+   for (size_t i = 0; i < pixels; i++)
+   {
+      hash ^= surface->pixels[i];
+      hash *= UINT64_C(0x100000001B3);
+   }
+
+   return hash;
+}
+
+static void report_stats(unsigned shift, unsigned frames, uint64 ns)
+{
+   uint64 total_count = 0;
+   uint64 total_ns    = 0;
+
+   for (unsigned cc = 0; cc < 256; cc++)
+   {
+      if (!stats.count[cc])
+         continue;
+
+      log_cb(RETRO_LOG_INFO, "[GPU replay]   0x%02X %-10s %10llu cmds %10.1f ns/cmd %10.3f Mcmd/s\n",
+            cc, command_name(cc),
+            (unsigned long long)stats.count[cc],
+            (double)stats.ns[cc] / stats.count[cc],
+            stats.ns[cc] ? stats.count[cc] * 1000.0 / stats.ns[cc] : 0.0);
+
+      total_count += stats.count[cc];
+      total_ns    += stats.ns[cc];
+   }
+
+   log_cb(RETRO_LOG_INFO, "[GPU replay] %ux: %u frames in %.3f s (%.1f fps), %llu commands taking %.3f s\n",
+         1 << shift, frames, ns / 1e9, ns ? frames * 1e9 / ns : 0.0,
+         (unsigned long long)total_count, total_ns / 1e9);
+}
+
+static void replay_end_frame(const replay_source *src)
+{
+   /* Recorded timestamps restart every frame, like the emulated ones. */
+   if (src->version >= 2 || replay_ts >= REPLAY_TS_LIMIT)
+   {
+      GPU_ResetTS();
+      replay_ts = 0;
+   }
+}
+
+static bool replay_pass(replay_source *src, unsigned shift, std::vector<uint64> &hashes)
+{
+   MDFN_PixelFormat pix_fmt(MDFN_COLORSPACE_RGB, 16, 8, 0, 24);
+   MDFN_Surface surface(NULL, 700 << shift, 576 << shift, 700 << shift, pix_fmt);
+   static int32 line_widths[576];
+   EmulateSpecStruct espec;
+   unsigned frames = 0;
+   int32 frame_ts;
+   uint64 start;
+   int result;
+
+   memset(&espec, 0, sizeof(espec));
+   espec.surface    = &surface;
+   espec.LineWidths = line_widths;
+
+   GPU_Rescale(shift);
+   switch (psx_gpu_dither_mode)
+   {
+      case DITHER_NATIVE:
+         GPU_set_dither_upscale_shift(shift);
+         break;
+      case DITHER_UPSCALED:
+         GPU_set_dither_upscale_shift(0);
+         break;
+      case DITHER_OFF:
+         break;
+   }
+   GPU_Power();
+
+   replay_ts = 0;
+   GPU_ResetTS();
+   GPU_StartFrame(&espec);
+
+   memset(&stats, 0, sizeof(stats));
+   gpu_replay_stats = true;
+   start         = PSX_Profile_Clock();
+
+   fseek(src->file, 8, SEEK_SET);
+
+   while ((result = replay_record(src, &frame_ts)) != REPLAY_DONE)
+   {
+      if (result == REPLAY_ERROR)
+      {
+         gpu_replay_stats = false;
+         return false;
+      }
+
+      if (result != REPLAY_FRAME)
+         continue;
+
+      hashes.push_back(hash_frame(shift, &surface));
+      frames++;
+
+      replay_end_frame(src);
+      GPU_StartFrame(&espec);
+   }
+
+   replay_drain();
+   gpu_replay_stats = false;
+   report_stats(shift, frames, PSX_Profile_Clock() - start);
+
+   return true;
+}
+
+bool GPU_Replay_Run(const char *stream_path, const char *golden_path, unsigned max_shift)
+{
+   uint8 upscale_shift = GPU_get_upscale_shift();
+   uint8 dither_shift  = GPU_get_dither_upscale_shift();
+   replay_source stream;
+   FILE *golden = NULL;
+   bool record  = false;
+   bool ok      = true;
+
+   /* The replay renders into its own surfaces. */
+   if (rsx_intf_is_type() != RSX_SOFTWARE)
+   {
+      log_cb(RETRO_LOG_ERROR, "[GPU replay] Needs the software renderer\n");
+      return false;
+   }
+
+   if (!open_stream(&stream, stream_path))
+      return false;
+
+   if (golden_path)
+   {
+      golden = fopen(golden_path, "r");
+      if (!golden)
+      {
+         golden = fopen(golden_path, "w");
+         record = true;
+      }
+   }
+
+   if (max_shift > 4)
+      max_shift = 4;
+
+   for (unsigned shift = 0; shift <= max_shift; shift++)
+   {
+      std::vector<uint64> hashes;
+      unsigned mismatches = 0;
+
+      if (!replay_pass(&stream, shift, hashes))
+      {
+         ok = false;
+         break;
+      }
+
+      for (unsigned frame = 0; frame < hashes.size(); frame++)
+      {
+         unsigned golden_shift, golden_frame;
+         unsigned long long expected;
+
+         if (!golden)
+            continue;
+
+         if (record)
+         {
+            fprintf(golden, "%u %u %016llx\n", shift, frame, (unsigned long long)hashes[frame]);
+            continue;
+         }
+
+         if (fscanf(golden, "%u %u %llx", &golden_shift, &golden_frame, &expected) != 3
+               || golden_shift != shift || golden_frame != frame)
+         {
+            log_cb(RETRO_LOG_ERROR, "[GPU replay] Golden file doesn't match the stream\n");
+            fclose(golden);
+            golden = NULL;
+            ok     = false;
+            break;
+         }
+
+         if (expected != hashes[frame])
+         {
+            if (!mismatches)
+               log_cb(RETRO_LOG_ERROR, "[GPU replay] %ux: VRAM differs first at frame %u\n", 1 << shift, frame);
+            mismatches++;
+         }
+      }
+
+      if (mismatches)
+      {
+         log_cb(RETRO_LOG_ERROR, "[GPU replay] %ux: %u of %u frames differ\n", 1 << shift, mismatches, (unsigned)hashes.size());
+         ok = false;
+      }
+      else if (golden && !record)
+         log_cb(RETRO_LOG_INFO, "[GPU replay] %ux: all %u frames match\n", 1 << shift, (unsigned)hashes.size());
+   }
+
+   if (record && golden)
+      log_cb(RETRO_LOG_INFO, "[GPU replay] Wrote golden hashes to \"%s\"\n", golden_path);
+
+   if (golden)
+      fclose(golden);
+   fclose(stream.file);
+
+   GPU_Rescale(upscale_shift);
+   GPU_set_dither_upscale_shift(dither_shift);
+
+   return ok;
+}
+
+bool GPU_Replay_Open(const char *stream_path)
+{
+   if (live.file)
+      fclose(live.file);
+
+   if (!open_stream(&live, stream_path))
+      return false;
+
+   live_frames = 0;
+   live_start  = PSX_Profile_Clock();
+
+   memset(&stats, 0, sizeof(stats));
+   gpu_replay_stats = true;
+
+   return true;
+}
+
+static void live_close(void)
+{
+   gpu_replay_stats = false;
+   report_stats(GPU_get_upscale_shift(), live_frames, PSX_Profile_Clock() - live_start);
+
+   fclose(live.file);
+   live.file = NULL;
+}
+
+bool GPU_Replay_Live(void)
+{
+   long pos;
+   uint32 tag;
+
+   if (!live.file)
+      return false;
+
+   /* Finish as soon as only the end of the stream is left, so there is no
+    * call to GPU_Replay_Frame() that doesn't play a frame. */
+   pos = ftell(live.file);
+
+   if (read_u32(live.file, &tag) && tag != GPU_STREAM_END)
+   {
+      fseek(live.file, pos, SEEK_SET);
+      return true;
+   }
+
+   live_close();
+   return false;
+}
+
+int32 GPU_Replay_Frame(void)
+{
+   int32 frame_ts = 0;
+   int result;
+
+   if (!live.file)
+      return 0;
+
+   /* The emulation loop resets the GPU's timestamp after every frame. */
+   replay_ts = 0;
+
+   while ((result = replay_record(&live, &frame_ts)) == REPLAY_RECORD)
+      ;
+
+   if (result != REPLAY_FRAME)
+   {
+      live_close();
+      return 0;
+   }
+
+   /* Let the GPU scan the frame out. */
+   replay_advance(live.version < 2 ? REPLAY_FRAME_CLOCKS : frame_ts);
+   live_frames++;
+
+   return replay_ts;
+}
+
+bool gpu_capture_active;
+
+static FILE *capture_file;
+static unsigned capture_frames;
+static unsigned capture_max_frames;
+
+static void capture_u32(uint32 value)
+{
+   uint8 b[4];
+
+   MDFN_en32lsb<false>(b, value);
+   fwrite(b, 1, 4, capture_file);
+}
+
+static void capture_record(uint32 tag, int32 timestamp)
+{
+   capture_u32(tag);
+   capture_u32(timestamp);
+}
+
+void GPU_Capture_Write(uint32 tag, int32 timestamp, uint32 V)
+{
+   capture_record(tag, timestamp);
+   capture_u32(V);
+}
+
+/* Writes VRAM at 1x, then the GPU state as the commands that set it. */
+static void capture_snapshot(int32 timestamp)
+{
+   const uint16 *vram   = GPU_get_vram();
+   const unsigned shift = GPU_get_upscale_shift();
+   uint8 row[1024 * 2];
+
+   const uint32 gp1[] =
+   {
+      0x09000000 | (uint32)GPU.TexDisableAllowChange,
+      0x04000000 | GPU.DMAControl,
+      0x05000000 | GPU.DisplayFB_XStart | (GPU.DisplayFB_YStart << 10),
+      0x06000000 | GPU.HorizStart | (GPU.HorizEnd << 12),
+      0x07000000 | GPU.VertStart | (GPU.VertEnd << 10),
+      0x08000000 | (GPU.DisplayMode & 0xFF),
+      0x03000000 | (uint32)GPU.DisplayOff,
+   };
+
+   const uint32 gp0[] =
+   {
+      0xE1000000 | (GPU.TexPageX >> 6) | (GPU.TexPageY >> 4) | (GPU.abr << 5)
+         | (GPU.TexMode << 7) | (GPU.dtd << 9) | (GPU.dfe << 10)
+         | (GPU.TexDisable << 11) | GPU.SpriteFlip,
+      0xE2000000 | GPU.tww | (GPU.twh << 5) | (GPU.twx << 10) | (GPU.twy << 15),
+      0xE3000000 | GPU.ClipX0 | (GPU.ClipY0 << 10),
+      0xE4000000 | GPU.ClipX1 | (GPU.ClipY1 << 10),
+      0xE5000000 | (GPU.OffsX & 2047) | ((GPU.OffsY & 2047) << 11),
+      0xE6000000 | (GPU.MaskSetOR ? 1 : 0) | (GPU.MaskEvalAND ? 2 : 0),
+   };
+
+   GPU_Sync();
+
+   capture_record(GPU_STREAM_VRAM, 0);
+   for (unsigned y = 0; y < 512; y++)
+   {
+      for (unsigned x = 0; x < 1024; x++)
+         MDFN_en16lsb<false>(row + x * 2, vram[((y << shift) << (10 + shift)) | (x << shift)]);
+
+      fwrite(row, 1, sizeof(row), capture_file);
+   }
+
+   for (unsigned i = 0; i < sizeof(gp1) / sizeof(gp1[0]); i++)
+      GPU_Capture_Write(GPU_STREAM_GP1, 0, gp1[i]);
+
+   for (unsigned i = 0; i < sizeof(gp0) / sizeof(gp0[0]); i++)
+      GPU_Capture_Write(GPU_STREAM_GP0, 0, gp0[i]);
+
+   capture_record(GPU_STREAM_FRAME, timestamp);
+}
+
+bool GPU_Capture_Start(const char *path, unsigned max_frames)
+{
+   GPU_Capture_Stop();
+
+   capture_file = fopen(path, "wb");
+   if (!capture_file)
+   {
+      log_cb(RETRO_LOG_ERROR, "[GPU capture] Can't create \"%s\"\n", path);
+      return false;
+   }
+
+   fwrite("GPUSTRM2", 1, 8, capture_file);
+
+   capture_frames     = 0;
+   capture_max_frames = max_frames;
+
+   return true;
+}
+
+void GPU_Capture_Stop(void)
+{
+   if (!capture_file)
+      return;
+
+   capture_u32(GPU_STREAM_END);
+   fclose(capture_file);
+   capture_file       = NULL;
+   gpu_capture_active = false;
+
+   log_cb(RETRO_LOG_INFO, "[GPU capture] Captured %u frames\n", capture_frames);
+}
+
+void GPU_Capture_Frame(int32 timestamp)
+{
+   if (!capture_file)
+      return;
+
+   if (!gpu_capture_active)
+   {
+      /* Only start between commands, a stream can't begin halfway
+       * through one. */
+      if (!(GPU_Read(timestamp, 4) & STATUS_IDLE))
+         return;
+
+      capture_snapshot(timestamp);
+      gpu_capture_active = true;
+      return;
+   }
+
+   capture_record(GPU_STREAM_FRAME, timestamp);
+
+   capture_frames++;
+   if (capture_max_frames && capture_frames >= capture_max_frames)
+      GPU_Capture_Stop();
+}
@@ -0,0 +1,85 @@
+#ifndef __MDFN_PSX_GPU_REPLAY_H
+#define __MDFN_PSX_GPU_REPLAY_H
+
+/* GP0/GP1 command stream capture and replay, built with GPU_REPLAY=1.
+ *
+ * A capture records everything the CPU and DMA write to the GPU, so the
+ * GPU can later be driven without the CPU, CD or BIOS. It starts at the
+ * first frame boundary where the GPU is idle with a snapshot of VRAM and
+ * of the GPU state.
+ *
+ * A recorded stream can be fed into the software GPU once per
+ * upscale_shift. At every frame marker VRAM and what has been scanned out
+ * of it are hashed and compared against a golden file, or the golden file
+ * is written when it doesn't exist yet, so rasterizer and scanout changes
+ * can be checked for bit-exactness. The host time spent in each GP0
+ * command is reported too, which makes a replay a rasterizer benchmark. A
+ * stream can also be played one frame per retro_run() in place of the
+ * emulated system, which works with the hardware renderers as well.
+ *
+ * GPU_REPLAY builds can start without content, in which case there is no
+ * disc and no firmware, only the GPU for a stream to be played into. The
+ * benchmark runner drives both kinds of replay that way, see
+ * benchmark.cpp.
+ *
+ * Streams start with an 8 byte magic, followed by records made of a
+ * little-endian uint32 tag and the tag's payload. "GPUSTRM1" records carry
+ * no timestamp; in "GPUSTRM2" every record but GPU_STREAM_END is followed
+ * by the uint32 CPU timestamp of the write, relative to the start of the
+ * frame:
+ *
+ *   GPU_STREAM_GP0    uint32 word written to GP0
+ *   GPU_STREAM_GP1    uint32 word written to GP1
+ *   GPU_STREAM_FRAME  end of a frame
+ *   GPU_STREAM_DMA    uint32 word written to GP0 by DMA
+ *   GPU_STREAM_VRAM   1024x512 uint16 VRAM contents
+ *   GPU_STREAM_END    end of the stream
+ */
+
+enum
+{
+   GPU_STREAM_END = 0,
+   GPU_STREAM_GP0,
+   GPU_STREAM_GP1,
+   GPU_STREAM_FRAME,
+   GPU_STREAM_DMA,
+   GPU_STREAM_VRAM
+};
+
+/* Replays the stream at upscale shifts 0 through max_shift with the
+ * software renderer, then puts the upscale shifts back. The rest of the
+ * GPU state is left as the stream left it, the caller has to reset the
+ * system. Returns false if the stream couldn't be read or a hash didn't
+ * match. */
+bool GPU_Replay_Run(const char *stream_path, const char *golden_path, unsigned max_shift);
+
+/* Opens a stream to be played with GPU_Replay_Frame(). */
+bool GPU_Replay_Open(const char *stream_path);
+
+/* Feeds the next frame of the stream opened with GPU_Replay_Open() to the
+ * GPU, whichever renderer is active. Returns the timestamp the frame ended
+ * at, or 0 once the stream is over and has been closed. */
+int32 GPU_Replay_Frame(void);
+
+/* Whether the stream opened with GPU_Replay_Open() has another frame to
+ * play. Closes the stream once it doesn't. */
+bool GPU_Replay_Live(void);
+
+/* Starts capturing GPU writes to path. max_frames of 0 means until
+ * GPU_Capture_Stop(). */
+bool GPU_Capture_Start(const char *path, unsigned max_frames);
+void GPU_Capture_Stop(void);
+
+/* Called at the end of every emulated frame, before timestamps are reset. */
+void GPU_Capture_Frame(int32 timestamp);
+
+#ifdef GPU_REPLAY
+/* Commands are only timed and counted while gpu_replay_stats is set. */
+extern bool gpu_replay_stats;
+void GPU_Replay_CountCommand(uint8 cc, uint64 ns);
+
+extern bool gpu_capture_active;
+void GPU_Capture_Write(uint32 tag, int32 timestamp, uint32 V);
+#endif
+
+#endif
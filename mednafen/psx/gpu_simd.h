@@ -0,0 +1,213 @@
+#ifndef __MDFN_PSX_GPU_SIMD_H
+#define __MDFN_PSX_GPU_SIMD_H
+
+/* Thin wrappers over the vector instructions used by the software
+ * renderer's span kernels. A span_vec holds GPU_SIMD_LANES 16-bit pixels;
+ * everything is plain modular 16-bit arithmetic so the kernels give the
+ * same results as the scalar code on every target. */
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define GPU_SIMD_AVX2
+#define GPU_SIMD_LANES 16
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define GPU_SIMD_SSE2
+#define GPU_SIMD_LANES 8
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define GPU_SIMD_NEON
+#define GPU_SIMD_LANES 8
+#endif
+
+/* x86 builds also carry SSSE3 and AVX2 versions of the scanout kernels,
+ * whatever the compiler flags, which gpu.cpp picks at runtime if the CPU
+ * supports them. */
+#if (defined(GPU_SIMD_SSE2) || defined(GPU_SIMD_AVX2)) && (defined(__x86_64__) || defined(__i386__)) \
+   && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#include <immintrin.h>
+#define GPU_SIMD_X86_DISPATCH
+#define GPU_SIMD_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define GPU_SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#ifdef GPU_SIMD_LANES
+#define HAVE_GPU_SIMD
+
+#if defined(GPU_SIMD_AVX2)
+
+typedef __m256i span_vec;
+
+static INLINE span_vec span_load(const uint16 *p) { return _mm256_loadu_si256((const __m256i *)p); }
+static INLINE void span_store(uint16 *p, span_vec v) { _mm256_storeu_si256((__m256i *)p, v); }
+static INLINE span_vec span_set1(uint16 v) { return _mm256_set1_epi16((short)v); }
+static INLINE span_vec span_add(span_vec a, span_vec b) { return _mm256_add_epi16(a, b); }
+static INLINE span_vec span_sub(span_vec a, span_vec b) { return _mm256_sub_epi16(a, b); }
+static INLINE span_vec span_mul(span_vec a, span_vec b) { return _mm256_mullo_epi16(a, b); }
+static INLINE span_vec span_and(span_vec a, span_vec b) { return _mm256_and_si256(a, b); }
+static INLINE span_vec span_or(span_vec a, span_vec b) { return _mm256_or_si256(a, b); }
+static INLINE span_vec span_xor(span_vec a, span_vec b) { return _mm256_xor_si256(a, b); }
+/* a & ~b */
+static INLINE span_vec span_andnot(span_vec a, span_vec b) { return _mm256_andnot_si256(b, a); }
+static INLINE span_vec span_min_s(span_vec a, span_vec b) { return _mm256_min_epi16(a, b); }
+static INLINE span_vec span_max_s(span_vec a, span_vec b) { return _mm256_max_epi16(a, b); }
+static INLINE span_vec span_cmpeq(span_vec a, span_vec b) { return _mm256_cmpeq_epi16(a, b); }
+#define span_srl(v, n) _mm256_srli_epi16((v), (n))
+#define span_sll(v, n) _mm256_slli_epi16((v), (n))
+#define span_sra(v, n) _mm256_srai_epi16((v), (n))
+
+/* Lane i of a ramp is (base + i * step) >> 24, the integer part of a
+ * COORD_FBS + COORD_POST_PADDING fixed point interpolant. */
+struct span_ramp
+{
+   __m256i lo, hi;
+};
+
+static INLINE void span_ramp_init(span_ramp *r, uint32 step)
+{
+   r->lo = _mm256_mullo_epi32(_mm256_set1_epi32(step), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+   r->hi = _mm256_add_epi32(r->lo, _mm256_set1_epi32(step * 8));
+}
+
+static INLINE span_vec span_ramp_at(const span_ramp *r, uint32 base)
+{
+   const __m256i b = _mm256_set1_epi32(base);
+   const __m256i lo = _mm256_srli_epi32(_mm256_add_epi32(b, r->lo), 24);
+   const __m256i hi = _mm256_srli_epi32(_mm256_add_epi32(b, r->hi), 24);
+
+   /* The pack works within 128-bit halves, put the quarters back in order. */
+   return _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+}
+
+#elif defined(GPU_SIMD_SSE2)
+
+typedef __m128i span_vec;
+
+static INLINE span_vec span_load(const uint16 *p) { return _mm_loadu_si128((const __m128i *)p); }
+static INLINE void span_store(uint16 *p, span_vec v) { _mm_storeu_si128((__m128i *)p, v); }
+static INLINE span_vec span_set1(uint16 v) { return _mm_set1_epi16((short)v); }
+static INLINE span_vec span_add(span_vec a, span_vec b) { return _mm_add_epi16(a, b); }
+static INLINE span_vec span_sub(span_vec a, span_vec b) { return _mm_sub_epi16(a, b); }
+static INLINE span_vec span_mul(span_vec a, span_vec b) { return _mm_mullo_epi16(a, b); }
+static INLINE span_vec span_and(span_vec a, span_vec b) { return _mm_and_si128(a, b); }
+static INLINE span_vec span_or(span_vec a, span_vec b) { return _mm_or_si128(a, b); }
+static INLINE span_vec span_xor(span_vec a, span_vec b) { return _mm_xor_si128(a, b); }
+static INLINE span_vec span_andnot(span_vec a, span_vec b) { return _mm_andnot_si128(b, a); }
+static INLINE span_vec span_min_s(span_vec a, span_vec b) { return _mm_min_epi16(a, b); }
+static INLINE span_vec span_max_s(span_vec a, span_vec b) { return _mm_max_epi16(a, b); }
+static INLINE span_vec span_cmpeq(span_vec a, span_vec b) { return _mm_cmpeq_epi16(a, b); }
+#define span_srl(v, n) _mm_srli_epi16((v), (n))
+#define span_sll(v, n) _mm_slli_epi16((v), (n))
+#define span_sra(v, n) _mm_srai_epi16((v), (n))
+
+struct span_ramp
+{
+   __m128i lo, hi;
+};
+
+static INLINE void span_ramp_init(span_ramp *r, uint32 step)
+{
+   r->lo = _mm_setr_epi32(0, step, step * 2, step * 3);
+   r->hi = _mm_add_epi32(r->lo, _mm_set1_epi32(step * 4));
+}
+
+static INLINE span_vec span_ramp_at(const span_ramp *r, uint32 base)
+{
+   const __m128i b = _mm_set1_epi32(base);
+   const __m128i lo = _mm_srli_epi32(_mm_add_epi32(b, r->lo), 24);
+   const __m128i hi = _mm_srli_epi32(_mm_add_epi32(b, r->hi), 24);
+
+   return _mm_packs_epi32(lo, hi);
+}
+
+#elif defined(GPU_SIMD_NEON)
+
+typedef uint16x8_t span_vec;
+
+static INLINE span_vec span_load(const uint16 *p) { return vld1q_u16(p); }
+static INLINE void span_store(uint16 *p, span_vec v) { vst1q_u16(p, v); }
+static INLINE span_vec span_set1(uint16 v) { return vdupq_n_u16(v); }
+static INLINE span_vec span_add(span_vec a, span_vec b) { return vaddq_u16(a, b); }
+static INLINE span_vec span_sub(span_vec a, span_vec b) { return vsubq_u16(a, b); }
+static INLINE span_vec span_mul(span_vec a, span_vec b) { return vmulq_u16(a, b); }
+static INLINE span_vec span_and(span_vec a, span_vec b) { return vandq_u16(a, b); }
+static INLINE span_vec span_or(span_vec a, span_vec b) { return vorrq_u16(a, b); }
+static INLINE span_vec span_xor(span_vec a, span_vec b) { return veorq_u16(a, b); }
+static INLINE span_vec span_andnot(span_vec a, span_vec b) { return vbicq_u16(a, b); }
+static INLINE span_vec span_min_s(span_vec a, span_vec b) { return vreinterpretq_u16_s16(vminq_s16(vreinterpretq_s16_u16(a), vreinterpretq_s16_u16(b))); }
+static INLINE span_vec span_max_s(span_vec a, span_vec b) { return vreinterpretq_u16_s16(vmaxq_s16(vreinterpretq_s16_u16(a), vreinterpretq_s16_u16(b))); }
+static INLINE span_vec span_cmpeq(span_vec a, span_vec b) { return vceqq_u16(a, b); }
+#define span_srl(v, n) vshrq_n_u16((v), (n))
+#define span_sll(v, n) vshlq_n_u16((v), (n))
+#define span_sra(v, n) vreinterpretq_u16_s16(vshrq_n_s16(vreinterpretq_s16_u16(v), (n)))
+
+struct span_ramp
+{
+   uint32x4_t lo, hi;
+};
+
+static INLINE void span_ramp_init(span_ramp *r, uint32 step)
+{
+   static const uint32 idx[4] = { 0, 1, 2, 3 };
+
+   r->lo = vmulq_n_u32(vld1q_u32(idx), step);
+   r->hi = vaddq_u32(r->lo, vdupq_n_u32(step * 4));
+}
+
+static INLINE span_vec span_ramp_at(const span_ramp *r, uint32 base)
+{
+   const uint32x4_t b = vdupq_n_u32(base);
+
+   return vshrq_n_u16(vcombine_u16(vshrn_n_u32(vaddq_u32(b, r->lo), 16), vshrn_n_u32(vaddq_u32(b, r->hi), 16)), 8);
+}
+
+#endif
+
+/* Per-lane select, m must be all ones or all zeros in each lane. */
+static INLINE span_vec span_select(span_vec m, span_vec a, span_vec b)
+{
+   return span_or(span_and(m, a), span_andnot(b, m));
+}
+
+/* Stores GPU_SIMD_LANES 32-bit pixels, pixel i being lo[i] | hi[i] << 16. */
+static INLINE void span_store32(uint32 *p, span_vec lo, span_vec hi)
+{
+#if defined(GPU_SIMD_AVX2)
+   /* The unpacks work within 128-bit halves, put the quarters back in order. */
+   const __m256i a = _mm256_unpacklo_epi16(lo, hi);
+   const __m256i b = _mm256_unpackhi_epi16(lo, hi);
+
+   _mm256_storeu_si256((__m256i *)p + 0, _mm256_permute2x128_si256(a, b, 0x20));
+   _mm256_storeu_si256((__m256i *)p + 1, _mm256_permute2x128_si256(a, b, 0x31));
+#elif defined(GPU_SIMD_SSE2)
+   _mm_storeu_si128((__m128i *)p + 0, _mm_unpacklo_epi16(lo, hi));
+   _mm_storeu_si128((__m128i *)p + 1, _mm_unpackhi_epi16(lo, hi));
+#elif defined(GPU_SIMD_NEON)
+   const uint32x4_t l = vreinterpretq_u32_u16(vzipq_u16(lo, hi).val[0]);
+   const uint32x4_t h = vreinterpretq_u32_u16(vzipq_u16(lo, hi).val[1]);
+
+   vst1q_u32(p + 0, l);
+   vst1q_u32(p + 4, h);
+#endif
+}
+
+/* Stores count copies of v, count being a multiple of 4. */
+static INLINE void span_fill32(uint32 *p, uint32 v, unsigned count)
+{
+   unsigned i;
+#if defined(GPU_SIMD_NEON)
+   const uint32x4_t vv = vdupq_n_u32(v);
+
+   for (i = 0; i < count; i += 4)
+      vst1q_u32(p + i, vv);
+#else
+   const __m128i vv = _mm_set1_epi32((int)v);
+
+   for (i = 0; i < count; i += 4)
+      _mm_storeu_si128((__m128i *)(p + i), vv);
+#endif
+}
+
+#endif
+
+#endif
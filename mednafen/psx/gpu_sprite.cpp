@@ -62,6 +62,8 @@ static void DrawSprite(PS_GPU *gpu, int32_t x_arg, int32_t y_arg, int32_t w, int
    if(y_bound > (gpu->ClipY1 + 1))
       y_bound = gpu->ClipY1 + 1;
 
+   MarkDrawDirty(gpu, x_start, y_start, x_bound - 1, y_bound - 1);
+
    //HeightMode && !dfe && ((y & 1) == ((DisplayFB_YStart + !field_atvs) & 1)) && !DisplayOff
    //printf("%d:%d, %d, %d ---- heightmode=%d displayfb_ystart=%d field_atvs=%d displayoff=%d\n", w, h, scanline, dfe, HeightMode, DisplayFB_YStart, field_atvs, DisplayOff);
 
@@ -87,7 +89,29 @@ static void DrawSprite(PS_GPU *gpu, int32_t x_arg, int32_t y_arg, int32_t w, int
             gpu->DrawTimeAvail -= suck_time;
          }
 
-         for(int32_t x = x_start; MDFN_LIKELY(x < x_bound); x++)
+         if(gpu->timing_only)
+         {
+            if(textured)
+            {
+               for(int32_t x = x_start; MDFN_LIKELY(x < x_bound); x++)
+               {
+                  TouchTexel<TexMode_TA>(gpu, u_r, v);
+                  u_r += u_inc;
+               }
+            }
+         }
+         else if(!BandOwnsLine(gpu, y))
+         {
+            if(textured && gpu->texcache_exact)
+            {
+               for(int32_t x = x_start; MDFN_LIKELY(x < x_bound); x++)
+               {
+                  GetTexel<TexMode_TA>(gpu, u_r, v);
+                  u_r += u_inc;
+               }
+            }
+         }
+         else for(int32_t x = x_start; MDFN_LIKELY(x < x_bound); x++)
          {
             if(textured)
             {
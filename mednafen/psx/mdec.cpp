@@ -55,6 +55,7 @@
 
 #include "psx.h"
 #include "mdec.h"
+#include "profile.h"
 
 #include "../masmem.h"
 #include "../state_helpers.h"
@@ -522,6 +523,7 @@ static INLINE void WriteImageData(uint16 V, int32* eat_cycles)
 
 void MDEC_Run(int32 clocks)
 {
+   PSX_PROFILE_SCOPE(PSX_PROF_MDEC);
    static const unsigned MDRPhaseBias = 0 + 1;
 
    ClockCounter += clocks;
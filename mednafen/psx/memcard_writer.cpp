@@ -0,0 +1,290 @@
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+
+#include <libretro.h>
+#include <streams/file_stream.h>
+#if defined(_WIN32) && !defined(_XBOX) && !defined(__WINRT__)
+#include <windows.h>
+#include <encodings/utf.h>
+#endif
+#if HAVE_THREADS
+#include <rthreads/rthreads.h>
+#endif
+
+#include "memcard_writer.h"
+
+extern retro_log_printf_t log_cb;
+
+/* Replaces path with tmp_path in one step, so path always holds either the
+ * old or the new image. */
+static bool ReplaceImage(const std::string &tmp_path, const std::string &path)
+{
+#if defined(_WIN32) && !defined(_XBOX) && !defined(__WINRT__)
+   /* rename() won't replace an existing file here. */
+   wchar_t *tmp_path_w = utf8_to_utf16_string_alloc(tmp_path.c_str());
+   wchar_t *path_w     = utf8_to_utf16_string_alloc(path.c_str());
+   bool ok             = tmp_path_w && path_w &&
+         MoveFileExW(tmp_path_w, path_w, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+
+   free(tmp_path_w);
+   free(path_w);
+   return ok;
+#else
+   return filestream_rename(tmp_path.c_str(), path.c_str()) == 0;
+#endif
+}
+
+static bool WriteImage(const std::string &path, const std::vector<uint8_t> &data)
+{
+   std::string tmp_path = path + ".tmp";
+   RFILE *mf            = filestream_open(tmp_path.c_str(),
+         RETRO_VFS_FILE_ACCESS_WRITE,
+         RETRO_VFS_FILE_ACCESS_HINT_NONE);
+   bool ok;
+
+   if (!mf)
+   {
+      log_cb(RETRO_LOG_ERROR, "Couldn't open %s for writing.\n", tmp_path.c_str());
+      return false;
+   }
+
+   ok = filestream_write(mf, &data[0], data.size()) == (int64_t)data.size();
+   ok = (filestream_flush(mf) == 0) && ok;
+   ok = (filestream_close(mf) == 0) && ok;
+
+   if (!ok)
+   {
+      log_cb(RETRO_LOG_ERROR, "Couldn't write %s.\n", tmp_path.c_str());
+      filestream_delete(tmp_path.c_str());
+      return false;
+   }
+
+   /* On failure the previous card stays as it was; the new image is left
+    * in the .tmp file rather than lost. */
+   if (!ReplaceImage(tmp_path, path))
+   {
+      log_cb(RETRO_LOG_ERROR, "Couldn't replace %s with %s.\n", path.c_str(), tmp_path.c_str());
+      return false;
+   }
+
+   return true;
+}
+
+/* Paths whose last write failed and that haven't been queued again since.
+ * Guarded by lock while the thread runs. */
+static std::vector<std::string> failed;
+
+static void SetFailed(const std::string &path, bool fail)
+{
+   size_t i;
+
+   for (i = 0; i < failed.size(); i++)
+      if (failed[i] == path)
+         break;
+
+   if (fail && i == failed.size())
+      failed.push_back(path);
+   else if (!fail && i < failed.size())
+      failed.erase(failed.begin() + i);
+}
+
+static bool IsFailed(const char *path)
+{
+   size_t i;
+
+   for (i = 0; i < failed.size(); i++)
+      if (failed[i] == path)
+         return true;
+
+   return false;
+}
+
+#if HAVE_THREADS
+struct MemcardJob
+{
+   std::string path;
+   std::vector<uint8_t> data;
+};
+
+static std::vector<MemcardJob> jobs;   /* Waiting to be written, oldest first. */
+static std::string writing;            /* Path of the job the thread took off jobs, if any. */
+static bool quit;
+static sthread_t *thread;
+static slock_t *lock;
+static scond_t *work_cond;
+static scond_t *done_cond;
+
+static void WriterMain(void *arg)
+{
+   slock_lock(lock);
+
+   for (;;)
+   {
+      MemcardJob job;
+      size_t i;
+      bool ok;
+
+      while (jobs.empty() && !quit)
+         scond_wait(work_cond, lock);
+
+      if (jobs.empty())
+         break;
+
+      job.path.swap(jobs[0].path);
+      job.data.swap(jobs[0].data);
+      jobs.erase(jobs.begin());
+      writing = job.path;
+
+      slock_unlock(lock);
+      ok = WriteImage(job.path, job.data);
+      slock_lock(lock);
+
+      /* A newer image queued meanwhile decides the outcome instead. */
+      for (i = 0; i < jobs.size(); i++)
+         if (jobs[i].path == job.path)
+            break;
+      if (i == jobs.size())
+         SetFailed(job.path, !ok);
+
+      writing.clear();
+      scond_broadcast(done_cond);
+   }
+
+   slock_unlock(lock);
+}
+
+void MemcardWriter_Queue(const char *path, const uint8_t *data, uint32_t size)
+{
+   size_t i;
+
+   if (!thread)
+   {
+      lock      = slock_new();
+      work_cond = scond_new();
+      done_cond = scond_new();
+      quit      = false;
+      thread    = NULL;
+
+      if (lock && work_cond && done_cond)
+         thread = sthread_create(WriterMain, NULL);
+
+      /* Without a writer thread, the image is written right here. */
+      if (!thread)
+      {
+         if (done_cond)
+            scond_free(done_cond);
+         if (work_cond)
+            scond_free(work_cond);
+         if (lock)
+            slock_free(lock);
+         lock      = NULL;
+         work_cond = NULL;
+         done_cond = NULL;
+
+         SetFailed(path, !WriteImage(path, std::vector<uint8_t>(data, data + size)));
+         return;
+      }
+   }
+
+   slock_lock(lock);
+
+   SetFailed(path, false);
+
+   /* Coalesce with a write of the same card that hasn't started yet. */
+   for (i = 0; i < jobs.size(); i++)
+      if (jobs[i].path == path)
+         break;
+
+   if (i == jobs.size())
+   {
+      jobs.push_back(MemcardJob());
+      jobs[i].path = path;
+   }
+
+   jobs[i].data.assign(data, data + size);
+
+   scond_signal(work_cond);
+   slock_unlock(lock);
+}
+
+static bool IsQueued(const char *path)
+{
+   size_t i;
+
+   if (writing == path)
+      return true;
+
+   for (i = 0; i < jobs.size(); i++)
+      if (jobs[i].path == path)
+         return true;
+
+   return false;
+}
+
+void MemcardWriter_Wait(const char *path)
+{
+   if (!thread)
+      return;
+
+   slock_lock(lock);
+
+   while (IsQueued(path))
+      scond_wait(done_cond, lock);
+
+   slock_unlock(lock);
+}
+
+bool MemcardWriter_Failed(const char *path)
+{
+   bool ret;
+
+   if (!thread)
+      return IsFailed(path);
+
+   slock_lock(lock);
+   ret = IsFailed(path);
+   slock_unlock(lock);
+
+   return ret;
+}
+
+void MemcardWriter_Kill(void)
+{
+   if (!thread)
+      return;
+
+   slock_lock(lock);
+   quit = true;
+   scond_signal(work_cond);
+   slock_unlock(lock);
+
+   /* The thread drains the queue before it exits. */
+   sthread_join(thread);
+   thread = NULL;
+
+   scond_free(done_cond);
+   scond_free(work_cond);
+   slock_free(lock);
+   lock = NULL;
+}
+#else
+void MemcardWriter_Queue(const char *path, const uint8_t *data, uint32_t size)
+{
+   SetFailed(path, !WriteImage(path, std::vector<uint8_t>(data, data + size)));
+}
+
+void MemcardWriter_Wait(const char *path)
+{
+}
+
+bool MemcardWriter_Failed(const char *path)
+{
+   return IsFailed(path);
+}
+
+void MemcardWriter_Kill(void)
+{
+}
+#endif
@@ -0,0 +1,31 @@
+#ifndef __MDFN_PSX_MEMCARD_WRITER_H
+#define __MDFN_PSX_MEMCARD_WRITER_H
+
+#include <stdint.h>
+
+/* Memory card images are written to disk by a background thread, so slow
+ * storage doesn't stall the emulation thread.
+ *
+ * The caller hands over a copy of the image. A card queued again before
+ * its previous image was written only has the newest image written. Each
+ * image is written to "<path>.tmp" first and then renamed over <path>, so
+ * a crash mid-write leaves the previous file intact. If the rename fails,
+ * the new image is left in the .tmp file.
+ *
+ * Without threads the image is written immediately. */
+
+void MemcardWriter_Queue(const char *path, const uint8_t *data, uint32_t size);
+
+/* Blocks until any image queued for path has been written; writes of
+ * other cards carry on. Anything about to read a card file back has to
+ * call this first. */
+void MemcardWriter_Wait(const char *path);
+
+/* True if the last image written to path couldn't be written and no newer
+ * one has been queued since, so the card still has to be saved. */
+bool MemcardWriter_Failed(const char *path);
+
+/* Flushes and stops the writer thread. It is started again on demand. */
+void MemcardWriter_Kill(void);
+
+#endif
@@ -0,0 +1,206 @@
+#include "psx.h"
+#include "profile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+uint64 PSX_Profile_Clock(void)
+{
+#ifdef _WIN32
+   static LARGE_INTEGER freq;
+   LARGE_INTEGER now;
+
+   if (!freq.QuadPart)
+      QueryPerformanceFrequency(&freq);
+   QueryPerformanceCounter(&now);
+
+   return (uint64)((double)now.QuadPart * 1000000000.0 / freq.QuadPart);
+#else
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return (uint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+#ifdef PSX_PROFILE
+#define PROFILE_MAX_DEPTH 16
+
+static const char *section_names[PSX_PROF_COUNT] =
+{
+   "other",
+   "cpu",
+   "gpu",
+   "cdc",
+   "spu",
+   "mdec",
+   "timer",
+   "dma",
+   "fio",
+   "gp0_polygon",
+   "gp0_line",
+   "gp0_sprite",
+   "gp0_fill",
+   "gp0_transfer",
+   "gp0_misc"
+};
+
+static uint64 section_ns[PSX_PROF_COUNT];
+static uint64 section_calls[PSX_PROF_COUNT];
+static uint64 frames;
+
+/* Totals at the previous PSX_Profile_Summary() call. */
+static uint64 summary_ns[PSX_PROF_COUNT];
+
+static unsigned stack[PROFILE_MAX_DEPTH];
+static unsigned depth;
+static uint64 last_clock;
+
+/* Charges the time since the last transition to the innermost section. */
+static void profile_charge(void)
+{
+   uint64 now   = PSX_Profile_Clock();
+   unsigned top = depth < PROFILE_MAX_DEPTH ? depth : PROFILE_MAX_DEPTH;
+
+   section_ns[top ? stack[top - 1] : PSX_PROF_OTHER] += now - last_clock;
+   last_clock = now;
+}
+
+void PSX_Profile_Enter(unsigned section)
+{
+   profile_charge();
+   section_calls[section]++;
+
+   /* Too deep to be anything but runaway recursion, keep charging the
+    * innermost section that fits. */
+   if (depth < PROFILE_MAX_DEPTH)
+      stack[depth] = section;
+   depth++;
+}
+
+void PSX_Profile_Leave(void)
+{
+   profile_charge();
+   depth--;
+}
+
+unsigned PSX_Profile_GP0Section(uint8 cc)
+{
+   if (cc >= 0x20 && cc <= 0x3F)
+      return PSX_PROF_GP0_POLYGON;
+   if (cc >= 0x40 && cc <= 0x5F)
+      return PSX_PROF_GP0_LINE;
+   if (cc >= 0x60 && cc <= 0x7F)
+      return PSX_PROF_GP0_SPRITE;
+   if (cc == 0x02)
+      return PSX_PROF_GP0_FILL;
+   if (cc >= 0x80 && cc <= 0xDF)
+      return PSX_PROF_GP0_TRANSFER;
+
+   return PSX_PROF_GP0_MISC;
+}
+
+void PSX_Profile_Reset(void)
+{
+   memset(section_ns, 0, sizeof(section_ns));
+   memset(section_calls, 0, sizeof(section_calls));
+   memset(summary_ns, 0, sizeof(summary_ns));
+   frames     = 0;
+   last_clock = PSX_Profile_Clock();
+}
+
+void PSX_Profile_FrameDone(void)
+{
+   frames++;
+}
+
+void PSX_Profile_Get(unsigned section, uint64 *ns, uint64 *calls)
+{
+   /* Bring the running section up to date. */
+   profile_charge();
+
+   *ns    = section_ns[section];
+   *calls = section_calls[section];
+}
+
+const char *PSX_Profile_Name(unsigned section)
+{
+   return section_names[section];
+}
+
+void PSX_Profile_Print(FILE *fp, uint64 total_ns)
+{
+   unsigned i;
+
+   for (i = 0; i < PSX_PROF_COUNT; i++)
+   {
+      uint64 ns, calls;
+
+      PSX_Profile_Get(i, &ns, &calls);
+
+      fprintf(fp, "%-12s %10.2f ms %6.2f%% %12llu calls\n",
+            section_names[i], ns / 1000000.0,
+            total_ns ? ns * 100.0 / total_ns : 0.0,
+            (unsigned long long)calls);
+   }
+}
+
+void PSX_Profile_Summary(char *buf, size_t size)
+{
+   uint64 delta[PSX_PROF_COUNT];
+   uint64 total = 0;
+   size_t len   = 0;
+   unsigned i;
+
+   profile_charge();
+
+   for (i = 0; i < PSX_PROF_COUNT; i++)
+   {
+      delta[i]      = section_ns[i] - summary_ns[i];
+      summary_ns[i] = section_ns[i];
+      total        += delta[i];
+   }
+
+   buf[0] = '\0';
+
+   for (i = 0; i < PSX_PROF_COUNT && total; i++)
+   {
+      unsigned percent = (unsigned)(delta[i] * 100 / total);
+
+      if (!percent || len >= size)
+         continue;
+
+      len += snprintf(buf + len, size - len, "%s%s %u%%",
+            len ? " " : "", section_names[i], percent);
+   }
+}
+
+bool PSX_Profile_Dump(const char *path)
+{
+   FILE *fp = fopen(path, "w");
+   unsigned i;
+
+   if (!fp)
+      return false;
+
+   profile_charge();
+
+   fprintf(fp, "{\n  \"frames\": %llu,\n  \"sections\": {\n",
+         (unsigned long long)frames);
+
+   for (i = 0; i < PSX_PROF_COUNT; i++)
+      fprintf(fp, "    \"%s\": { \"ns\": %llu, \"calls\": %llu }%s\n",
+            section_names[i],
+            (unsigned long long)section_ns[i],
+            (unsigned long long)section_calls[i],
+            i + 1 < PSX_PROF_COUNT ? "," : "");
+
+   fprintf(fp, "  }\n}\n");
+
+   return fclose(fp) == 0;
+}
+#endif
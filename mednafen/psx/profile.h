@@ -0,0 +1,78 @@
+#ifndef __MDFN_PSX_PROFILE_H
+#define __MDFN_PSX_PROFILE_H
+
+#include <stdio.h>
+
+/* Host time profiling of the emulated subsystems, built with PROFILE=1.
+ *
+ * Subsystems call into each other (the CPU runs events, CDC updates drive
+ * the SPU, DMA drives the GPU and MDEC, GPU updates run GP0 commands), so
+ * sections form a stack and every section is only charged its self time:
+ * the time spent in it minus the time spent in the sections it entered.
+ * Whatever runs outside of any section is charged to PSX_PROF_OTHER.
+ *
+ * There is one section per event type and one per GP0 command class. The
+ * totals can be shown on screen through a core option and are written to
+ * <save dir>/<content>.profile.json when the content is unloaded. */
+
+enum
+{
+   PSX_PROF_OTHER = 0,
+   PSX_PROF_CPU,
+   PSX_PROF_GPU,
+   PSX_PROF_CDC,
+   PSX_PROF_SPU,
+   PSX_PROF_MDEC,
+   PSX_PROF_TIMER,
+   PSX_PROF_DMA,
+   PSX_PROF_FIO,
+
+   PSX_PROF_GP0_POLYGON,
+   PSX_PROF_GP0_LINE,
+   PSX_PROF_GP0_SPRITE,
+   PSX_PROF_GP0_FILL,
+   PSX_PROF_GP0_TRANSFER,
+   PSX_PROF_GP0_MISC,
+
+   PSX_PROF_COUNT
+};
+
+/* Monotonic host clock in nanoseconds, available in every build for the
+ * benchmark runner and GPU replay timings. */
+uint64 PSX_Profile_Clock(void);
+
+#ifdef PSX_PROFILE
+void PSX_Profile_Enter(unsigned section);
+void PSX_Profile_Leave(void);
+
+/* Section a GP0 command is charged to. */
+unsigned PSX_Profile_GP0Section(uint8 cc);
+
+void PSX_Profile_Reset(void);
+void PSX_Profile_FrameDone(void);
+void PSX_Profile_Get(unsigned section, uint64 *ns, uint64 *calls);
+const char *PSX_Profile_Name(unsigned section);
+
+/* Writes one line per section, with its share of total_ns. */
+void PSX_Profile_Print(FILE *fp, uint64 total_ns);
+
+/* One line share of each section above 1% since the previous call, for
+ * the OSD. */
+void PSX_Profile_Summary(char *buf, size_t size);
+
+/* Writes the totals since the last reset as JSON. */
+bool PSX_Profile_Dump(const char *path);
+
+class PSX_ProfileScope
+{
+   public:
+      PSX_ProfileScope(unsigned section) { PSX_Profile_Enter(section); }
+      ~PSX_ProfileScope() { PSX_Profile_Leave(); }
+};
+
+#define PSX_PROFILE_SCOPE(section) PSX_ProfileScope psx_profile_scope(section)
+#else
+#define PSX_PROFILE_SCOPE(section)
+#endif
+
+#endif
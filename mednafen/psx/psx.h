@@ -67,20 +67,37 @@ void ForceEventUpdates(const int32_t timestamp);
 
 enum
 {
-   PSX_EVENT__SYNFIRST = 0,
-   PSX_EVENT_GPU,
+   PSX_EVENT_GPU = 0,
    PSX_EVENT_CDC,
    //PSX_EVENT_SPU,
    PSX_EVENT_TIMER,
    PSX_EVENT_DMA,
    PSX_EVENT_FIO,
-   PSX_EVENT__SYNLAST,
-   PSX_EVENT__COUNT
+   PSX_EVENT__BUILTIN,
+
+   PSX_EVENT__MAX = 16
 };
 
 #define PSX_EVENT_MAXTS             0x20000000
 void PSX_SetEventNT(const int type, const int32_t next_timestamp);
 
+// Runs the event due at timestamp and returns the timestamp of the next
+// one, like GPU_Update() and friends.
+typedef int32_t (*psx_event_handler_t)(const int32_t timestamp);
+
+// Adds an event source and returns its type for PSX_SetEventNT(), or -1
+// if there are already PSX_EVENT__MAX. The handler runs when the time
+// last set with PSX_SetEventNT() comes, and from ForceEventUpdates().
+// Registered sources are dropped when the content is unloaded, so they're
+// registered again with each load.
+int PSX_RegisterEvent(const char *name, psx_event_handler_t handler);
+
+// Sources are numbered 0 to PSX_EventSources() - 1, the built-in ones
+// first. PSX_EventFired() counts how often a source's event came due.
+unsigned PSX_EventSources(void);
+const char *PSX_EventName(const int type);
+uint64_t PSX_EventFired(const int type);
+
 void PSX_SetDMACycleSteal(unsigned stealage);
 
 // PSX_GPULineHook modified to take surface pitch (in pixels) and upscale factor for software renderer internal upscaling
@@ -64,15 +64,24 @@
 /*
  Update() isn't called on Read and Writes for performance reasons, it's called with sufficient granularity from the event
  system, though this will obviously need to change if we ever emulate the SPU with better precision than per-sample(pair).
+
+ While the SPU IRQ can't fire, the event system is let fall up to a block of samples behind, and Read(), Write() and
+ SPU DMA have the CDC catch the SPU up first(see PS_CDC::SyncSPU()).
 */
 
 #include "psx.h"
 #include "cdc.h"
 #include "spu.h"
+#include "profile.h"
 #include <libretro.h>
 
 #include "../state_helpers.h"
 
+#if defined(__SSE2__)
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#endif
+
 uint32_t IntermediateBufferPos;
 int16_t IntermediateBuffer[4096][2];
 
@@ -87,6 +96,16 @@ static const int16 FIR_Table[256][4] =
 #include "spu_fir_table.inc"
 };
 
+#if defined(__SSE2__)
+static INLINE int32 SPU_HSum(__m128i v)
+{
+   v = _mm_add_epi32(v, _mm_shuffle_epi32(v, (3 << 0) | (2 << 2) | (1 << 4) | (0 << 6)));
+   v = _mm_add_epi32(v, _mm_shuffle_epi32(v, (1 << 0) | (0 << 2)));
+
+   return _mm_cvtsi128_si32(v);
+}
+#endif
+
 PS_SPU::PS_SPU()
 {
    IntermediateBufferPos = 0;
@@ -293,19 +312,8 @@ INLINE void SPU_Sweep::WriteVolume(int16 value)
 //
 // Take care not to trigger SPU IRQ for the next block before its decoding start.
 //
-void PS_SPU::RunDecoder(SPU_Voice *voice)
+INLINE void PS_SPU::RunDecoder(SPU_Voice *voice)
 {
-   // 5 through 0xF appear to be 0 on the real thing.
-   static const int32 Weights[16][2] =
-   {
-      // s-1    s-2
-      {   0,    0 },
-      {  60,    0 },
-      { 115,  -52 },
-      {  98,  -55 },
-      { 122,  -60 },
-   };
-
    if(voice->DecodeAvail >= 11)
    {
       if(SPUControl & 0x40)
@@ -321,6 +329,22 @@ void PS_SPU::RunDecoder(SPU_Voice *voice)
       return;
    }
 
+   DecodeSamples(voice);
+}
+
+void NO_INLINE PS_SPU::DecodeSamples(SPU_Voice *voice)
+{
+   // 5 through 0xF appear to be 0 on the real thing.
+   static const int32 Weights[16][2] =
+   {
+      // s-1    s-2
+      {   0,    0 },
+      {  60,    0 },
+      { 115,  -52 },
+      {  98,  -55 },
+      { 122,  -60 },
+   };
+
    if((voice->CurAddr & 0x7) == 0)
    {
       // Handle delayed flags from the previously-decoded block.
@@ -589,14 +613,14 @@ INLINE uint32 PS_SPU::Get_Reverb_Offset(uint32 in_offset)
  return(offset);
 }
 
-int16 NO_INLINE PS_SPU::RD_RVB(uint16 raw_offs, int32 extra_offs)
+INLINE int16 PS_SPU::RD_RVB(uint32 offset)
 {
- return ReadSPURAM(Get_Reverb_Offset((raw_offs << 2) + extra_offs));
+ return ReadSPURAM(Get_Reverb_Offset(offset));
 }
 
-void NO_INLINE PS_SPU::WR_RVB(uint16 raw_offs, int16 sample)
+INLINE void PS_SPU::WR_RVB(uint32 offset, int16 sample)
 {
-   WriteSPURAM(Get_Reverb_Offset(raw_offs << 2), sample);
+   WriteSPURAM(Get_Reverb_Offset(offset), sample);
 }
 
 //
@@ -606,6 +630,54 @@ static const int16 ResampTable[20] =
  -1, 2, -10, 35, -103, 266, -616, 1332, -2960, 10246, 10246, -2960, 1332, -616, 266, -103, 35, -10, 2, -1,
 };
 
+#if defined(__SSE2__)
+//
+// ResampTable laid out over the 40 input samples Reverb4422() spans(zeroes back in, middle included), and padded
+// to 24 for Reverb2244(), so both are a few 16x16->32 madds.  The sums are the same as the scalar loops', and
+// 32 bits is still adequate.
+//
+MDFN_ALIGN(16) static const int16 ResampTable4422[40] =
+{
+ -1, 0, 2, 0, -10, 0, 35, 0, -103, 0, 266, 0, -616, 0, 1332, 0, -2960, 0, 10246, 0x4000,
+ 10246, 0, -2960, 0, 1332, 0, -616, 0, 266, 0, -103, 0, 35, 0, -10, 0, 2, 0, -1, 0,
+};
+
+MDFN_ALIGN(16) static const int16 ResampTable2244[24] =
+{
+ -1, 2, -10, 35, -103, 266, -616, 1332, -2960, 10246, 10246, -2960, 1332, -616, 266, -103, 35, -10, 2, -1,
+ 0, 0, 0, 0,
+};
+
+static INLINE int32 Reverb4422(const int16 *src)
+{
+ __m128i sum = _mm_setzero_si128();
+ int32 out;
+
+ for(unsigned i = 0; i < 40; i += 8)
+  sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_loadu_si128((const __m128i *)&src[i]), _mm_load_si128((const __m128i *)&ResampTable4422[i])));
+
+ out = SPU_HSum(sum) >> 15;
+
+ clamp(&out, -32768, 32767);
+
+ return(out);
+}
+
+static INLINE int32 Reverb2244(const int16 *src)
+{
+   __m128i sum = _mm_setzero_si128();
+   int32 out;
+
+   for(unsigned i = 0; i < 24; i += 8)
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_loadu_si128((const __m128i *)&src[i]), _mm_load_si128((const __m128i *)&ResampTable2244[i])));
+
+   out = SPU_HSum(sum) >> 14;
+
+   clamp(&out, -32768, 32767);
+
+   return out;
+}
+#else
 static INLINE int32 Reverb4422(const int16 *src)
 {
  int32 out = 0;	// 32-bits is adequate(it won't overflow)
@@ -637,6 +709,7 @@ static INLINE int32 Reverb2244(const int16 *src)
 
    return out;
 }
+#endif
 
 static int32 IIASM(const int16 IIR_ALPHA, const int16 insamp)
 {
@@ -650,99 +723,118 @@ static int32 IIASM(const int16 IIR_ALPHA, const int16 insamp)
    return insamp * (32768 - IIR_ALPHA);
 }
 
+//
+// Runs count samples through the reverb, in[n] and out[n] being the nth's L/R pair.  The tap offsets can't change
+// during a call, so they're worked out once up front rather than for every access.
 //
 // Take care to thoroughly test the reverb resampling code when modifying anything that uses RvbResPos.
 //
-void PS_SPU::RunReverb(const int32* in, int32* out)
+void PS_SPU::RunReverb(unsigned count, const int32 (*in)[2], int32 (*out)[2])
 {
-   unsigned lr;
- int32 upsampled[2];
-
- upsampled[0] = upsampled[1] = 0;
-
- for(lr = 0; lr < 2; lr++)
+ const uint32 iir_src[4]   = { (uint32)IIR_SRC_A0 << 2, (uint32)IIR_SRC_A1 << 2, (uint32)IIR_SRC_B0 << 2, (uint32)IIR_SRC_B1 << 2 };
+ const uint32 iir_dest[4]  = { (uint32)IIR_DEST_A0 << 2, (uint32)IIR_DEST_A1 << 2, (uint32)IIR_DEST_B0 << 2, (uint32)IIR_DEST_B1 << 2 };
+ const uint32 acc_src[2][4] =
  {
-  RDSB[lr][RvbResPos | 0x00] = in[lr];
-  RDSB[lr][RvbResPos | 0x40] = in[lr];	// So we don't have to &/bounds check in our MAC loop
- }
+  { (uint32)ACC_SRC_A0 << 2, (uint32)ACC_SRC_B0 << 2, (uint32)ACC_SRC_C0 << 2, (uint32)ACC_SRC_D0 << 2 },
+  { (uint32)ACC_SRC_A1 << 2, (uint32)ACC_SRC_B1 << 2, (uint32)ACC_SRC_C1 << 2, (uint32)ACC_SRC_D1 << 2 },
+ };
+ const uint32 mix_dest[4]  = { (uint32)MIX_DEST_A0 << 2, (uint32)MIX_DEST_A1 << 2, (uint32)MIX_DEST_B0 << 2, (uint32)MIX_DEST_B1 << 2 };
+ const uint32 fb_src[4]    =
+ {
+  (uint32)(uint16)(MIX_DEST_A0 - FB_SRC_A) << 2, (uint32)(uint16)(MIX_DEST_A1 - FB_SRC_A) << 2,
+  (uint32)(uint16)(MIX_DEST_B0 - FB_SRC_B) << 2, (uint32)(uint16)(MIX_DEST_B1 - FB_SRC_B) << 2,
+ };
 
- if(RvbResPos & 1)
+ for(unsigned n = 0; n < count; n++)
  {
-  int32 downsampled[2];
+  int32 upsampled[2];
 
-  for(unsigned lr = 0; lr < 2; lr++)
-   downsampled[lr] = Reverb4422(&RDSB[lr][(RvbResPos - 39) & 0x3F]);
+  upsampled[0] = upsampled[1] = 0;
 
-  /* Run algorithm */
-  if(SPUControl & 0x80)
+  for(unsigned lr = 0; lr < 2; lr++)
   {
-   int16 ACC0, ACC1;
-   int16 FB_A0, FB_A1, FB_B0, FB_B1;
-
-   int16 IIR_INPUT_A0 = ReverbSat(((RD_RVB(IIR_SRC_A0) * IIR_COEF) >> 15) + ((downsampled[0] * IN_COEF_L) >> 15));
-   int16 IIR_INPUT_A1 = ReverbSat(((RD_RVB(IIR_SRC_A1) * IIR_COEF) >> 15) + ((downsampled[1] * IN_COEF_R) >> 15));
-   int16 IIR_INPUT_B0 = ReverbSat(((RD_RVB(IIR_SRC_B0) * IIR_COEF) >> 15) + ((downsampled[0] * IN_COEF_L) >> 15));
-   int16 IIR_INPUT_B1 = ReverbSat(((RD_RVB(IIR_SRC_B1) * IIR_COEF) >> 15) + ((downsampled[1] * IN_COEF_R) >> 15));
-
-   int16 IIR_A0 = ReverbSat((((IIR_INPUT_A0 * IIR_ALPHA) >> 14) + (IIASM(IIR_ALPHA, RD_RVB(IIR_DEST_A0, -1)) >> 14)) >> 1);
-   int16 IIR_A1 = ReverbSat((((IIR_INPUT_A1 * IIR_ALPHA) >> 14) + (IIASM(IIR_ALPHA, RD_RVB(IIR_DEST_A1, -1)) >> 14)) >> 1);
-   int16 IIR_B0 = ReverbSat((((IIR_INPUT_B0 * IIR_ALPHA) >> 14) + (IIASM(IIR_ALPHA, RD_RVB(IIR_DEST_B0, -1)) >> 14)) >> 1);
-   int16 IIR_B1 = ReverbSat((((IIR_INPUT_B1 * IIR_ALPHA) >> 14) + (IIASM(IIR_ALPHA, RD_RVB(IIR_DEST_B1, -1)) >> 14)) >> 1);
-
-   WR_RVB(IIR_DEST_A0, IIR_A0);
-   WR_RVB(IIR_DEST_A1, IIR_A1);
-   WR_RVB(IIR_DEST_B0, IIR_B0);
-   WR_RVB(IIR_DEST_B1, IIR_B1);
-
-   ACC0 = ReverbSat((((RD_RVB(ACC_SRC_A0) * ACC_COEF_A) >> 14) +
-	   	     ((RD_RVB(ACC_SRC_B0) * ACC_COEF_B) >> 14) +
-	   	     ((RD_RVB(ACC_SRC_C0) * ACC_COEF_C) >> 14) +
-	   	     ((RD_RVB(ACC_SRC_D0) * ACC_COEF_D) >> 14)) >> 1);
-
-   ACC1 = ReverbSat((((RD_RVB(ACC_SRC_A1) * ACC_COEF_A) >> 14) +
-	   	     ((RD_RVB(ACC_SRC_B1) * ACC_COEF_B) >> 14) +
-	   	     ((RD_RVB(ACC_SRC_C1) * ACC_COEF_C) >> 14) +
-	   	     ((RD_RVB(ACC_SRC_D1) * ACC_COEF_D) >> 14)) >> 1);
-
-   FB_A0 = RD_RVB(MIX_DEST_A0 - FB_SRC_A);
-   FB_A1 = RD_RVB(MIX_DEST_A1 - FB_SRC_A);
-   FB_B0 = RD_RVB(MIX_DEST_B0 - FB_SRC_B);
-   FB_B1 = RD_RVB(MIX_DEST_B1 - FB_SRC_B);
-
-   WR_RVB(MIX_DEST_A0, ReverbSat(ACC0 - ((FB_A0 * FB_ALPHA) >> 15)));
-   WR_RVB(MIX_DEST_A1, ReverbSat(ACC1 - ((FB_A1 * FB_ALPHA) >> 15)));
-
-   WR_RVB(MIX_DEST_B0, ReverbSat(((FB_ALPHA * ACC0) >> 15) - ((FB_A0 * (int16)(0x8000 ^ FB_ALPHA)) >> 15) - ((FB_B0 * FB_X) >> 15)));
-   WR_RVB(MIX_DEST_B1, ReverbSat(((FB_ALPHA * ACC1) >> 15) - ((FB_A1 * (int16)(0x8000 ^ FB_ALPHA)) >> 15) - ((FB_B1 * FB_X) >> 15)));
+   RDSB[lr][RvbResPos | 0x00] = in[n][lr];
+   RDSB[lr][RvbResPos | 0x40] = in[n][lr];	// So we don't have to &/bounds check in our MAC loop
   }
 
-  /* Get output samplesq */
-  RUSB[0][(RvbResPos >> 1) | 0x20] = RUSB[0][RvbResPos >> 1] = (RD_RVB(MIX_DEST_A0) + RD_RVB(MIX_DEST_B0)) >> 1;
-  RUSB[1][(RvbResPos >> 1) | 0x20] = RUSB[1][RvbResPos >> 1] = (RD_RVB(MIX_DEST_A1) + RD_RVB(MIX_DEST_B1)) >> 1;
+  if(RvbResPos & 1)
+  {
+   int32 downsampled[2];
 
-  ReverbCur = (ReverbCur + 1) & 0x3FFFF;
-  if(!ReverbCur)
-   ReverbCur = ReverbWA;
+   for(unsigned lr = 0; lr < 2; lr++)
+    downsampled[lr] = Reverb4422(&RDSB[lr][(RvbResPos - 39) & 0x3F]);
 
-  for(unsigned lr = 0; lr < 2; lr++)
-  {
-     const int16 *src = &RUSB[lr][((RvbResPos - 39) & 0x3F) >> 1];
-     upsampled[lr] = src[9]; /* Reverb 2244 (Middle non-zero */
+   /* Run algorithm */
+   if(SPUControl & 0x80)
+   {
+    int16 ACC0, ACC1;
+    int16 FB_A0, FB_A1, FB_B0, FB_B1;
+
+    int16 IIR_INPUT_A0 = ReverbSat(((RD_RVB(iir_src[0]) * IIR_COEF) >> 15) + ((downsampled[0] * IN_COEF_L) >> 15));
+    int16 IIR_INPUT_A1 = ReverbSat(((RD_RVB(iir_src[1]) * IIR_COEF) >> 15) + ((downsampled[1] * IN_COEF_R) >> 15));
+    int16 IIR_INPUT_B0 = ReverbSat(((RD_RVB(iir_src[2]) * IIR_COEF) >> 15) + ((downsampled[0] * IN_COEF_L) >> 15));
+    int16 IIR_INPUT_B1 = ReverbSat(((RD_RVB(iir_src[3]) * IIR_COEF) >> 15) + ((downsampled[1] * IN_COEF_R) >> 15));
+
+    int16 IIR_A0 = ReverbSat((((IIR_INPUT_A0 * IIR_ALPHA) >> 14) + (IIASM(IIR_ALPHA, RD_RVB(iir_dest[0] - 1)) >> 14)) >> 1);
+    int16 IIR_A1 = ReverbSat((((IIR_INPUT_A1 * IIR_ALPHA) >> 14) + (IIASM(IIR_ALPHA, RD_RVB(iir_dest[1] - 1)) >> 14)) >> 1);
+    int16 IIR_B0 = ReverbSat((((IIR_INPUT_B0 * IIR_ALPHA) >> 14) + (IIASM(IIR_ALPHA, RD_RVB(iir_dest[2] - 1)) >> 14)) >> 1);
+    int16 IIR_B1 = ReverbSat((((IIR_INPUT_B1 * IIR_ALPHA) >> 14) + (IIASM(IIR_ALPHA, RD_RVB(iir_dest[3] - 1)) >> 14)) >> 1);
+
+    WR_RVB(iir_dest[0], IIR_A0);
+    WR_RVB(iir_dest[1], IIR_A1);
+    WR_RVB(iir_dest[2], IIR_B0);
+    WR_RVB(iir_dest[3], IIR_B1);
+
+    ACC0 = ReverbSat((((RD_RVB(acc_src[0][0]) * ACC_COEF_A) >> 14) +
+                      ((RD_RVB(acc_src[0][1]) * ACC_COEF_B) >> 14) +
+                      ((RD_RVB(acc_src[0][2]) * ACC_COEF_C) >> 14) +
+                      ((RD_RVB(acc_src[0][3]) * ACC_COEF_D) >> 14)) >> 1);
+
+    ACC1 = ReverbSat((((RD_RVB(acc_src[1][0]) * ACC_COEF_A) >> 14) +
+                      ((RD_RVB(acc_src[1][1]) * ACC_COEF_B) >> 14) +
+                      ((RD_RVB(acc_src[1][2]) * ACC_COEF_C) >> 14) +
+                      ((RD_RVB(acc_src[1][3]) * ACC_COEF_D) >> 14)) >> 1);
+
+    FB_A0 = RD_RVB(fb_src[0]);
+    FB_A1 = RD_RVB(fb_src[1]);
+    FB_B0 = RD_RVB(fb_src[2]);
+    FB_B1 = RD_RVB(fb_src[3]);
+
+    WR_RVB(mix_dest[0], ReverbSat(ACC0 - ((FB_A0 * FB_ALPHA) >> 15)));
+    WR_RVB(mix_dest[1], ReverbSat(ACC1 - ((FB_A1 * FB_ALPHA) >> 15)));
+
+    WR_RVB(mix_dest[2], ReverbSat(((FB_ALPHA * ACC0) >> 15) - ((FB_A0 * (int16)(0x8000 ^ FB_ALPHA)) >> 15) - ((FB_B0 * FB_X) >> 15)));
+    WR_RVB(mix_dest[3], ReverbSat(((FB_ALPHA * ACC1) >> 15) - ((FB_A1 * (int16)(0x8000 ^ FB_ALPHA)) >> 15) - ((FB_B1 * FB_X) >> 15)));
+   }
+
+   /* Get output samplesq */
+   RUSB[0][(RvbResPos >> 1) | 0x20] = RUSB[0][RvbResPos >> 1] = (RD_RVB(mix_dest[0]) + RD_RVB(mix_dest[2])) >> 1;
+   RUSB[1][(RvbResPos >> 1) | 0x20] = RUSB[1][RvbResPos >> 1] = (RD_RVB(mix_dest[1]) + RD_RVB(mix_dest[3])) >> 1;
+
+   ReverbCur = (ReverbCur + 1) & 0x3FFFF;
+   if(!ReverbCur)
+    ReverbCur = ReverbWA;
+
+   for(unsigned lr = 0; lr < 2; lr++)
+   {
+      const int16 *src = &RUSB[lr][((RvbResPos - 39) & 0x3F) >> 1];
+      upsampled[lr] = src[9]; /* Reverb 2244 (Middle non-zero */
+   }
   }
- }
- else
- {
-  for(unsigned lr = 0; lr < 2; lr++)
+  else
   {
-     const int16 *src = &RUSB[lr][((RvbResPos - 39) & 0x3F) >> 1];
-     upsampled[lr] = Reverb2244(src);
+   for(unsigned lr = 0; lr < 2; lr++)
+   {
+      const int16 *src = &RUSB[lr][((RvbResPos - 39) & 0x3F) >> 1];
+      upsampled[lr] = Reverb2244(src);
+   }
   }
- }
 
- RvbResPos = (RvbResPos + 1) & 0x3F;
+  RvbResPos = (RvbResPos + 1) & 0x3F;
 
- for(unsigned lr = 0; lr < 2; lr++)
-  out[lr] = upsampled[lr];
+  for(unsigned lr = 0; lr < 2; lr++)
+   out[n][lr] = upsampled[lr];
+ }
 }
 
 
@@ -774,290 +866,701 @@ INLINE void PS_SPU::RunNoise(void)
    }
 }
 
-int32 PS_SPU::UpdateFromCDC(int32 clocks)
+// Output of a voice for the current sample, interpolated(or noise) and enveloped but before L/R volume.
+INLINE int32 PS_SPU::CalcVoiceSample(SPU_Voice *voice, int voice_num)
 {
-   //int32 clocks = timestamp - lastts;
-   int32 sample_clocks = 0;
-   //lastts = timestamp;
+   int32 voice_pvs;
 
-   clock_divider -= clocks;
-
-   while(clock_divider <= 0)
+   if(Noise_Mode & (1 << voice_num))
+      voice_pvs = (int16)LFSR;
+   else
    {
-      clock_divider += 768;
-      sample_clocks++;
+      const int si = voice->DecodeReadPos;
+      const int pi = ((voice->CurPhase & 0xFFF) >> 4);
+
+      voice_pvs = ((voice->DecodeBuffer[(si + 0) & 0x1F] * FIR_Table[pi][0]) +
+            (voice->DecodeBuffer[(si + 1) & 0x1F] * FIR_Table[pi][1]) +
+            (voice->DecodeBuffer[(si + 2) & 0x1F] * FIR_Table[pi][2]) +
+            (voice->DecodeBuffer[(si + 3) & 0x1F] * FIR_Table[pi][3])) >> 15;
    }
 
-   while(sample_clocks > 0)
+   return (voice_pvs * (int16)voice->ADSR.EnvLevel) >> 15;
+}
+
+INLINE void PS_SPU::StageVoice(SPU_Voice *voice, int voice_num, unsigned slot, uint16 lfsr)
+{
+   int16 *taps = Mix.Taps[slot];
+   int16 *coefs = Mix.Coefs[slot];
+
+   if(Noise_Mode & (1 << voice_num))
    {
-      // xxx[0] = left, xxx[1] = right
-
-      // Accumulated sound output.
-      int32 accum[2];
-
-      // Accumulated sound output for reverb input
-      int32 accum_fv[2];
-
-      // Output of reverb processing.
-      int32 reverb[2];
-
-      // Final output.
-      int32 output[2];
-
-      accum[0]    = accum[1]    = 0;
-      accum_fv[0] = accum_fv[1] = 0;
-      reverb[0]   = reverb[1]   = 0;
-      output[0]   = output[1]   = 0;
-
-      const uint32 PhaseModCache = FM_Mode & ~ 1;
-      /*
-       **
-       ** 0x1F801DAE Notes and Conjecture:
-       **   -------------------------------------------------------------------------------------
-       **   |   15   14 | 13 | 12 | 11 | 10  | 9  | 8 |  7 |  6  | 5    4    3    2    1    0   |
-       **   |      ?    | *13| ?  | ba | *10 | wrr|rdr| df |  is |      c                       |
-       **   -------------------------------------------------------------------------------------
-       **
-       **	c - Appears to be delayed copy of lower 6 bits from 0x1F801DAA.
-       **
-       **     is - Interrupt asserted out status. (apparently not instantaneous status though...)
-       **
-       **     df - Related to (c & 0x30) == 0x20 or (c & 0x30) == 0x30, at least.
-       **          0 = DMA busy(FIFO not empty when in DMA write mode?)?
-       **	    1 = DMA ready?  Something to do with the FIFO?
-       **
-       **     rdr - Read(DMA read?) Ready?
-       **
-       **     wrr - Write(DMA write?) Ready?
-       **
-       **     *10 - Unknown.  Some sort of (FIFO?) busy status?(BIOS tests for this bit in places)
-       **
-       **     ba - Alternates between 0 and 1, even when SPUControl bit15 is 0; might be related to CD audio and voice 1 and 3 writing to SPU RAM.
-       **
-       **     *13 - Unknown, was set to 1 when testing with an SPU delay system reg value of 0x200921E1(test result might not be reliable, re-run).
-       */
-      SPUStatus = SPUControl & 0x3F;
-      SPUStatus |= IRQAsserted ? 0x40 : 0x00;
-
-      if(Regs[0xD6] == 0x4)	// TODO: Investigate more(case 0x2C in global regs r/w handler)
-         SPUStatus |= (CWA & 0x100) ? 0x800 : 0x000;
-
-      for(int voice_num = 0; voice_num < 24; voice_num++)
+      // (LFSR * 0x4000 + LFSR * 0x4000) >> 15 passes the noise through the interpolation unchanged.
+      taps[0] = taps[1] = (int16)lfsr;
+      taps[2] = taps[3] = 0;
+      coefs[0] = coefs[1] = 0x4000;
+      coefs[2] = coefs[3] = 0;
+
+      // -32768 * -32768 >> 15 is the one enveloped sample that doesn't fit in 16 bits.
+      if((int16)lfsr == -32768 && (int16)voice->ADSR.EnvLevel == -32768)
+         MixWide = true;
+   }
+   else
+   {
+      const int si = voice->DecodeReadPos;
+      const int pi = ((voice->CurPhase & 0xFFF) >> 4);
+
+      if(si <= 0x1C)
+         memcpy(taps, &voice->DecodeBuffer[si], 4 * sizeof(int16));
+      else
       {
-         SPU_Voice *voice = &Voices[voice_num];
-         int32 voice_pvs;
+         taps[0] = voice->DecodeBuffer[(si + 0) & 0x1F];
+         taps[1] = voice->DecodeBuffer[(si + 1) & 0x1F];
+         taps[2] = voice->DecodeBuffer[(si + 2) & 0x1F];
+         taps[3] = voice->DecodeBuffer[(si + 3) & 0x1F];
+      }
+      memcpy(coefs, FIR_Table[pi], sizeof(FIR_Table[pi]));
+   }
 
-         voice->PreLRSample = 0;
+   Mix.Env[slot] = voice->ADSR.EnvLevel;
+   Mix.Vol[0][slot] = (uint16)voice->Sweep[0].ReadVolume();
+   Mix.Vol[1][slot] = (uint16)voice->Sweep[1].ReadVolume();
+   Mix.ReverbMask[slot] = (Reverb_Mode & (1 << voice_num)) ? ~0 : 0;
+   Mix.Voice[slot] = voice_num;
+}
 
-         //PSX_WARNING("[SPU] Voice %d CurPhase=%08x, pitch=%04x, CurAddr=%08x", voice_num, voice->CurPhase, voice->Pitch, voice->CurAddr);
+#if defined(__SSE2__)
+// Interpolated and enveloped samples of the four slots starting at i.
+static INLINE __m128i SPU_MixPVS(const SPU_MixSlots *mix, unsigned i)
+{
+   const __m128i f01 = _mm_madd_epi16(_mm_loadu_si128((const __m128i *)mix->Taps[i + 0]), _mm_loadu_si128((const __m128i *)mix->Coefs[i + 0]));
+   const __m128i f23 = _mm_madd_epi16(_mm_loadu_si128((const __m128i *)mix->Taps[i + 2]), _mm_loadu_si128((const __m128i *)mix->Coefs[i + 2]));
+   const __m128i even = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(f01), _mm_castsi128_ps(f23), _MM_SHUFFLE(2, 0, 2, 0)));
+   const __m128i odd = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(f01), _mm_castsi128_ps(f23), _MM_SHUFFLE(3, 1, 3, 1)));
+   const __m128i fir = _mm_srai_epi32(_mm_add_epi32(even, odd), 15);
 
-         //
-         // Decode new samples if necessary.
-         //
-         RunDecoder(voice);
+   return _mm_srai_epi32(_mm_madd_epi16(fir, _mm_loadu_si128((const __m128i *)&mix->Env[i])), 15);
+}
+#endif
 
+static INLINE int32 SPU_MixPVS1(const SPU_MixSlots *mix, unsigned i)
+{
+   const int16 *taps = mix->Taps[i];
+   const int16 *coefs = mix->Coefs[i];
+   int32 pvs;
 
-         //
-         //
-         //
-         int l, r;
+   pvs = ((taps[0] * coefs[0]) + (taps[1] * coefs[1]) + (taps[2] * coefs[2]) + (taps[3] * coefs[3])) >> 15;
 
-         if(Noise_Mode & (1 << voice_num))
-            voice_pvs = (int16)LFSR;
-         else
-         {
-            const int si = voice->DecodeReadPos;
-            const int pi = ((voice->CurPhase & 0xFFF) >> 4);
+   return (pvs * (int16)mix->Env[i]) >> 15;
+}
 
-            voice_pvs = ((voice->DecodeBuffer[(si + 0) & 0x1F] * FIR_Table[pi][0]) +
-                  (voice->DecodeBuffer[(si + 1) & 0x1F] * FIR_Table[pi][1]) +
-                  (voice->DecodeBuffer[(si + 2) & 0x1F] * FIR_Table[pi][2]) +   
-                  (voice->DecodeBuffer[(si + 3) & 0x1F] * FIR_Table[pi][3])) >> 15;
-         }
+//
+// Interpolates, envelopes and applies L/R volume to the staged voices, adding them to accum(and accum_fv for the
+// voices with reverb enabled) and setting their PreLRSample.
+//
+// The FIR_Table rows' magnitudes sum to less than 0x8000, so the interpolated sample always fits in 16 bits, as does
+// the enveloped one unless MixWide is set; each multiply is then a single 16x16->32 madd, with four voices per vector.
+//
+void PS_SPU::MixVoices(unsigned count, int32 *accum, int32 *accum_fv)
+{
+   unsigned i;
 
-         voice_pvs = (voice_pvs * (int16)voice->ADSR.EnvLevel) >> 15;
-         voice->PreLRSample = voice_pvs;
+#if defined(__SSE2__)
+   if(!MixWide)
+   {
+      __m128i acc_l = _mm_setzero_si128();
+      __m128i acc_r = _mm_setzero_si128();
+      __m128i acc_fv_l = _mm_setzero_si128();
+      __m128i acc_fv_r = _mm_setzero_si128();
 
-         if(voice_num == 1 || voice_num == 3)
-         {
-            int index = voice_num >> 1;
+      // Silence the unused slots of the last group of four.
+      for(i = count; i & 3; i++)
+         memset(Mix.Taps[i], 0, sizeof(Mix.Taps[i]));
 
-            WriteSPURAM(0x400 | (index * 0x200) | CWA, voice_pvs);
-         }
+      for(i = 0; i < count; i += 4)
+      {
+         const __m128i pvs = SPU_MixPVS(&Mix, i);
+         const __m128i l = _mm_srai_epi32(_mm_madd_epi16(pvs, _mm_loadu_si128((const __m128i *)&Mix.Vol[0][i])), 15);
+         const __m128i r = _mm_srai_epi32(_mm_madd_epi16(pvs, _mm_loadu_si128((const __m128i *)&Mix.Vol[1][i])), 15);
+         const __m128i rvb = _mm_loadu_si128((const __m128i *)&Mix.ReverbMask[i]);
 
+         _mm_storeu_si128((__m128i *)&Mix.Out[i], pvs);
 
-         l = (voice_pvs * voice->Sweep[0].ReadVolume()) >> 15;
-         r = (voice_pvs * voice->Sweep[1].ReadVolume()) >> 15;
+         acc_l = _mm_add_epi32(acc_l, l);
+         acc_r = _mm_add_epi32(acc_r, r);
+         acc_fv_l = _mm_add_epi32(acc_fv_l, _mm_and_si128(l, rvb));
+         acc_fv_r = _mm_add_epi32(acc_fv_r, _mm_and_si128(r, rvb));
+      }
+
+      accum[0] += SPU_HSum(acc_l);
+      accum[1] += SPU_HSum(acc_r);
+      accum_fv[0] += SPU_HSum(acc_fv_l);
+      accum_fv[1] += SPU_HSum(acc_fv_r);
+   }
+   else
+#endif
+   {
+      for(i = 0; i < count; i++)
+      {
+         const int32 pvs = SPU_MixPVS1(&Mix, i);
+         const int32 l = (pvs * (int16)Mix.Vol[0][i]) >> 15;
+         const int32 r = (pvs * (int16)Mix.Vol[1][i]) >> 15;
+
+         Mix.Out[i] = pvs;
 
          accum[0] += l;
          accum[1] += r;
+         accum_fv[0] += l & Mix.ReverbMask[i];
+         accum_fv[1] += r & Mix.ReverbMask[i];
+      }
+   }
+
+   for(i = 0; i < count; i++)
+      Voices[Mix.Voice[i]].PreLRSample = Mix.Out[i];
+}
+
+//
+// Like MixVoices(), but for count samples of one voice staged in consecutive slots; each sample goes to its own
+// accum(and accum_fv if reverb) entry, and its PreLRSample to out.
+//
+void PS_SPU::MixVoiceBlock(unsigned count, bool reverb, int32 *out, int32 (*accum)[SPU_BLOCK_SAMPLES], int32 (*accum_fv)[SPU_BLOCK_SAMPLES])
+{
+   unsigned i;
+
+#if defined(__SSE2__)
+   if(!MixWide)
+   {
+      for(i = count; i & 3; i++)
+         memset(Mix.Taps[i], 0, sizeof(Mix.Taps[i]));
+
+      for(i = 0; i < count; i += 4)
+      {
+         const __m128i pvs = SPU_MixPVS(&Mix, i);
+         const __m128i l = _mm_srai_epi32(_mm_madd_epi16(pvs, _mm_loadu_si128((const __m128i *)&Mix.Vol[0][i])), 15);
+         const __m128i r = _mm_srai_epi32(_mm_madd_epi16(pvs, _mm_loadu_si128((const __m128i *)&Mix.Vol[1][i])), 15);
+
+         _mm_storeu_si128((__m128i *)&out[i], pvs);
+
+         _mm_storeu_si128((__m128i *)&accum[0][i], _mm_add_epi32(_mm_loadu_si128((const __m128i *)&accum[0][i]), l));
+         _mm_storeu_si128((__m128i *)&accum[1][i], _mm_add_epi32(_mm_loadu_si128((const __m128i *)&accum[1][i]), r));
 
-         if(Reverb_Mode & (1 << voice_num))
+         if(reverb)
          {
-            accum_fv[0] += l;
-            accum_fv[1] += r;
+            _mm_storeu_si128((__m128i *)&accum_fv[0][i], _mm_add_epi32(_mm_loadu_si128((const __m128i *)&accum_fv[0][i]), l));
+            _mm_storeu_si128((__m128i *)&accum_fv[1][i], _mm_add_epi32(_mm_loadu_si128((const __m128i *)&accum_fv[1][i]), r));
          }
+      }
+   }
+   else
+#endif
+   {
+      for(i = 0; i < count; i++)
+      {
+         const int32 pvs = SPU_MixPVS1(&Mix, i);
+         const int32 l = (pvs * (int16)Mix.Vol[0][i]) >> 15;
+         const int32 r = (pvs * (int16)Mix.Vol[1][i]) >> 15;
+
+         out[i] = pvs;
+
+         accum[0][i] += l;
+         accum[1][i] += r;
 
-         // Run sweep
-         for(int lr = 0; lr < 2; lr++)
+         if(reverb)
          {
-            if((voice->Sweep[lr].Control & 0x8000))
-               voice->Sweep[lr].Clock();
-            else
-               voice->Sweep[lr].Current = (voice->Sweep[lr].Control & 0x7FFF) << 1;
+            accum_fv[0][i] += l;
+            accum_fv[1][i] += r;
          }
+      }
+   }
+}
 
-         // Increment stuff
-         if(!voice->DecodePlayDelay)
-         {
-            unsigned phase_inc;
+//
+// Runs the sweeps, envelope, pitch counter and key on/off of a voice after its sample has been output; mod_sample is
+// the previous voice's PreLRSample, for FM.
+//
+INLINE void PS_SPU::ClockVoice(SPU_Voice *voice, int voice_num, int32 mod_sample)
+{
+   // Run sweep
+   for(int lr = 0; lr < 2; lr++)
+   {
+      if((voice->Sweep[lr].Control & 0x8000))
+         voice->Sweep[lr].Clock();
+      else
+         voice->Sweep[lr].Current = (voice->Sweep[lr].Control & 0x7FFF) << 1;
+   }
 
-            // Run enveloping
-            RunEnvelope(voice);
+   // Increment stuff
+   if(!voice->DecodePlayDelay)
+   {
+      unsigned phase_inc;
 
-            if(PhaseModCache & (1 << voice_num))
-            {
-               // This old formula: phase_inc = (voice->Pitch * ((voice - 1)->PreLRSample + 0x8000)) >> 15;
-               // is incorrect, as it does not handle carrier pitches >= 0x8000 properly.
-               phase_inc = voice->Pitch + (((int16)voice->Pitch * ((voice - 1)->PreLRSample)) >> 15);
-            }
-            else
-               phase_inc = voice->Pitch;
+      // Run enveloping
+      RunEnvelope(voice);
 
-            if(phase_inc > 0x3FFF)
-               phase_inc = 0x3FFF;
+      if((FM_Mode & ~1) & (1 << voice_num))
+      {
+         // This old formula: phase_inc = (voice->Pitch * ((voice - 1)->PreLRSample + 0x8000)) >> 15;
+         // is incorrect, as it does not handle carrier pitches >= 0x8000 properly.
+         phase_inc = voice->Pitch + (((int16)voice->Pitch * mod_sample) >> 15);
+      }
+      else
+         phase_inc = voice->Pitch;
 
-            {
-               const uint32 tmp_phase = voice->CurPhase + phase_inc;
-               const unsigned used = tmp_phase >> 12;
+      if(phase_inc > 0x3FFF)
+         phase_inc = 0x3FFF;
 
-               voice->CurPhase = tmp_phase & 0xFFF;
-               voice->DecodeAvail -= used;
-               voice->DecodeReadPos = (voice->DecodeReadPos + used) & 0x1F;
-            }
-         }
-         else
-            voice->DecodePlayDelay--;
+      {
+         const uint32 tmp_phase = voice->CurPhase + phase_inc;
+         const unsigned used = tmp_phase >> 12;
 
-         if(VoiceOff & (1U << voice_num))
-         {
-            if(voice->ADSR.Phase != ADSR_RELEASE)
-            {
-               ReleaseEnvelope(voice);
-            }
-         }
+         voice->CurPhase = tmp_phase & 0xFFF;
+         voice->DecodeAvail -= used;
+         voice->DecodeReadPos = (voice->DecodeReadPos + used) & 0x1F;
+      }
+   }
+   else
+      voice->DecodePlayDelay--;
 
-         if(VoiceOn & (1U << voice_num))
-         {
-            //printf("Voice On: %u\n", voice_num);
+   if(VoiceOff & (1U << voice_num))
+   {
+      if(voice->ADSR.Phase != ADSR_RELEASE)
+      {
+         ReleaseEnvelope(voice);
+      }
+   }
 
-            ResetEnvelope(voice);
+   if(VoiceOn & (1U << voice_num))
+   {
+      //printf("Voice On: %u\n", voice_num);
 
-            voice->DecodeFlags = 0;
-            voice->DecodeWritePos = 0;
-            voice->DecodeReadPos = 0;
-            voice->DecodeAvail = 0;
-            voice->DecodePlayDelay = 4;
+      ResetEnvelope(voice);
 
-            BlockEnd &= ~(1 << voice_num);
+      voice->DecodeFlags = 0;
+      voice->DecodeWritePos = 0;
+      voice->DecodeReadPos = 0;
+      voice->DecodeAvail = 0;
+      voice->DecodePlayDelay = 4;
 
-            //
-            // Weight/filter previous value initialization:
-            //
-            voice->DecodeM2 = 0;
-            voice->DecodeM1 = 0;
+      BlockEnd &= ~(1 << voice_num);
 
-            voice->CurPhase = 0;
-            voice->CurAddr = voice->StartAddr & ~0x7;
-            voice->IgnoreSampLA = false;
-         }
+      //
+      // Weight/filter previous value initialization:
+      //
+      voice->DecodeM2 = 0;
+      voice->DecodeM1 = 0;
+
+      voice->CurPhase = 0;
+      voice->CurAddr = voice->StartAddr & ~0x7;
+      voice->IgnoreSampLA = false;
+   }
+
+   if(!(SPUControl & 0x8000))
+   {
+      voice->ADSR.Phase = ADSR_RELEASE;
+      voice->ADSR.EnvLevel = 0;
+   }
+}
+
+INLINE void PS_SPU::UpdateStatus(void)
+{
+   /*
+    **
+    ** 0x1F801DAE Notes and Conjecture:
+    **   -------------------------------------------------------------------------------------
+    **   |   15   14 | 13 | 12 | 11 | 10  | 9  | 8 |  7 |  6  | 5    4    3    2    1    0   |
+    **   |      ?    | *13| ?  | ba | *10 | wrr|rdr| df |  is |      c                       |
+    **   -------------------------------------------------------------------------------------
+    **
+    **	c - Appears to be delayed copy of lower 6 bits from 0x1F801DAA.
+    **
+    **     is - Interrupt asserted out status. (apparently not instantaneous status though...)
+    **
+    **     df - Related to (c & 0x30) == 0x20 or (c & 0x30) == 0x30, at least.
+    **          0 = DMA busy(FIFO not empty when in DMA write mode?)?
+    **	    1 = DMA ready?  Something to do with the FIFO?
+    **
+    **     rdr - Read(DMA read?) Ready?
+    **
+    **     wrr - Write(DMA write?) Ready?
+    **
+    **     *10 - Unknown.  Some sort of (FIFO?) busy status?(BIOS tests for this bit in places)
+    **
+    **     ba - Alternates between 0 and 1, even when SPUControl bit15 is 0; might be related to CD audio and voice 1 and 3 writing to SPU RAM.
+    **
+    **     *13 - Unknown, was set to 1 when testing with an SPU delay system reg value of 0x200921E1(test result might not be reliable, re-run).
+    */
+   SPUStatus = SPUControl & 0x3F;
+   SPUStatus |= IRQAsserted ? 0x40 : 0x00;
+
+   if(Regs[0xD6] == 0x4)	// TODO: Investigate more(case 0x2C in global regs r/w handler)
+      SPUStatus |= (CWA & 0x100) ? 0x800 : 0x000;
+}
+
+//
+// Adds CD audio(cda_raw, from PS_CDC::GetCDAudio()) to the voices' sum in accum and accum_fv, and clamps the latter
+// for the reverb.
+//
+INLINE void PS_SPU::MixCDAudio(int32 *accum, int32 *accum_fv, const int32 *cda_raw)
+{
+   // "Mute" control doesn't seem to affect CD audio(though CD audio reverb wasn't tested...)
+   // TODO: If we add sub-sample timing accuracy, see if it's checked for every channel at different times, or just once.
+   if(!(SPUControl & 0x4000))
+   {
+      accum[0] = 0;
+      accum[1] = 0;
+      accum_fv[0] = 0;
+      accum_fv[1] = 0;
+   }
+
+   // CD-DA
+   {
+      int32 cdav[2];
+
+      WriteSPURAM(CWA | 0x000, cda_raw[0]);
+      WriteSPURAM(CWA | 0x200, cda_raw[1]);
+
+      for(unsigned i = 0; i < 2; i++)
+         cdav[i] = (cda_raw[i] * CDVol[i]) >> 15;
 
-         if(!(SPUControl & 0x8000))
+      if(SPUControl & 0x0001)
+      {
+         accum[0] += cdav[0];
+         accum[1] += cdav[1];
+
+         if(SPUControl & 0x0004)	// TODO: Test this bit(and see if it is really dependent on bit0)
          {
-            voice->ADSR.Phase = ADSR_RELEASE;
-            voice->ADSR.EnvLevel = 0;
+            accum_fv[0] += cdav[0];
+            accum_fv[1] += cdav[1];
          }
       }
+   }
+
+   CWA = (CWA + 1) & 0x1FF;
+
+   for (unsigned lr = 0; lr < 2; lr++)
+      clamp(&accum_fv[lr], -32768, 32767);
+}
+
+//
+// Mixes in the reverb output and applies the main volume.
+//
+INLINE void PS_SPU::OutputSample(int32 *accum, const int32 *reverb)
+{
+   // Final output.
+   int32 output[2];
+
+   output[0]   = output[1]   = 0;
+
+   for(unsigned lr = 0; lr < 2; lr++)
+   {
+      accum[lr] += ((reverb[lr] * ReverbVol[lr]) >> 15);
+      clamp(&accum[lr],  -32768, 32767);
+      output[lr] = (accum[lr] * GlobalSweep[lr].ReadVolume()) >> 15;
+      clamp(&output[lr], -32768, 32767);
+   }
+
+   if(IntermediateBufferPos < 4096)	// Overflow might occur in some debugger use cases.
+   {
+      // 75%, for some (resampling) headroom.
+      for(unsigned lr = 0; lr < 2; lr++)
+         IntermediateBuffer[IntermediateBufferPos][lr] = (output[lr] * 3 + 2) >> 2;
+
+      IntermediateBufferPos++;
+   }
 
-      VoiceOff = 0;
-      VoiceOn = 0; 
+   // Clock global sweep
+   for(unsigned lr = 0; lr < 2; lr++)
+   {
+      if((GlobalSweep[lr].Control & 0x8000))
+         GlobalSweep[lr].Clock();
+      else
+         GlobalSweep[lr].Current = (GlobalSweep[lr].Control & 0x7FFF) << 1;
+   }
+}
+
+void PS_SPU::RunSample(void)
+{
+   // xxx[0] = left, xxx[1] = right
+
+   // Accumulated sound output.
+   int32 accum[2];
+
+   // Accumulated sound output for reverb input
+   int32 accum_fv[2];
+
+   // Output of reverb processing.
+   int32 reverb[2];
+
+   accum[0]    = accum[1]    = 0;
+   accum_fv[0] = accum_fv[1] = 0;
+   reverb[0]   = reverb[1]   = 0;
+
+   UpdateStatus();
 
-      // "Mute" control doesn't seem to affect CD audio(though CD audio reverb wasn't tested...)
-      // TODO: If we add sub-sample timing accuracy, see if it's checked for every channel at different times, or just once.
-      if(!(SPUControl & 0x4000))
+   //
+   // Decode in voice order; voices 1 and 3 are written to SPU RAM as they come, before the following voices decode,
+   // in case one of them plays from there.
+   //
+   // A voice whose envelope level is 0 outputs 0 whatever it's playing, so only the others are staged for
+   // interpolation and volume.  Decoding, sweeps and enveloping still run for every voice since addresses,
+   // IRQs, levels and the end flags are all visible to the CPU.
+   //
+   unsigned mix_count = 0;
+
+   MixWide = false;
+
+   for(int voice_num = 0; voice_num < 24; voice_num++)
+   {
+      SPU_Voice *voice = &Voices[voice_num];
+
+      voice->PreLRSample = 0;
+
+      //PSX_WARNING("[SPU] Voice %d CurPhase=%08x, pitch=%04x, CurAddr=%08x", voice_num, voice->CurPhase, voice->Pitch, voice->CurAddr);
+
+      //
+      // Decode new samples if necessary.
+      //
+      RunDecoder(voice);
+
+      if(voice_num == 1 || voice_num == 3)
       {
-         accum[0] = 0;
-         accum[1] = 0;
-         accum_fv[0] = 0;
-         accum_fv[1] = 0;
+         int index = voice_num >> 1;
+
+         WriteSPURAM(0x400 | (index * 0x200) | CWA, CalcVoiceSample(voice, voice_num));
       }
 
-      // Get CD-DA
+      if(voice->ADSR.EnvLevel)
+         StageVoice(voice, voice_num, mix_count++, LFSR);
+   }
+
+   MixVoices(mix_count, accum, accum_fv);
+
+   for(int voice_num = 0; voice_num < 24; voice_num++)
+      ClockVoice(&Voices[voice_num], voice_num, voice_num ? Voices[voice_num - 1].PreLRSample : 0);
+
+   VoiceOff = 0;
+   VoiceOn = 0; 
+
+   RunNoise();
+
+   int32 cda_raw[1][2];
+
+   PSX_CDC->GetCDAudio(cda_raw, 1);
+   MixCDAudio(accum, accum_fv, cda_raw[0]);
+   RunReverb(1, &accum_fv, &reverb);
+   OutputSample(accum, reverb);
+}
+
+//
+// Whether every reverb tap stays within the work area; an offset past its size would wrap to below it.
+//
+bool PS_SPU::ReverbInWorkArea(void)
+{
+   const uint32 size = 0x40000 - ReverbWA;
+   const uint16 mix_dest[4] = { MIX_DEST_A0, MIX_DEST_A1, MIX_DEST_B0, MIX_DEST_B1 };
+   uint32 max_offset = 0;
+
+   for(unsigned i = 0; i < 4; i++)
+      max_offset = std::max<uint32>(max_offset, mix_dest[i] << 2);
+
+   if(SPUControl & 0x80)
+   {
+      const uint16 taps[] =
       {
-         int32 cda_raw[2];
-         int32 cdav[2];
-         const unsigned freq = (PSX_CDC->AudioBuffer.ReadPos < PSX_CDC->AudioBuffer.Size) ? PSX_CDC->AudioBuffer.Freq : 0;
+         IIR_SRC_A0, IIR_SRC_A1, IIR_SRC_B0, IIR_SRC_B1,
+         ACC_SRC_A0, ACC_SRC_B0, ACC_SRC_C0, ACC_SRC_D0,
+         ACC_SRC_A1, ACC_SRC_B1, ACC_SRC_C1, ACC_SRC_D1,
+         (uint16)(MIX_DEST_A0 - FB_SRC_A), (uint16)(MIX_DEST_A1 - FB_SRC_A),
+         (uint16)(MIX_DEST_B0 - FB_SRC_B), (uint16)(MIX_DEST_B1 - FB_SRC_B),
+      };
+      const uint16 iir_dest[4] = { IIR_DEST_A0, IIR_DEST_A1, IIR_DEST_B0, IIR_DEST_B1 };
+
+      for(unsigned i = 0; i < sizeof(taps) / sizeof(taps[0]); i++)
+         max_offset = std::max<uint32>(max_offset, taps[i] << 2);
+
+      // Written at the offset, and read one before it.
+      for(unsigned i = 0; i < 4; i++)
+         max_offset = std::max<uint32>(max_offset, ((iir_dest[i] << 2) - 1) & 0x3FFFF);
+   }
 
-         cda_raw[0] = cda_raw[1] = 0;
+   return max_offset < size;
+}
+
+//
+// Whether the next count samples can be rendered voice by voice rather than sample by sample; that reorders the
+// SPU RAM accesses within the block, so nothing read during it may be written during it:
+//
+//	The IRQ can't be raised, so the reads' and writes' IRQ checks don't matter.
+//
+//	No voice reads the CD audio and voice 1/3 capture area at the bottom of SPU RAM, nor the reverb work area while
+//	reverb is writing to it.  A voice decodes at most 2 halfwords per sample, so in count samples it can only reach
+//	2 * count past where it currently is, past its loop address, or past its start address if it's being keyed on.
+//
+//	The reverb work area doesn't overlap the capture area, and no reverb tap falls outside it.
+//
+bool PS_SPU::CanRunBlock(unsigned count)
+{
+   const uint32 span = 2 * count + 2;
+   const uint32 limit = (SPUControl & 0x80) ? ReverbWA : 0x40000;
 
-         if (freq)
-            PSX_CDC->GetCDAudio(cda_raw, freq);	// PS_CDC::GetCDAudio() guarantees the variables passed by reference will be set to 0,
-         // and that their range shall be -32768 through 32767.
+   if((SPUControl & 0x40) && !IRQAsserted)
+      return false;
 
-         WriteSPURAM(CWA | 0x000, cda_raw[0]);
-         WriteSPURAM(CWA | 0x200, cda_raw[1]);
+   if(ReverbWA < 0x800 || !ReverbInWorkArea())
+      return false;
 
-         for(unsigned i = 0; i < 2; i++)
-            cdav[i] = (cda_raw[i] * CDVol[i]) >> 15;
+   for(int voice_num = 0; voice_num < 24; voice_num++)
+   {
+      const SPU_Voice *voice = &Voices[voice_num];
+      uint32 addrs[3];
 
-         if(SPUControl & 0x0001)
-         {
-            accum[0] += cdav[0];
-            accum[1] += cdav[1];
+      addrs[0] = voice->CurAddr;
+      addrs[1] = voice->LoopAddr & ~0x7;
+      addrs[2] = (VoiceOn & (1U << voice_num)) ? (voice->StartAddr & ~0x7) : voice->CurAddr;
 
-            if(SPUControl & 0x0004)	// TODO: Test this bit(and see if it is really dependent on bit0)
-            {
-               accum_fv[0] += cdav[0];
-               accum_fv[1] += cdav[1];
-            }
-         }
+      for(unsigned i = 0; i < 3; i++)
+      {
+         if(addrs[i] < 0x800 || addrs[i] + span > limit)
+            return false;
       }
+   }
 
-      CWA = (CWA + 1) & 0x1FF;
+   return true;
+}
 
+//
+// Renders count samples voice by voice: each voice is decoded, clocked and staged for all of them in a tight loop
+// and then interpolated and volume-scaled as a batch.  The noise generator doesn't depend on the voices, so it's
+// run ahead for the whole block, and FM takes the previous voice's block of samples.  CD audio is then mixed in
+// per sample, and the block run through the reverb, before the final mix.
+//
+void PS_SPU::RunBlock(unsigned count)
+{
+   uint16 lfsr[SPU_BLOCK_SAMPLES];
+   MDFN_ALIGN(16) int32 pvs[2][SPU_BLOCK_SAMPLES];
+   MDFN_ALIGN(16) int32 accum[2][SPU_BLOCK_SAMPLES];
+   MDFN_ALIGN(16) int32 accum_fv[2][SPU_BLOCK_SAMPLES];
+   int32 mix[SPU_BLOCK_SAMPLES][2];
+   int32 mix_fv[SPU_BLOCK_SAMPLES][2];
+   int32 reverb[SPU_BLOCK_SAMPLES][2];
+   int32 cda_raw[SPU_BLOCK_SAMPLES][2];
+   const uint32 start_cwa = CWA;
+   unsigned k;
+
+   memset(pvs, 0, sizeof(pvs));
+   memset(accum, 0, sizeof(accum));
+   memset(accum_fv, 0, sizeof(accum_fv));
+
+   for(k = 0; k < count; k++)
+   {
+      lfsr[k] = LFSR;
       RunNoise();
+   }
 
-      for (unsigned lr = 0; lr < 2; lr++)
-         clamp(&accum_fv[lr], -32768, 32767);
+   for(int voice_num = 0; voice_num < 24; voice_num++)
+   {
+      SPU_Voice *voice = &Voices[voice_num];
+      int32 *out = pvs[voice_num & 1];
+      const int32 *mod = pvs[(voice_num & 1) ^ 1];
+      bool audible = false;
 
-      RunReverb(accum_fv, reverb);
+      MixWide = false;
 
-      for(unsigned lr = 0; lr < 2; lr++)
+      for(k = 0; k < count; k++)
       {
-         accum[lr] += ((reverb[lr] * ReverbVol[lr]) >> 15);
-         clamp(&accum[lr],  -32768, 32767);
-         output[lr] = (accum[lr] * GlobalSweep[lr].ReadVolume()) >> 15;
-         clamp(&output[lr], -32768, 32767);
+         RunDecoder(voice);
+
+         if(voice->ADSR.EnvLevel)
+         {
+            StageVoice(voice, voice_num, k, lfsr[k]);
+            audible = true;
+         }
+         else
+            Mix.Env[k] = 0;
+
+         ClockVoice(voice, voice_num, mod[k]);
+
+         // Keyed on or off on the block's first sample only.
+         VoiceOff &= ~(1U << voice_num);
+         VoiceOn &= ~(1U << voice_num);
       }
 
-      if(IntermediateBufferPos < 4096)	// Overflow might occur in some debugger use cases.
+      if(audible)
+         MixVoiceBlock(count, (bool)(Reverb_Mode & (1 << voice_num)), out, accum, accum_fv);
+      else
+         memset(out, 0, count * sizeof(int32));
+
+      if(voice_num == 1 || voice_num == 3)
       {
-         // 75%, for some (resampling) headroom.
-         for(unsigned lr = 0; lr < 2; lr++)
-            IntermediateBuffer[IntermediateBufferPos][lr] = (output[lr] * 3 + 2) >> 2;
+         int index = voice_num >> 1;
 
-         IntermediateBufferPos++;
+         for(k = 0; k < count; k++)
+            WriteSPURAM(0x400 | (index * 0x200) | ((start_cwa + k) & 0x1FF), out[k]);
       }
 
-      sample_clocks--;
+      voice->PreLRSample = out[count - 1];
+   }
 
-      // Clock global sweep
-      for(unsigned lr = 0; lr < 2; lr++)
+   // The CDC can't refill its buffer mid-block, so its audio comes in one go.
+   PSX_CDC->GetCDAudio(cda_raw, count);
+
+   for(k = 0; k < count; k++)
+   {
+      mix[k][0] = accum[0][k];
+      mix[k][1] = accum[1][k];
+      mix_fv[k][0] = accum_fv[0][k];
+      mix_fv[k][1] = accum_fv[1][k];
+
+      UpdateStatus();
+      MixCDAudio(mix[k], mix_fv[k], cda_raw[k]);
+   }
+
+   RunReverb(count, mix_fv, reverb);
+
+   for(k = 0; k < count; k++)
+      OutputSample(mix[k], reverb[k]);
+}
+
+//
+// With the SPU IRQ unable to fire, nothing the CPU can see depends on exactly when samples are rendered between its
+// accesses to the SPU(which bring it up to date first, see PS_CDC::SyncSPU()), so the CDC may let them pile up and
+// render them in blocks; this returns by how many clocks past the next sample.
+//
+int32 PS_SPU::GetRenderSlack(void)
+{
+   if((SPUControl & 0x40) && !IRQAsserted)
+      return 0;
+
+   return (SPU_BLOCK_SAMPLES - 1) * 768;
+}
+
+int32 PS_SPU::UpdateFromCDC(int32 clocks)
+{
+   PSX_PROFILE_SCOPE(PSX_PROF_SPU);
+   //int32 clocks = timestamp - lastts;
+   int32 sample_clocks = 0;
+   //lastts = timestamp;
+
+   clock_divider -= clocks;
+
+   while(clock_divider <= 0)
+   {
+      clock_divider += 768;
+      sample_clocks++;
+   }
+
+   while(sample_clocks > 0)
+   {
+      const unsigned count = std::min<int32>(sample_clocks, SPU_BLOCK_SAMPLES);
+
+      if(count > 1 && CanRunBlock(count))
       {
-         if((GlobalSweep[lr].Control & 0x8000))
-            GlobalSweep[lr].Clock();
-         else
-            GlobalSweep[lr].Current = (GlobalSweep[lr].Control & 0x7FFF) << 1;
+         RunBlock(count);
+         sample_clocks -= count;
+      }
+      else
+      {
+         RunSample();
+         sample_clocks--;
       }
    }
 
@@ -1099,6 +1602,8 @@ void PS_SPU::Write(int32_t timestamp, uint32 A, uint16 V)
    //if((A & 0x3FF) < 0x180)
    // PSX_WARNING("[SPU] Write: %08x %04x", A, V);
 
+   PSX_CDC->SyncSPU(timestamp);
+
    A &= 0x3FF;
 
    if(A >= 0x200)
@@ -1254,6 +1759,10 @@ void PS_SPU::Write(int32_t timestamp, uint32 A, uint16 V)
                        IRQ_Assert(IRQ_SPU, IRQAsserted);
                     }
                     CheckIRQAddr(RWAddr);
+
+                    // Back to sample by sample updates if the IRQ has been armed.
+                    if((V & 0x40) && !IRQAsserted)
+                       PSX_CDC->SyncSPU(timestamp, true);
                     break;
 
          case 0x2C: 
@@ -1283,6 +1792,8 @@ void PS_SPU::Write(int32_t timestamp, uint32 A, uint16 V)
 
 uint16 PS_SPU::Read(int32_t timestamp, uint32 A)
 {
+   PSX_CDC->SyncSPU(timestamp);
+
    A &= 0x3FF;
 
    //PSX_DBGINFO("[SPU] Read: %08x", A);
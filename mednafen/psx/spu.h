@@ -93,6 +93,23 @@ struct SPU_Voice
    SPU_ADSR ADSR;
 };
 
+// Most samples rendered at once when the SPU is let run behind the CPU(see PS_SPU::UpdateFromCDC()).
+enum { SPU_BLOCK_SAMPLES = 32 };
+
+// Staging for interpolation and L/R volume, so they can be computed for several slots at once; a slot is either
+// one audible(nonzero envelope level) voice for the current sample, or one sample of a single voice when rendering
+// a block.
+struct SPU_MixSlots
+{
+   int16 Taps[SPU_BLOCK_SAMPLES][4];	// DecodeBuffer samples under the interpolation window
+   int16 Coefs[SPU_BLOCK_SAMPLES][4];	// FIR_Table row for the current phase
+   uint32 Env[SPU_BLOCK_SAMPLES];	// Envelope level in the lower 16 bits, upper 16 bits 0
+   uint32 Vol[2][SPU_BLOCK_SAMPLES];	// L/R volume, likewise
+   int32 ReverbMask[SPU_BLOCK_SAMPLES];
+   int32 Out[SPU_BLOCK_SAMPLES];	// PreLRSample
+   uint8 Voice[SPU_BLOCK_SAMPLES];
+};
+
 class PS_SPU
 {
    public:
@@ -110,6 +127,7 @@ class PS_SPU
       uint32_t ReadDMA(void);
 
       int32_t UpdateFromCDC(int32_t clocks);
+      int32_t GetRenderSlack(void);
 
    private:
 
@@ -118,6 +136,7 @@ class PS_SPU
       uint16_t ReadSPURAM(uint32_t addr);
 
       void RunDecoder(SPU_Voice *voice);
+      void DecodeSamples(SPU_Voice *voice);
 
       void CacheEnvelope(SPU_Voice *voice);
       void ResetEnvelope(SPU_Voice *voice);
@@ -125,12 +144,28 @@ class PS_SPU
       void RunEnvelope(SPU_Voice *voice);
 
 
-      void RunReverb(const int32* in, int32* out);
+      int32 CalcVoiceSample(SPU_Voice *voice, int voice_num);
+      void StageVoice(SPU_Voice *voice, int voice_num, unsigned slot, uint16 lfsr);
+      void MixVoices(unsigned count, int32 *accum, int32 *accum_fv);
+      void MixVoiceBlock(unsigned count, bool reverb, int32 *out, int32 (*accum)[SPU_BLOCK_SAMPLES], int32 (*accum_fv)[SPU_BLOCK_SAMPLES]);
+      void ClockVoice(SPU_Voice *voice, int voice_num, int32 mod_sample);
+
+      void UpdateStatus(void);
+      void MixCDAudio(int32 *accum, int32 *accum_fv, const int32 *cda_raw);
+      void OutputSample(int32 *accum, const int32 *reverb);
+      void RunSample(void);
+      bool CanRunBlock(unsigned count);
+      void RunBlock(unsigned count);
+
+      void RunReverb(unsigned count, const int32 (*in)[2], int32 (*out)[2]);
       void RunNoise(void);
       bool GetCDAudio(int32_t &l, int32_t &r);
 
       SPU_Voice Voices[24];
 
+      SPU_MixSlots Mix;
+      bool MixWide;
+
       uint32_t NoiseDivider;
       uint32_t NoiseCounter;
       uint16_t LFSR;
@@ -229,8 +264,9 @@ class PS_SPU
       uint32_t ReverbCur;
 
       uint32_t Get_Reverb_Offset(uint32_t offset);
-      int16 RD_RVB(uint16 raw_offs, int32 extra_offs = 0);
-      void WR_RVB(uint16 raw_offs, int16 sample);
+      int16 RD_RVB(uint32 offset);
+      void WR_RVB(uint32 offset, int16 sample);
+      bool ReverbInWorkArea(void);
 
       bool IRQAsserted;
 
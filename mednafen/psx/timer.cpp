@@ -17,6 +17,7 @@
 
 #include "psx.h"
 #include "timer.h"
+#include "profile.h"
 
 #include "../state_helpers.h"
 
@@ -343,6 +344,7 @@ void TIMER_ClockHRetrace(void)
 
 int32_t MDFN_FASTCALL TIMER_Update(const int32_t timestamp)
 {
+   PSX_PROFILE_SCOPE(PSX_PROF_TIMER);
    int32_t cpu_clocks = timestamp - lastts;
 
    overclock_cpu_to_device(cpu_clocks);
@@ -0,0 +1,229 @@
+/* Mednafen - Multi-system Emulator
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "../mednafen.h"
+#include "../state_helpers.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Resampler.h"
+
+/* Kaiser window shape; ~80dB of stopband attenuation. */
+static const double KaiserBeta = 8.0;
+
+static double BesselI0(double x)
+{
+ double sum = 1.0;
+ double term = 1.0;
+
+ for(unsigned k = 1; term > sum * 1e-12; k++)
+ {
+  term *= (x * x) / (4.0 * k * k);
+  sum += term;
+ }
+
+ return(sum);
+}
+
+static unsigned GCD(unsigned a, unsigned b)
+{
+ while(b)
+ {
+  unsigned t = a % b;
+  a = b;
+  b = t;
+ }
+ return(a);
+}
+
+Resampler::Resampler() : Phases(1), Step(1), Phase(0), HistoryLen(0)
+{
+ SetRates(1, 1);
+}
+
+Resampler::~Resampler()
+{
+
+}
+
+void Resampler::SetRates(unsigned in_rate, unsigned out_rate)
+{
+ const unsigned g = GCD(in_rate, out_rate);
+ const double half = NUM_TAPS / 2;
+
+ Phases = out_rate / g;
+ Step = in_rate / g;
+
+ /* Cutoff in cycles per input sample, a little under the lower of the
+  * two Nyquist rates so the transition band lands on it. */
+ const double fc = 0.45 * ((out_rate < in_rate) ? (double)out_rate / in_rate : 1.0);
+
+ Coeffs.resize(Phases * NUM_TAPS);
+
+ for(unsigned p = 0; p < Phases; p++)
+ {
+  int16 *c = &Coeffs[p * NUM_TAPS];
+  double k[NUM_TAPS];
+  double sum = 0;
+  int32 isum = 0;
+  unsigned peak = 0;
+
+  for(unsigned j = 0; j < NUM_TAPS; j++)
+  {
+   const double x = (double)j - (half - 1) - (double)p / Phases;
+   const double r = x / half;
+   double s = 2 * fc;
+
+   if(x != 0)
+    s = sin(2 * M_PI * fc * x) / (M_PI * x);
+
+   k[j] = s * BesselI0(KaiserBeta * sqrt(std::max<double>(0.0, 1.0 - r * r))) / BesselI0(KaiserBeta);
+   sum += k[j];
+  }
+
+  /* Unity DC gain per phase; rounding error goes to the largest tap. */
+  for(unsigned j = 0; j < NUM_TAPS; j++)
+  {
+   c[j] = (int16)floor(k[j] * 32768 / sum + 0.5);
+   isum += c[j];
+
+   if(k[j] > k[peak])
+    peak = j;
+  }
+  c[peak] += 32768 - isum;
+ }
+
+ Clear();
+}
+
+void Resampler::Clear(void)
+{
+ Phase = 0;
+
+ /* Prime the history so the first input sample sits under the kernel's
+  * center tap. */
+ HistoryLen = NUM_TAPS / 2 - 1;
+ memset(History, 0, sizeof(History));
+}
+
+unsigned Resampler::Process(const int16 (*in)[2], unsigned in_count, int16 (*out)[2])
+{
+ unsigned out_count = 0;
+
+ while(in_count)
+ {
+  const unsigned chunk = std::min<unsigned>(in_count, MAX_CHUNK);
+  unsigned pos = 0;
+
+  for(unsigned i = 0; i < chunk; i++)
+  {
+   History[0][HistoryLen + i] = in[i][0];
+   History[1][HistoryLen + i] = in[i][1];
+  }
+  HistoryLen += chunk;
+  in += chunk;
+  in_count -= chunk;
+
+  while((pos + NUM_TAPS) <= HistoryLen)
+  {
+   const int16 *c = &Coeffs[Phase * NUM_TAPS];
+   const int16 *l = &History[0][pos];
+   const int16 *r = &History[1][pos];
+#if defined(__SSE2__)
+   __m128i accl = _mm_setzero_si128();
+   __m128i accr = _mm_setzero_si128();
+
+   for(unsigned j = 0; j < NUM_TAPS; j += 8)
+   {
+    const __m128i cv = _mm_loadu_si128((const __m128i*)&c[j]);
+
+    accl = _mm_add_epi32(accl, _mm_madd_epi16(_mm_loadu_si128((const __m128i*)&l[j]), cv));
+    accr = _mm_add_epi32(accr, _mm_madd_epi16(_mm_loadu_si128((const __m128i*)&r[j]), cv));
+   }
+
+   __m128i t = _mm_add_epi32(_mm_unpacklo_epi32(accl, accr), _mm_unpackhi_epi32(accl, accr));
+   t = _mm_add_epi32(t, _mm_srli_si128(t, 8));
+   t = _mm_srai_epi32(_mm_add_epi32(t, _mm_set1_epi32(0x4000)), 15);
+   t = _mm_packs_epi32(t, t);
+
+   const uint32 lr = _mm_cvtsi128_si32(t);
+   memcpy(out[out_count], &lr, sizeof(lr));
+#else
+   int32 suml = 0;
+   int32 sumr = 0;
+
+   for(unsigned j = 0; j < NUM_TAPS; j++)
+   {
+    suml += l[j] * c[j];
+    sumr += r[j] * c[j];
+   }
+
+   out[out_count][0] = std::min<int32>(32767, std::max<int32>(-32768, (suml + 0x4000) >> 15));
+   out[out_count][1] = std::min<int32>(32767, std::max<int32>(-32768, (sumr + 0x4000) >> 15));
+#endif
+   out_count++;
+
+   Phase += Step;
+   while(Phase >= Phases)
+   {
+    Phase -= Phases;
+    pos++;
+   }
+  }
+
+  HistoryLen -= pos;
+  memmove(History[0], &History[0][pos], HistoryLen * sizeof(int16));
+  memmove(History[1], &History[1][pos], HistoryLen * sizeof(int16));
+ }
+
+ return(out_count);
+}
+
+int Resampler::StateAction(StateMem *sm, int load, int data_only, const char *section_name)
+{
+ unsigned phases = Phases;
+ unsigned step = Step;
+
+ SFORMAT StateRegs[] =
+ {
+  SFVAR(phases),
+  SFVAR(step),
+  SFVAR(Phase),
+  SFVAR(HistoryLen),
+  SFARRAY16N(History[0], NUM_TAPS, "History[0]"),
+  SFARRAY16N(History[1], NUM_TAPS, "History[1]"),
+  SFEND
+ };
+
+ int ret = MDFNSS_StateAction(sm, load, data_only, StateRegs, section_name);
+
+ /* Process() never leaves a whole kernel's worth of history behind. */
+ if(load && (!ret || phases != Phases || step != Step || Phase >= Phases || HistoryLen >= NUM_TAPS))
+  Clear();
+
+ return(ret);
+}
@@ -0,0 +1,69 @@
+/* Mednafen - Multi-system Emulator
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __MDFN_RESAMPLER_H
+#define __MDFN_RESAMPLER_H
+
+#include <vector>
+
+/* Fixed-ratio polyphase resampler for interleaved 16-bit stereo.
+ *
+ * The ratio is reduced to out/in = Phases/Step, so every output sample
+ * lands exactly on one of Phases precomputed windowed-sinc kernels and the
+ * number of samples produced for a given input count is deterministic. */
+class Resampler
+{
+ public:
+
+ Resampler();
+ ~Resampler();
+
+ enum { NUM_TAPS = 48 };
+
+ void SetRates(unsigned in_rate, unsigned out_rate);
+ void Clear(void);
+
+ /* Consumes in_count samples and returns the number written to out, which
+  * never exceeds MaxOutput(in_count). */
+ unsigned Process(const int16 (*in)[2], unsigned in_count, int16 (*out)[2]);
+
+ /* Saves the history and phase so that a loaded state resumes the same
+  * output stream; a state saved at other rates starts from a clear history. */
+ int StateAction(StateMem *sm, int load, int data_only, const char *section_name);
+
+ inline unsigned MaxOutput(unsigned in_count)
+ {
+  return(((uint64)in_count * Phases + Step - 1) / Step + 1);
+ }
+
+ private:
+
+ enum { MAX_CHUNK = 4096 };
+
+ unsigned Phases;
+ unsigned Step;
+ unsigned Phase;
+
+ std::vector<int16> Coeffs;
+
+ /* Deinterlaced input history; the kernel for the next output starts at
+  * index 0 of each channel. */
+ int16 History[2][NUM_TAPS + MAX_CHUNK];
+ unsigned HistoryLen;
+};
+
+#endif
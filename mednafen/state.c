@@ -39,6 +39,8 @@ int StateAction(StateMem *sm, int load, int data_only);
 
 bool FastSaveStates = false;
 
+uint32_t StateLayoutSerial = 0;
+
 static INLINE void MDFN_en32lsb_(uint8_t *buf, uint32_t morp)
 {
    buf[0]=morp;
@@ -65,16 +67,25 @@ int32_t smem_read(StateMem *st, void *buffer, uint32_t len)
 
 int32_t smem_write(StateMem *st, void *buffer, uint32_t len)
 {
-   if ((len + st->loc) > st->malloced)
+   if (st->fixed)
+   {
+      if (st->loc < st->malloced)
+         memcpy(st->data + st->loc, buffer,
+               (len < st->malloced - st->loc) ? len : st->malloced - st->loc);
+   }
+   else
    {
-      uint32_t newsize = (st->malloced >= 32768) ? st->malloced : (st->initial_malloc ? st->initial_malloc : 32768);
+      if ((len + st->loc) > st->malloced)
+      {
+         uint32_t newsize = (st->malloced >= 32768) ? st->malloced : (st->initial_malloc ? st->initial_malloc : 32768);
 
-      while(newsize < (len + st->loc))
-         newsize  *= 2;
-      st->data     = (uint8_t *)realloc(st->data, newsize);
-      st->malloced = newsize;
+         while(newsize < (len + st->loc))
+            newsize  *= 2;
+         st->data     = (uint8_t *)realloc(st->data, newsize);
+         st->malloced = newsize;
+      }
+      memcpy(st->data + st->loc, buffer, len);
    }
-   memcpy(st->data + st->loc, buffer, len);
    st->loc += len;
 
    if (st->loc > st->len)
@@ -11,6 +11,10 @@ typedef struct
    uint32_t len;
    uint32_t malloced;
    uint32_t initial_malloc; /* A setting! */
+   uint32_t fixed;          /* data belongs to the caller and is never
+                             * reallocated: writes past malloced are
+                             * dropped but still counted in len, so a
+                             * state can be measured with data NULL. */
 } StateMem;
 
 typedef struct
@@ -57,6 +61,11 @@ int32_t smem_seek(StateMem *st, uint32_t offset, int whence);
 int smem_write32le(StateMem *st, uint32_t b);
 int smem_read32le(StateMem *st, uint32_t *b);
 
+/* Bumped whenever the set of SFORMAT tables saved changes shape (input
+ * devices swapped, multitaps plugged), so that a cached state size is
+ * measured again. */
+extern uint32_t StateLayoutSerial;
+
 int MDFNSS_SaveSM(void *st, int a, int b, const void *c, const void *d, const void *e);
 int MDFNSS_LoadSM(void *st, int a, int b);
 
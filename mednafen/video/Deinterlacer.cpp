@@ -77,15 +77,15 @@ void Deinterlacer::InternalProcess(MDFN_Surface *surface, MDFN_Rect &DisplayRect
 
   if(XReposition)
   {
-    memmove(surface->pixels + ((y * 2) + field + DisplayRect.y) * surface->pitchinpix,
-	    surface->pixels + ((y * 2) + field + DisplayRect.y) * surface->pitchinpix + XReposition,
+    memmove(surface->pix<T>() + ((y * 2) + field + DisplayRect.y) * surface->pitchinpix,
+	    surface->pix<T>() + ((y * 2) + field + DisplayRect.y) * surface->pitchinpix + XReposition,
 	    LineWidths[(y * 2) + field + DisplayRect.y] * sizeof(T));
   }
 
   if(WeaveGood)
   {
-   const T* src = FieldBuffer->pixels + y * FieldBuffer->pitchinpix;
-   T* dest = surface->pixels + ((y * 2) + (field ^ 1) + DisplayRect.y) * surface->pitchinpix + DisplayRect.x;
+   const T* src = FieldBuffer->pix<T>() + y * FieldBuffer->pitchinpix;
+   T* dest = surface->pix<T>() + ((y * 2) + (field ^ 1) + DisplayRect.y) * surface->pitchinpix + DisplayRect.x;
    int32 *dest_lw = &LineWidths[(y * 2) + (field ^ 1) + DisplayRect.y];
 
    *dest_lw = LWBuffer[y];
@@ -95,8 +95,8 @@ void Deinterlacer::InternalProcess(MDFN_Surface *surface, MDFN_Rect &DisplayRect
   }
   else if(DeintType == DEINT_BOB)
   {
-   const T* src = surface->pixels + ((y * 2) + field + DisplayRect.y) * surface->pitchinpix + DisplayRect.x;
-   T* dest = surface->pixels + ((y * 2) + (field ^ 1) + DisplayRect.y) * surface->pitchinpix + DisplayRect.x;
+   const T* src = surface->pix<T>() + ((y * 2) + field + DisplayRect.y) * surface->pitchinpix + DisplayRect.x;
+   T* dest = surface->pix<T>() + ((y * 2) + (field ^ 1) + DisplayRect.y) * surface->pitchinpix + DisplayRect.x;
    const int32 *src_lw = &LineWidths[(y * 2) + field + DisplayRect.y];
    int32 *dest_lw = &LineWidths[(y * 2) + (field ^ 1) + DisplayRect.y];
 
@@ -107,14 +107,14 @@ void Deinterlacer::InternalProcess(MDFN_Surface *surface, MDFN_Rect &DisplayRect
   else
   {
    const int32 *src_lw = &LineWidths[(y * 2) + field + DisplayRect.y];
-   const T* src = surface->pixels + ((y * 2) + field + DisplayRect.y) * surface->pitchinpix + DisplayRect.x;
+   const T* src = surface->pix<T>() + ((y * 2) + field + DisplayRect.y) * surface->pitchinpix + DisplayRect.x;
    const int32 dly = ((y * 2) + (field + 1) + DisplayRect.y);
-   T* dest = surface->pixels + dly * surface->pitchinpix + DisplayRect.x;
+   T* dest = surface->pix<T>() + dly * surface->pitchinpix + DisplayRect.x;
 
    if(y == 0 && field)
    {
     T black = MAKECOLOR(0, 0, 0, 0);
-    T* dm2 = surface->pixels + (dly - 2) * surface->pitchinpix;
+    T* dm2 = surface->pix<T>() + (dly - 2) * surface->pitchinpix;
 
     LineWidths[dly - 2] = *src_lw;
 
@@ -138,10 +138,10 @@ void Deinterlacer::InternalProcess(MDFN_Surface *surface, MDFN_Rect &DisplayRect
   if(DeintType == DEINT_WEAVE)
   {
    const int32 *src_lw = &LineWidths[(y * 2) + field + DisplayRect.y];
-   const T* src = surface->pixels + ((y * 2) + field + DisplayRect.y) * surface->pitchinpix + DisplayRect.x;
-   T* dest = FieldBuffer->pixels + y * FieldBuffer->pitchinpix;
+   const T* src = surface->pix<T>() + ((y * 2) + field + DisplayRect.y) * surface->pitchinpix + DisplayRect.x;
+   T* dest = FieldBuffer->pix<T>() + y * FieldBuffer->pitchinpix;
 
-   memcpy(dest, src, *src_lw * sizeof(uint32));
+   memcpy(dest, src, *src_lw * sizeof(T));
    LWBuffer[y] = *src_lw;
 
    StateValid = true;
@@ -155,7 +155,7 @@ void Deinterlacer::Process(MDFN_Surface *surface, MDFN_Rect &DisplayRect, int32
 
  if(DeintType == DEINT_WEAVE)
  {
-  if(!FieldBuffer || FieldBuffer->w < surface->w || FieldBuffer->h < (surface->h / 2))
+  if(!FieldBuffer || FieldBuffer->w < surface->w || FieldBuffer->h < (surface->h / 2) || FieldBuffer->format.bpp != surface->format.bpp)
   {
    if(FieldBuffer)
     delete FieldBuffer;
@@ -169,11 +169,10 @@ void Deinterlacer::Process(MDFN_Surface *surface, MDFN_Rect &DisplayRect, int32
   }
  }
 
-#if defined(WANT_32BPP)
- InternalProcess<uint32>(surface, DisplayRect, LineWidths, field);
-#elif defined(WANT_16BPP)
- InternalProcess<uint16>(surface, DisplayRect, LineWidths, field);
-#endif
+ if(surface->format.bpp == 16)
+  InternalProcess<uint16>(surface, DisplayRect, LineWidths, field);
+ else
+  InternalProcess<uint32>(surface, DisplayRect, LineWidths, field);
 
  PrevDRect = DisplayRect_Original;
 }
@@ -45,6 +45,7 @@ MDFN_Surface::MDFN_Surface()
    format = MDFN_PixelFormat();
 
    pixels = NULL;
+   owned = false;
    pitchinpix = 0;
    w = 0;
    h = 0;
@@ -63,8 +64,12 @@ bool MDFN_Surface::Init(void *const p_pixels, const uint32 p_width, const uint32
    format = nf;
 
    pixels = NULL;
+   owned = (p_pixels == NULL);
 
-   rpix = calloc(1, p_pitchinpix * p_height * (nf.bpp / 8));
+   if(p_pixels)
+      rpix = p_pixels;
+   else
+      rpix = calloc(1, p_pitchinpix * p_height * (nf.bpp / 8));
    if(!rpix)
       return false;
 
@@ -88,7 +93,7 @@ void MDFN_Surface::SetFormat(const MDFN_PixelFormat &nf, bool convert)
 
 MDFN_Surface::~MDFN_Surface()
 {
-   if(pixels)
+   if(pixels && owned)
       free(pixels);
 }
 
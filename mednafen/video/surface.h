@@ -7,6 +7,9 @@
 #define ALPHA_SHIFT 24
 #define MAKECOLOR(r, g, b, a) ((r << RED_SHIFT) | (g << GREEN_SHIFT) | (b << BLUE_SHIFT) | (a << ALPHA_SHIFT))
 
+// Truncates a 32-bit surface pixel value to RGB565.
+#define COLOR_TO_RGB565(c) ((((c) >> (RED_SHIFT + 3) & 0x1F) << 11) | (((c) >> (GREEN_SHIFT + 2) & 0x3F) << 5) | ((c) >> (BLUE_SHIFT + 3) & 0x1F))
+
 struct MDFN_PaletteEntry
 {
  uint8 r, g, b;
@@ -65,10 +68,33 @@ class MDFN_PixelFormat
     a = (value >> ALPHA_SHIFT) & 0xFF;
  }
 
+ // Reads pixel x of a line in this format, as a 32-bit surface pixel value.
+ INLINE uint32 ReadPixel(const uint32 *line, unsigned x) const
+ {
+    if(bpp == 16)
+    {
+       const uint32 p = ((const uint16 *)line)[x];
+
+       return MAKECOLOR(((p >> 8) & 0xF8), ((p >> 3) & 0xFC), ((p << 3) & 0xF8), 0);
+    }
+
+    return line[x];
+ }
+
+ // Writes a 32-bit surface pixel value to pixel x of a line in this format.
+ INLINE void WritePixel(uint32 *line, unsigned x, uint32 value) const
+ {
+    if(bpp == 16)
+       ((uint16 *)line)[x] = COLOR_TO_RGB565(value);
+    else
+       line[x] = value;
+ }
+
 }; // MDFN_PixelFormat;
 
-// Supports 32-bit RGBA
-//  16-bit is WIP
+// Supports 32-bit XRGB8888 and 16-bit RGB565. With p_pixels non-NULL the
+// surface renders into that buffer instead of allocating its own, and leaves
+// freeing it to the caller.
 class MDFN_Surface //typedef struct
 {
  public:
@@ -78,7 +104,11 @@ class MDFN_Surface //typedef struct
 
  ~MDFN_Surface();
 
- uint32 *pixels;
+ union
+ {
+  uint32 *pixels;
+  uint16 *pixels16;
+ };
 
  // w, h, and pitch32 should always be > 0
  int32 w;
@@ -90,6 +120,8 @@ class MDFN_Surface //typedef struct
   int32 pitchinpix;	// New name, new code should use this.
  };
 
+ template<typename T> T *pix(void);
+
  MDFN_PaletteEntry *palette;
 
  MDFN_PixelFormat format;
@@ -112,7 +144,11 @@ class MDFN_Surface //typedef struct
     b = (value >> BLUE_SHIFT) & 0xFF;
  }
  private:
+ bool owned;
  bool Init(void *const p_pixels, const uint32 p_width, const uint32 p_height, const uint32 p_pitchinpix, const MDFN_PixelFormat &nf);
 };
 
+template<> INLINE uint32 *MDFN_Surface::pix<uint32>(void) { return pixels; }
+template<> INLINE uint16 *MDFN_Surface::pix<uint16>(void) { return pixels16; }
+
 #endif
@@ -73,7 +73,25 @@ const unsigned int mode_write = 1;
 const unsigned int mode_read = 2;
 const unsigned int mode_fail = 3;
 
-PGXP_value vertexCache[0x800 * 2][0x800 * 2];
+// Vertices are cached by screen position in an open-addressed hash table
+// instead of a full 4096x4096 grid, which would take hundreds of MB. Each
+// write session (frame) gets a new generation: entries from earlier sessions
+// stay visible until their slot is needed again, so nothing has to be
+// cleared between frames. A key is always stored within CACHE_PROBES slots
+// of its hash, which bounds both lookups and insertions.
+#define CACHE_BITS		17
+#define CACHE_SIZE		(1 << CACHE_BITS)
+#define CACHE_PROBES	16
+
+typedef struct
+{
+	unsigned int	key;		// (u16)sy << 16 | (u16)sx
+	unsigned int	generation;	// 0 if the slot was never written
+	PGXP_value		vertex;
+} PGXP_CacheEntry;
+
+static PGXP_CacheEntry vertexCache[CACHE_SIZE];
+static unsigned int cacheGeneration = 0;
 
 unsigned int baseID = 0;
 unsigned int lastID = 0;
@@ -96,10 +114,60 @@ unsigned int IsSessionID(unsigned int vertID)
 	return 0;
 }
 
+static unsigned int CacheKey(short sx, short sy)
+{
+	return ((unsigned int)(unsigned short)sy << 16) | (unsigned short)sx;
+}
+
+static unsigned int CacheHash(unsigned int key)
+{
+	return (key * 0x9E3779B1u) >> (32 - CACHE_BITS);
+}
+
+static PGXP_CacheEntry* CacheFind(unsigned int key)
+{
+	unsigned int slot = CacheHash(key);
+	unsigned int i;
+
+	for (i = 0; i < CACHE_PROBES; i++)
+	{
+		PGXP_CacheEntry* pEntry = &vertexCache[(slot + i) & (CACHE_SIZE - 1)];
+
+		if (!pEntry->generation)
+			break;
+
+		if (pEntry->key == key)
+			return pEntry;
+	}
+
+	return NULL;
+}
+
+static PGXP_CacheEntry* CacheInsert(unsigned int key)
+{
+	unsigned int slot = CacheHash(key);
+	PGXP_CacheEntry* pVictim = NULL;
+	unsigned int i;
+
+	for (i = 0; i < CACHE_PROBES; i++)
+	{
+		PGXP_CacheEntry* pEntry = &vertexCache[(slot + i) & (CACHE_SIZE - 1)];
+
+		if (!pEntry->generation || pEntry->key == key)
+			return pEntry;
+
+		// Otherwise reuse the slot written longest ago
+		if (!pVictim || pEntry->generation < pVictim->generation)
+			pVictim = pEntry;
+	}
+
+	return pVictim;
+}
+
 void PGXP_CacheVertex(short sx, short sy, const PGXP_value* _pVertex)
 {
 	const PGXP_value*	pNewVertex = (const PGXP_value*)_pVertex;
-	PGXP_value*		pOldVertex = NULL;
+	PGXP_CacheEntry*	pEntry = NULL;
 
 	if (!pNewVertex)
 	{
@@ -111,13 +179,16 @@ void PGXP_CacheVertex(short sx, short sy, const PGXP_value* _pVertex)
 	{
 		if (cacheMode != mode_write)
 		{
-			// Initialise cache on first use
-			if (cacheMode == mode_init)
-				memset(vertexCache, 0x00, sizeof(vertexCache));
-
 			// First vertex of write session (frame?)
 			cacheMode = mode_write;
 			baseID = pNewVertex->count;
+
+			// Start over if the generation wraps, 0 marks empty slots
+			if (++cacheGeneration == 0)
+			{
+				memset(vertexCache, 0x00, sizeof(vertexCache));
+				cacheGeneration = 1;
+			}
 		}
 
 		lastID = pNewVertex->count;
@@ -125,25 +196,12 @@ void PGXP_CacheVertex(short sx, short sy, const PGXP_value* _pVertex)
 		if (sx >= -0x800 && sx <= 0x7ff &&
 			sy >= -0x800 && sy <= 0x7ff)
 		{
-			pOldVertex = &vertexCache[sy + 0x800][sx + 0x800];
-
-			// To avoid ambiguity there can only be one valid entry per-session
-			if (0)//(IsSessionID(pOldVertex->count) && (pOldVertex->value == pNewVertex->value))
-			{
-				// check to ensure this isn't identical
-				if ((fabsf(pOldVertex->x - pNewVertex->x) > 0.1f) ||
-					(fabsf(pOldVertex->y - pNewVertex->y) > 0.1f) ||
-					(fabsf(pOldVertex->z - pNewVertex->z) > 0.1f))
-				{
-					*pOldVertex = *pNewVertex;
-					pOldVertex->gFlags = 5;
-					return;
-				}
-			}
-
 			// Write vertex into cache
-			*pOldVertex = *pNewVertex;
-			pOldVertex->gFlags = 1;
+			pEntry = CacheInsert(CacheKey(sx, sy));
+			pEntry->key = CacheKey(sx, sy);
+			pEntry->generation = cacheGeneration;
+			pEntry->vertex = *pNewVertex;
+			pEntry->vertex.gFlags = 1;
 		}
 	}
 }
@@ -157,10 +215,6 @@ PGXP_value* PGXP_GetCachedVertex(short sx, short sy)
 			if (cacheMode == mode_fail)
 				return NULL;
 
-			// Initialise cache on first use
-			if (cacheMode == mode_init)
-				memset(vertexCache, 0x00, sizeof(vertexCache));
-
 			// First vertex of read session (frame?)
 			cacheMode = mode_read;
 		}
@@ -168,8 +222,11 @@ PGXP_value* PGXP_GetCachedVertex(short sx, short sy)
 		if (sx >= -0x800 && sx <= 0x7ff &&
 			sy >= -0x800 && sy <= 0x7ff)
 		{
+			PGXP_CacheEntry* pEntry = CacheFind(CacheKey(sx, sy));
+
 			// Return pointer to cache entry
-			return &vertexCache[sy + 0x800][sx + 0x800];
+			if (pEntry)
+				return &pEntry->vertex;
 		}
 	}
 
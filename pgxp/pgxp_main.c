@@ -14,6 +14,10 @@ void PGXP_Init()
 
 void PGXP_SetModes(u32 modes)
 {
+	// Precision memory is only allocated while it is tracked
+	if (!(modes & PGXP_MODE_MEMORY))
+		PGXP_FreeMem();
+
 	gMode = modes;
 }
 
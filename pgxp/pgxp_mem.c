@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include <string.h>
 
 #include "pgxp_mem.h"
@@ -5,7 +6,15 @@
 #include "pgxp_gte.h"
 #include "pgxp_value.h"
 
-PGXP_value Mem[3 * 2048 * 1024 / 4];		// mirror 2MB in 32-bit words * 3
+// Mirror of 2MB in 32-bit words * 3, allocated in pages covering 4KB of
+// PSX memory each the first time they are written. Pages that were never
+// written read as zero, i.e. with no valid components.
+#define MEM_PAGE_SHIFT	10
+#define MEM_PAGE_WORDS	(1 << MEM_PAGE_SHIFT)
+#define MEM_PAGE_COUNT	(3 * 2048 * 1024 / 4 / MEM_PAGE_WORDS)
+
+static PGXP_value* MemPages[MEM_PAGE_COUNT];
+static PGXP_value UnmappedValue;	// read in place of unallocated pages, stays zero
 const u32 UserMemOffset = 0;
 const u32 ScratchOffset = 2048 * 1024 / 4;
 const u32 RegisterOffset = 2 * 2048 * 1024 / 4;
@@ -13,12 +22,37 @@ const u32 InvalidAddress = 3 * 2048 * 1024 / 4;
 
 void PGXP_InitMem()
 {
-	memset(Mem, 0, sizeof(Mem));
+	PGXP_FreeMem();
 }
 
-char* PGXP_GetMem()
+void PGXP_FreeMem()
 {
-	return (char*)(Mem); // Config.PGXP_GTE ? (char*)(Mem) : NULL;
+	u32 i;
+
+	for (i = 0; i < MEM_PAGE_COUNT; i++)
+	{
+		free(MemPages[i]);
+		MemPages[i] = NULL;
+	}
+}
+
+// Returns the value for a converted address, allocating its page if alloc is
+// set. Without alloc, or when out of memory, unallocated pages give NULL.
+static PGXP_value* GetValue(u32 offset, int alloc)
+{
+	PGXP_value** ppPage = &MemPages[offset >> MEM_PAGE_SHIFT];
+
+	if (!*ppPage)
+	{
+		if (!alloc)
+			return NULL;
+
+		*ppPage = (PGXP_value*)calloc(MEM_PAGE_WORDS, sizeof(PGXP_value));
+		if (!*ppPage)
+			return NULL;
+	}
+
+	return &(*ppPage)[offset & (MEM_PAGE_WORDS - 1)];
 }
 
 /*  Playstation Memory Map (from Playstation doc by Joshua Walker)
@@ -112,22 +146,33 @@ PGXP_value* GetPtr(u32 addr)
 	addr = PGXP_ConvertAddress(addr);
 
 	if (addr != InvalidAddress)
-		return &Mem[addr];
+		return GetValue(addr, 1);
 	return NULL;
 }
 
+// Like GetPtr() but doesn't allocate, the result must not be written to
 PGXP_value* ReadMem(u32 addr)
 {
-	return GetPtr(addr);
+	PGXP_value* pMem;
+
+	addr = PGXP_ConvertAddress(addr);
+
+	if (addr == InvalidAddress)
+		return NULL;
+
+	pMem = GetValue(addr, 0);
+	return pMem ? pMem : &UnmappedValue;
 }
 
 void ValidateAndCopyMem(PGXP_value* dest, u32 addr, u32 value)
 {
-	PGXP_value* pMem = GetPtr(addr);
+	PGXP_value* pMem = ReadMem(addr);
 	if (pMem != NULL)
 	{
-		Validate(pMem, value);
 		*dest = *pMem;
+		Validate(dest, value);
+		if (pMem != &UnmappedValue)
+			pMem->flags = dest->flags;
 		return;
 	}
 
@@ -138,7 +183,7 @@ void ValidateAndCopyMem16(PGXP_value* dest, u32 addr, u32 value, int sign)
 {
 	u32 validMask = 0;
 	psx_value val, mask;
-	PGXP_value* pMem = GetPtr(addr);
+	PGXP_value* pMem = ReadMem(addr);
 	if (pMem != NULL)
 	{
 		mask.d = val.d = 0;
@@ -157,8 +202,10 @@ void ValidateAndCopyMem16(PGXP_value* dest, u32 addr, u32 value, int sign)
 		}
 
 		// validate and copy whole value
-		MaskValidate(pMem, val.d, mask.d, validMask);
 		*dest = *pMem;
+		MaskValidate(dest, val.d, mask.d, validMask);
+		if (pMem != &UnmappedValue)
+			pMem->flags = dest->flags;
 
 		// if high word then shift
 		if ((addr % 4) == 2)
@@ -36,8 +36,7 @@ extern "C" {
 #include "pgxp_types.h"
 
    void PGXP_InitMem(void);
-
-   char*	PGXP_GetMem();	// return pointer to precision memory
+   void PGXP_FreeMem(void);	// release precision memory, it reads as zero again
    u32		PGXP_ConvertAddress(u32 addr);
 
    PGXP_value* GetPtr(u32 addr);
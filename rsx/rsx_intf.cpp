@@ -84,7 +84,7 @@ void rsx_intf_get_system_av_info(struct retro_system_av_info *info)
       case RSX_SOFTWARE:
          memset(info, 0, sizeof(*info));
          info->timing.fps            = rsx_common_get_timing_fps();
-         info->timing.sample_rate    = SOUND_FREQUENCY;
+         info->timing.sample_rate    = rsx_common_get_sample_rate();
          info->geometry.base_width   = MEDNAFEN_CORE_GEOMETRY_BASE_W;
          info->geometry.base_height  = MEDNAFEN_CORE_GEOMETRY_BASE_H;
          info->geometry.max_width    = MEDNAFEN_CORE_GEOMETRY_MAX_W  << psx_gpu_upscale_shift;
@@ -872,6 +872,11 @@ double rsx_common_get_timing_fps(void)
                (currently_interlaced ? FPS_NTSC_INTERLACED : FPS_NTSC_NONINTERLACED));
 }
 
+unsigned rsx_common_get_sample_rate(void)
+{
+   return audio_output_rate;
+}
+
 
 float rsx_common_get_aspect_ratio(bool pal_content, bool crop_overscan,
                                   int first_visible_scanline, int last_visible_scanline,
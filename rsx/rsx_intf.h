@@ -169,6 +169,8 @@ bool rsx_intf_has_software_renderer(void);
 
 double rsx_common_get_timing_fps(void);
 
+unsigned rsx_common_get_sample_rate(void);
+
 float rsx_common_get_aspect_ratio(bool pal_content, bool crop_overscan,
                                   int first_visible_scanline, int last_visible_scanline,
                                   int aspect_ratio_setting, bool vram_override, bool widescreen_override);
@@ -2294,7 +2294,7 @@ static struct retro_system_av_info get_av_info(VideoClock std)
                                                             aspect_ratio_setting, display_vram, widescreen_hack);
 
    info.timing.fps = rsx_common_get_timing_fps();
-   info.timing.sample_rate = SOUND_FREQUENCY;
+   info.timing.sample_rate = rsx_common_get_sample_rate();
 
    return info;
 }
@@ -221,7 +221,7 @@ void rsx_vulkan_get_system_av_info(struct retro_system_av_info *info)
 
    // Set retro_system_timing
    info->timing.fps = rsx_common_get_timing_fps();
-   info->timing.sample_rate = SOUND_FREQUENCY;
+   info->timing.sample_rate = rsx_common_get_sample_rate();
 }
 
 void rsx_vulkan_refresh_variables(void)
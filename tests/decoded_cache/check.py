@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+#
+# Checks that the decoded disc cache (cd_access_method=precache_decoded)
+# notices a changed image. Writes a small unofficial PBP with uncompressed
+# blocks, loads it once to build the cache and once to use it, then
+# changes a block in the middle of the image without changing its size:
+# once in place, and once rebuilt with a new index entry but the old
+# write time. Each change must rebuild the cache.
+#
+# Usage: check.py <benchmark>, or "make decoded-cache-check".
+
+import hashlib
+import os
+import re
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+
+SECTOR = 2352
+BLOCK_SECTORS = 16
+BLOCK = BLOCK_SECTORS * SECTOR
+BLOCKS = 32
+PATCHED_BLOCK = BLOCKS // 2
+
+# DATA.PSAR sits after a DATA.PSP filler, as in real images, so neither
+# its index table nor the middle blocks are within the first or last
+# 64 KB of the file.
+PSAR = 0x20000
+ISO_HEADER = PSAR + 0x400
+TOC = ISO_HEADER + 0x400
+INDEX = ISO_HEADER + 0x3C00
+BLOCK_DATA = PSAR + 0x100000
+
+OPTION = "beetle_psx_cd_access_method=precache_decoded"
+
+
+def bcd(v):
+    return ((v // 10) << 4) | (v % 10)
+
+
+def msf(lba):
+    return bytes((bcd(lba // 75 // 60), bcd(lba // 75 % 60), bcd(lba % 75)))
+
+
+def toc_entry(type_, track, index0, index1):
+    return bytes((type_, 0, track)) + index0 + b"\0" + index1
+
+
+def sector(lba):
+    data = bytearray((lba * 7 + i) & 0xFF for i in range(SECTOR))
+    if lba == 16:
+        data[24:30] = b"\x01CD001"
+    return bytes(data)
+
+
+def write_image(path, blocks):
+    image = bytearray(BLOCK_DATA + len(blocks) * BLOCK)
+
+    image[0:4] = b"\0PBP"
+    image[4:8] = struct.pack("<I", 0x10000)
+    image[8:40] = struct.pack("<8I", *([0x28] * 7 + [PSAR]))
+    image[PSAR:PSAR + 12] = b"PSISOIMG0000"
+
+    sectors = len(blocks) * BLOCK_SECTORS
+    toc = toc_entry(0, 0, b"\0\0\0", b"\0\0\0")
+    toc += toc_entry(0, 0, b"\0\0\0", bytes((bcd(1), 0, 0)))
+    toc += toc_entry(0, 0, b"\0\0\0", msf(sectors))
+    toc += toc_entry(0x41, bcd(1), msf(0), msf(150))
+    image[TOC:TOC + len(toc)] = toc
+
+    for i, block in enumerate(blocks):
+        entry = struct.pack("<IHH", i * BLOCK, BLOCK, 1)
+        entry += hashlib.md5(block).digest() + bytes(8)
+        image[INDEX + i * 32:INDEX + (i + 1) * 32] = entry
+        image[BLOCK_DATA + i * BLOCK:BLOCK_DATA + (i + 1) * BLOCK] = block
+
+    with open(path, "wb") as f:
+        f.write(image)
+
+
+def patch_in_place(path, block, data):
+    with open(path, "r+b") as f:
+        f.seek(BLOCK_DATA + block * BLOCK)
+        f.write(data)
+
+
+def load(benchmark, system_dir, image):
+    result = subprocess.run(
+        [benchmark, "-s", system_dir, "-o", OPTION, "-n", "1", "-w", "0",
+         "-v", image],
+        stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+        universal_newlines=True)
+    if result.returncode != 0:
+        sys.exit("%s failed:\n%s" % (benchmark, result.stdout))
+    return result.stdout
+
+
+def expect(step, log, built, patched=None):
+    m = re.search(r"Decoded (\d+) of \d+ sectors to (.*)\.$", log, re.M)
+    if built and not m:
+        sys.exit("%s: the cache wasn't rebuilt:\n%s" % (step, log))
+    if not built and (m or "Using decoded disc cache" not in log):
+        sys.exit("%s: the cache wasn't used:\n%s" % (step, log))
+
+    if patched is not None:
+        with open(m.group(2), "rb") as f:
+            f.seek(32 + PATCHED_BLOCK * BLOCK)
+            if f.read(BLOCK) != patched:
+                sys.exit("%s: the cache holds the old block" % step)
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("Usage: %s <benchmark>" % sys.argv[0])
+
+    benchmark = os.path.abspath(sys.argv[1])
+    tmp = tempfile.mkdtemp()
+
+    try:
+        image = os.path.join(tmp, "disc.pbp")
+        blocks = [b"".join(sector(b * BLOCK_SECTORS + s)
+                           for s in range(BLOCK_SECTORS))
+                  for b in range(BLOCKS)]
+
+        # The core only needs a BIOS file, a wrong one just warns.
+        with open(os.path.join(tmp, "scph5501.bin"), "wb") as f:
+            f.write(bytes(512 * 1024))
+
+        write_image(image, blocks)
+        expect("first load", load(benchmark, tmp, image), True)
+        expect("second load", load(benchmark, tmp, image), False)
+
+        # Same size, same index: only the write time tells it apart. Set
+        # it explicitly, the file system's may be too coarse to differ.
+        mtime = os.stat(image).st_mtime_ns
+        patched = bytes(b ^ 0xFF for b in blocks[PATCHED_BLOCK])
+        patch_in_place(image, PATCHED_BLOCK, patched)
+        os.utime(image, ns=(mtime + 2000000000, mtime + 2000000000))
+        expect("patched in place", load(benchmark, tmp, image), True, patched)
+
+        # Rebuilt with the block's new checksum in the index, but the
+        # write time of the previous image.
+        mtime = os.stat(image).st_mtime_ns
+        blocks[PATCHED_BLOCK] = bytes(b ^ 0x55 for b in blocks[PATCHED_BLOCK])
+        write_image(image, blocks)
+        os.utime(image, ns=(mtime, mtime))
+        expect("rebuilt", load(benchmark, tmp, image), True,
+               blocks[PATCHED_BLOCK])
+    finally:
+        shutil.rmtree(tmp)
+
+    print("decoded cache: passed")
+
+
+if __name__ == "__main__":
+    main()
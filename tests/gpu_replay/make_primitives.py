@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+#
+# Writes primitives.stream, a GPU command stream (see
+# mednafen/psx/gpu_replay.h) that draws one of every kind of GP0 primitive
+# from a freshly reset GPU. Its golden frame hashes are in primitives.golden;
+# "make GPU_REPLAY=1 gpu-replay-check" replays it against them.
+
+import struct
+import sys
+
+GP0, GP1, FRAME = 1, 2, 3
+
+# Every word is written at the start of its frame, and each frame lasts
+# about two video frames, so the whole display is scanned out after what
+# the frame drew.
+FRAME_CLOCKS = 2 * 33868800 // 60
+
+out = bytearray(b"GPUSTRM2")
+
+
+def record(tag, *values):
+    for v in values:
+        out.extend(struct.pack("<III", tag, 0, v & 0xFFFFFFFF))
+
+
+def gp0(*words):
+    record(GP0, *words)
+
+
+def gp1(*words):
+    record(GP1, *words)
+
+
+def frame():
+    out.extend(struct.pack("<II", FRAME, FRAME_CLOCKS))
+
+
+def xy(x, y):
+    return ((y & 0xFFFF) << 16) | (x & 0xFFFF)
+
+
+def uv(u, v, attr=0):
+    return (attr << 16) | (v << 8) | u
+
+
+def clut(x, y):
+    return (y << 6) | (x >> 4)
+
+
+def page(x, colors, semi=0, dither=True):
+    return (x >> 6) | (semi << 5) | (colors << 7) | (0x200 if dither else 0) | 0x400
+
+
+def upload(x, y, w, h, pixels):
+    gp0(0xA0000000, xy(x, y), xy(w, h))
+    if len(pixels) & 1:
+        pixels = pixels + [0]
+    gp0(*[pixels[i] | (pixels[i + 1] << 16) for i in range(0, len(pixels), 2)])
+
+
+def draw_area(x0, y0, x1, y1):
+    gp0(0xE3000000 | (y0 << 10) | x0, 0xE4000000 | (y1 << 10) | x1)
+
+
+def draw_offset(x, y):
+    gp0(0xE5000000 | ((y & 0x7FF) << 11) | (x & 0x7FF))
+
+
+# Frame 0: untextured primitives.
+gp1(0x00000000, 0x03000000, 0x08000001)
+gp0(0xE1000000 | page(0, 0))
+draw_area(0, 0, 319, 239)
+draw_offset(0, 0)
+gp0(0x02102030, xy(0, 0), xy(320, 240))
+gp0(0x30FF0000, xy(10, 10), 0x0000FF00, xy(300, 40), 0x000000FF, xy(100, 220))
+gp0(0x2A808080, xy(150, 20), xy(310, 20), xy(150, 200), xy(310, 200))
+gp0(0x50FFFF00, xy(0, 239), 0x0000FFFF, xy(319, 0))
+gp0(0x48FFFFFF, xy(20, 200), xy(60, 230), xy(100, 200), xy(140, 230), 0x55555555)
+gp0(0x58FF0000, xy(200, 230), 0x0000FF00, xy(240, 190), 0x000000FF, xy(280, 230), 0x55555555)
+gp0(0x60FF00FF, xy(250, 180), xy(40, 30))
+gp0(0x68FFFFFF, xy(5, 5))
+gp0(0x7000FFFF, xy(20, 5))
+gp0(0x7800FF00, xy(40, 5))
+frame()
+
+# Frame 1: textured primitives in every color depth.
+upload(512, 0, 32, 32,
+       [(x | (y << 5) | (((x ^ y) & 31) << 10) | (0x8000 if (x + y) % 7 == 0 else 0))
+        if (x * y) % 11 else 0 for y in range(32) for x in range(32)])
+upload(640, 0, 4, 16, [((x * 4 + y) * 0x1111) & 0xFFFF for y in range(16) for x in range(4)])
+upload(704, 0, 8, 16, [(((x * 2 + y) * 37) & 0xFF) | ((((x * 2 + 1 + y) * 37) & 0xFF) << 8)
+                       for y in range(16) for x in range(8)])
+upload(0, 480, 16, 1, [0] + [(i * 2) | ((31 - i * 2) << 5) | (i << 10) | 0x8000 for i in range(1, 16)])
+upload(0, 481, 256, 1, [0] + [(i & 31) | (((i >> 3) & 31) << 5) | ((31 - (i & 31)) << 10) for i in range(1, 256)])
+
+gp0(0x3C808080, xy(10, 10), uv(0, 0), 0x00FF4040, xy(150, 20), uv(31, 0, page(512, 2)),
+    0x004040FF, xy(20, 150), uv(0, 31), 0x00808080, xy(160, 160), uv(31, 31))
+gp0(0x24808080, xy(200, 10), uv(0, 0, clut(0, 480)), xy(300, 10), uv(15, 0, page(640, 0)),
+    xy(250, 100), uv(8, 15))
+gp0(0x2D000000, xy(170, 110), uv(0, 0, clut(0, 481)), xy(230, 110), uv(15, 0, page(704, 1)),
+    xy(170, 170), uv(0, 15), xy(230, 170), uv(15, 15))
+gp0(0x36FFFFFF, xy(60, 170), uv(0, 0, clut(0, 480)), 0x00202020, xy(140, 230), uv(15, 0, page(640, 0, 1)),
+    0x00808080, xy(20, 230), uv(0, 15))
+gp0(0xE1000000 | page(704, 1))
+gp0(0x7D000000, xy(200, 150), uv(0, 0, clut(0, 481)))
+gp0(0xE1000000 | page(512, 2))
+gp0(0x64808080, xy(230, 120), uv(4, 4), xy(24, 20))
+gp0(0xE2000000 | (1 << 5) | 1)
+gp0(0x64A0A0A0, xy(260, 60), uv(0, 0), xy(48, 40))
+gp0(0xE2000000)
+gp0(0xE1000000 | page(640, 0))
+gp0(0x7C808080, xy(290, 200), uv(0, 0, clut(0, 480)))
+frame()
+
+# Frame 2: copies, mask bits, blend modes, clipping and offsets.
+gp0(0x80000000, xy(0, 0), xy(320, 0), xy(64, 64))
+gp0(0x80000000, xy(10, 10), xy(20, 20), xy(50, 40))
+gp0(0xE6000001)
+gp0(0x28FF8000, xy(10, 100), xy(100, 100), xy(10, 180), xy(100, 180))
+gp0(0xE6000002)
+gp0(0x2000FF00, xy(0, 90), xy(120, 140), xy(30, 200))
+gp0(0xE6000000)
+for mode in range(4):
+    gp0(0xE1000000 | page(0, 0, mode))
+    x = 130 + mode * 45
+    gp0(0x32FF2020, xy(x, 60), 0x0020FF20, xy(x + 60, 90), 0x002020FF, xy(x + 10, 150))
+    gp0(0x62808080, xy(x, 160), xy(30, 30))
+draw_offset(-20, 10)
+gp0(0x20FFFFFF, xy(0, 0), xy(80, 20), xy(40, 60))
+draw_offset(0, 0)
+draw_area(50, 50, 150, 150)
+gp0(0x30FFFFFF, xy(-100, -100), 0x00000000, xy(400, 100), 0x00FF00FF, xy(100, 400))
+draw_area(0, 0, 319, 239)
+gp0(0xE1000000 | page(0, 0, dither=False))
+gp0(0x30FF0000, xy(200, 200), 0x0000FF00, xy(319, 200), 0x000000FF, xy(260, 239))
+frame()
+
+# Frame 3: a 480 line interlaced mode and a VRAM read nobody picks up.
+gp1(0x08000025, 0x05000000)
+gp0(0xE1000000 | page(0, 0))
+draw_area(0, 0, 319, 479)
+gp0(0x02000000, xy(0, 0), xy(320, 480))
+gp0(0x3000FFFF, xy(0, 0), 0x00FF00FF, xy(319, 100), 0x00FFFF00, xy(60, 479))
+gp0(0xC0000000, xy(0, 0), xy(8, 8))
+gp0(0x50FFFFFF, xy(0, 0), 0x00000000, xy(319, 479))
+frame()
+
+# Frame 4: back to 240 lines, so that frame 5 is scanned out over lines
+# that are already up to date.
+gp1(0x08000001)
+draw_area(0, 0, 319, 239)
+gp0(0x02400000, xy(0, 0), xy(320, 240))
+frame()
+
+# Frame 5: primitives that are only visible because their coordinates
+# wrap at 11 bits, from around x, y = -2000.
+draw_offset(-1024, -1024)
+gp0(0x2000FF00, xy(-976, -1000), xy(-876, -1000), xy(-926, -900))
+gp0(0x38FF0000, xy(-1000, -880), 0x000000FF, xy(-850, -880),
+    0x00FFFF00, xy(-1000, -820), 0x00FFFFFF, xy(-850, -820))
+gp0(0x40FFFFFF, xy(-1000, -980), xy(-820, -900))
+gp0(0x50FF00FF, xy(-990, -800), 0x0000FFFF, xy(-1010, -850))
+draw_offset(0, 0)
+frame()
+
+out.extend(struct.pack("<I", 0))
+
+with open(sys.argv[1] if len(sys.argv) > 1 else "primitives.stream", "wb") as f:
+    f.write(out)